@@ -0,0 +1,233 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+// Minimal helpers shared by the benchmark programs in this directory.
+//
+// Every benchmark is warmed up once, then timed as several samples. The
+// median per-iteration time is reported, with the median absolute deviation
+// (MAD) as a noise estimate that single slow samples cannot inflate.
+// `--json <path>' writes every result, for bench/compare.py.
+//
+// Proper usage:
+//
+// int main(int argc, char* argv[])
+// {
+//     bench::parse_args(argc, argv);
+//     bench::run("iterate 100k", 100, [&]() {
+//         ... (work to measure) ...
+//     });
+//     return bench::finish();
+// }
+namespace bench
+{
+    // timed samples per benchmark, fewer if there are fewer iterations
+    #define BENCH_SAMPLES 15
+
+    // wall-clock stopwatch with nanosecond resolution
+    class Stopwatch
+    {
+    private:
+        std::chrono::steady_clock::time_point start;
+    public:
+        Stopwatch() { Reset(); }
+
+        void Reset()
+        {
+            start = std::chrono::steady_clock::now();
+        }
+
+        double ElapsedMs() const
+        {
+            std::chrono::duration<double, std::milli> d =
+                std::chrono::steady_clock::now() - start;
+            return d.count();
+        }
+    };
+
+    // values passed here are considered used, so the optimizer
+    // cannot throw away the work that produced them
+    template<typename T>
+    void keep(const T& value)
+    {
+        asm volatile("" : : "r"(&value) : "memory");
+    }
+
+    // summary of one benchmark, all times are per iteration
+    typedef struct _result_t {
+        std::string name;
+        int iterations;
+        int samples;
+        double median_ms;
+        double mad_ms;
+        double mean_ms;
+        double stddev_ms;
+        double min_ms;
+        double max_ms;
+    } _result_t;
+
+    // results of this program so far, and where to write them
+    std::vector<_result_t>& results()
+    {
+        static std::vector<_result_t> all;
+        return all;
+    }
+
+    std::string& json_path()
+    {
+        static std::string path;
+        return path;
+    }
+
+    void parse_args(int argc, char* argv[])
+    {
+        for(int i = 1; i < argc; i++)
+        {
+            if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+                json_path() = argv[++i];
+            }
+            else {
+                std::cerr << "Unknown argument '" << argv[i] << "', usage: "
+                          << argv[0] << " [--json <path>]" << std::endl;
+            }
+        }
+    }
+
+    double median(std::vector<double> values)
+    {
+        if(values.empty()) {
+            return 0.0;
+        }
+        std::sort(values.begin(), values.end());
+        size_t mid = values.size() / 2;
+        if(values.size() % 2 == 0) {
+            return (values[mid - 1] + values[mid]) / 2.0;
+        }
+        return values[mid];
+    }
+
+    _result_t summarize(const std::string& name, int iterations,
+                        const std::vector<double>& samples)
+    {
+        _result_t r;
+        r.name = name;
+        r.iterations = iterations;
+        r.samples = (int)samples.size();
+        r.median_ms = median(samples);
+
+        std::vector<double> deviations;
+        double sum = 0.0;
+        for(size_t i = 0; i < samples.size(); i++)
+        {
+            deviations.push_back(std::fabs(samples[i] - r.median_ms));
+            sum += samples[i];
+        }
+        r.mad_ms = median(deviations);
+        r.mean_ms = sum / samples.size();
+
+        double squares = 0.0;
+        for(size_t i = 0; i < samples.size(); i++) {
+            squares += (samples[i] - r.mean_ms) * (samples[i] - r.mean_ms);
+        }
+        r.stddev_ms = samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0.0;
+        r.min_ms = *std::min_element(samples.begin(), samples.end());
+        r.max_ms = *std::max_element(samples.begin(), samples.end());
+        return r;
+    }
+
+    // run `func' about `iterations' times, split into samples, after one
+    // untimed warmup call. Print and return the median time per iteration
+    template<typename Func>
+    double run(const std::string& name, int iterations, Func func)
+    {
+        func();
+
+        int samples = std::max(1, std::min(iterations, BENCH_SAMPLES));
+        int per_sample = std::max(1, iterations / samples);
+
+        std::vector<double> times;
+        for(int s = 0; s < samples; s++)
+        {
+            Stopwatch sw;
+            for(int i = 0; i < per_sample; i++)
+            {
+                func();
+            }
+            times.push_back(sw.ElapsedMs() / per_sample);
+        }
+
+        _result_t r = summarize(name, samples * per_sample, times);
+        results().push_back(r);
+
+        std::cout << std::left << std::setw(40) << name
+                  << std::right << std::setw(12) << std::fixed
+                  << std::setprecision(4) << r.median_ms << " ms"
+                  << std::setprecision(1) << "  +-"
+                  << (r.median_ms > 0.0 ? 100.0 * r.mad_ms / r.median_ms : 0.0)
+                  << "%" << std::endl;
+        return r.median_ms;
+    }
+
+    std::string json_escape(const std::string& str)
+    {
+        std::string out;
+        for(size_t i = 0; i < str.size(); i++)
+        {
+            if(str[i] == '"' || str[i] == '\\') {
+                out += '\\';
+            }
+            out += str[i];
+        }
+        return out;
+    }
+
+    // write the results as JSON, if asked to. Return false if the
+    // file could not be written
+    bool write_json(const std::string& path)
+    {
+        std::ofstream file(path.c_str(), std::ios::out);
+        if(!file.is_open())
+        {
+            std::cerr << "Could not write benchmark results '" << path << "'." << std::endl;
+            return false;
+        }
+
+        const std::vector<_result_t>& all = results();
+        file << std::setprecision(6) << std::scientific << "{\"benchmarks\": [";
+        for(size_t i = 0; i < all.size(); i++)
+        {
+            const _result_t& r = all[i];
+            file << (i ? "," : "") << "\n  {\"name\": \"" << json_escape(r.name)
+                 << "\", \"iterations\": " << r.iterations
+                 << ", \"samples\": " << r.samples
+                 << ", \"median_ms\": " << r.median_ms
+                 << ", \"mad_ms\": " << r.mad_ms
+                 << ", \"mean_ms\": " << r.mean_ms
+                 << ", \"stddev_ms\": " << r.stddev_ms
+                 << ", \"min_ms\": " << r.min_ms
+                 << ", \"max_ms\": " << r.max_ms << "}";
+        }
+        file << "\n]}\n";
+        return true;
+    }
+
+    // exit code for main
+    int finish()
+    {
+        if(!json_path().empty() && !write_json(json_path())) {
+            return 1;
+        }
+        return 0;
+    }
+}
+
+#endif // BENCH_HPP
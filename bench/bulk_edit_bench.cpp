@@ -0,0 +1,224 @@
+
+// CUSTOM
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <vector>
+
+// Boxes of blocks filled, replaced, copied and pasted with the bulk edits
+// of GameWorld, checked against the same changes made a block at a time
+// with `SetBlock', and how long a 256^3 fill takes either way.
+
+#define CHECK_WIDTH 72
+#define CHECK_HEIGHT 40
+#define CHECK_DEPTH 56
+#define CHECK_SEED 1337
+#define CHECK_TICKS 64
+
+#define BENCH_SIZE 256
+
+// a box of blocks, inclusive
+struct Box
+{
+    int x0, y0, z0, x1, y1, z1;
+};
+
+bool same_block(const _block_t& a, const _block_t& b)
+{
+    return a.type == b.type && a.health == b.health && a.level == b.level;
+}
+
+// every block, every section's count and every visible face the same
+bool same_worlds(GameWorld& a, GameWorld& b, int width, int height, int depth)
+{
+    for(int z = 0; z < depth; z++)
+        for(int y = 0; y < height; y++)
+            for(int x = 0; x < width; x++)
+                if(!same_block(a.BlockAt(x, y, z), b.BlockAt(x, y, z))) {
+                    return false;
+                }
+    std::vector<unsigned char> faces_a(SECTION_BLOCKS), faces_b(SECTION_BLOCKS);
+    for(int s = 0; s < a.SectionCount(); s++)
+    {
+        if(a.Section(s).blocks != b.Section(s).blocks ||
+           a.SectionFaces(s, &faces_a[0]) != b.SectionFaces(s, &faces_b[0]) ||
+           faces_a != faces_b) {
+            return false;
+        }
+    }
+    return a.StorageStats().used == b.StorageStats().used;
+}
+
+// `FillBox' a block at a time, clamped the same way
+void fill_per_block(GameWorld& world, const Box& box, const _block_t& block)
+{
+    for(int z = box.z0; z <= box.z1; z++)
+        for(int y = box.y0; y <= box.y1; y++)
+            for(int x = box.x0; x <= box.x1; x++)
+                if(world.InBounds(x, y, z)) {
+                    world.SetBlock(x, y, z, block);
+                }
+}
+
+void replace_per_block(GameWorld& world, const Box& box, _block_type_t from, const _block_t& to)
+{
+    for(int z = box.z0; z <= box.z1; z++)
+        for(int y = box.y0; y <= box.y1; y++)
+            for(int x = box.x0; x <= box.x1; x++)
+                if(world.InBounds(x, y, z) && world.GetBlockType(x, y, z) == from) {
+                    world.SetBlock(x, y, z, to);
+                }
+}
+
+// copy `box' to (px, py, pz), turned a quarter turn taking +x to +z
+void paste_turned_per_block(GameWorld& world, const Box& box, int px, int py, int pz)
+{
+    int depth = box.z1 - box.z0 + 1;
+    std::vector<_block_t> copied;
+    for(int z = box.z0; z <= box.z1; z++)
+        for(int y = box.y0; y <= box.y1; y++)
+            for(int x = box.x0; x <= box.x1; x++)
+                copied.push_back(world.BlockAt(x, y, z));
+    size_t i = 0;
+    for(int z = 0; z <= box.z1 - box.z0; z++)
+        for(int y = 0; y <= box.y1 - box.y0; y++)
+            for(int x = 0; x <= box.x1 - box.x0; x++, i++)
+            {
+                int tx = px + depth - 1 - z, ty = py + y, tz = pz + x;
+                if(world.InBounds(tx, ty, tz)) {
+                    world.SetBlock(tx, ty, tz, copied[i]);
+                }
+            }
+}
+
+bool check_edits()
+{
+    GameWorld bulk(CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+    GameWorld single(CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+    world_generator::generate_terrain(&bulk, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH, CHECK_SEED);
+    world_generator::generate_terrain(&single, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH, CHECK_SEED);
+
+    std::vector<_world_change_t> changes;
+    bulk.AddChangeListener([&](const _world_change_t& change) {
+        changes.push_back(change);
+    });
+
+    // boxes across section borders and over the edges of the world
+    Box boxes[] = {
+        { 5, 3, 7, 40, 30, 33 },
+        { -10, -4, 20, 12, 50, 70 },
+        { 60, 0, 0, 90, 12, 15 },
+        { 16, 16, 16, 31, 31, 31 }
+    };
+    bool ok = true, notified = true;
+    for(size_t b = 0; b < sizeof(boxes) / sizeof(boxes[0]); b++)
+    {
+        const Box& box = boxes[b];
+        changes.clear();
+        bulk.FillBox(box.x0, box.y0, box.z0, box.x1, box.y1, box.z1, _block_t(BLOCK_TYPE_STONE, 7));
+        fill_per_block(single, box, _block_t(BLOCK_TYPE_STONE, 7));
+        notified = notified && changes.size() == 1 && changes[0].min[0] == std::max(box.x0, 0) &&
+                   changes[0].max[1] == std::min(box.y1, CHECK_HEIGHT - 1);
+        ok = ok && same_worlds(bulk, single, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+
+        // carve them out again, partly
+        bulk.ReplaceInBox(box.x0 + 2, box.y0 + 2, box.z0, box.x1, box.y1, box.z1 - 3,
+                          BLOCK_TYPE_STONE, _block_t(BLOCK_TYPE_NONE, 0));
+        Box inner = { box.x0 + 2, box.y0 + 2, box.z0, box.x1, box.y1, box.z1 - 3 };
+        replace_per_block(single, inner, BLOCK_TYPE_STONE, _block_t(BLOCK_TYPE_NONE, 0));
+        notified = notified && changes.size() == 2;
+        ok = ok && same_worlds(bulk, single, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+    }
+    bulk.ReplaceInBox(0, 0, 0, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH, BLOCK_TYPE_GRASS,
+                      _block_t(BLOCK_TYPE_SAND));
+    replace_per_block(single, Box{ 0, 0, 0, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH },
+                      BLOCK_TYPE_GRASS, _block_t(BLOCK_TYPE_SAND));
+    ok = ok && same_worlds(bulk, single, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+
+    // a piece of terrain pasted turned, partly over the edge, and in the air
+    Box source = { 3, 0, 5, 22, 25, 17 };
+    Clipboard clipboard;
+    bulk.CopyBox(source.x0, source.y0, source.z0, source.x1, source.y1, source.z1, clipboard);
+    ok = ok && clipboard.Width() == 20 && clipboard.Height() == 26 && clipboard.Depth() == 13;
+    bulk.Paste(clipboard, 60, 10, 30, 1);
+    paste_turned_per_block(single, source, 60, 10, 30);
+    ok = ok && same_worlds(bulk, single, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+
+    // four quarter turns are none
+    Clipboard turned = clipboard.Rotated(1).Rotated(1).Rotated(-3).Rotated(1);
+    bool identity = turned.Width() == clipboard.Width() && turned.Depth() == clipboard.Depth();
+    for(int z = 0; identity && z < clipboard.Depth(); z++)
+        for(int y = 0; y < clipboard.Height(); y++)
+            for(int x = 0; x < clipboard.Width(); x++)
+                identity = identity && same_block(turned.At(x, y, z), clipboard.At(x, y, z));
+    ok = ok && identity && clipboard.Rotated(2).Width() == clipboard.Width();
+
+    // and the sand falls the same either way
+    for(int t = 0; t < CHECK_TICKS; t++)
+    {
+        bulk.Tick();
+        single.Tick();
+    }
+    ok = ok && same_worlds(bulk, single, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+
+    std::cout << "bulk edit check " << (ok && notified ? "passed" : "FAILED")
+              << (notified ? "" : ", wrong notifications") << std::endl;
+    return ok && notified;
+}
+
+void bench_edits()
+{
+    GameWorld world(BENCH_SIZE, BENCH_SIZE, BENCH_SIZE);
+    double blocks = (double)BENCH_SIZE * BENCH_SIZE * BENCH_SIZE;
+    const int last = BENCH_SIZE - 1;
+
+    double ms = bench::run("fill and clear 256^3, SetBlock", 1, [&]() {
+        for(int z = 0; z < BENCH_SIZE; z++)
+            for(int y = 0; y < BENCH_SIZE; y++)
+                for(int x = 0; x < BENCH_SIZE; x++)
+                    world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+        for(int z = 0; z < BENCH_SIZE; z++)
+            for(int y = 0; y < BENCH_SIZE; y++)
+                for(int x = 0; x < BENCH_SIZE; x++)
+                    world.DeleteBlock(x, y, z);
+    });
+    std::cout << "  " << (int)(2 * blocks / ms / 1000.0) << " Mblocks/s" << std::endl;
+
+    ms = bench::run("fill and clear 256^3, FillBox", 5, [&]() {
+        world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_STONE));
+        world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_NONE, 0));
+    });
+    std::cout << "  " << (int)(2 * blocks / ms / 1000.0) << " Mblocks/s" << std::endl;
+
+    // terrain like ground to work on
+    world.FillBox(0, 0, 0, last, BENCH_SIZE / 2, last, _block_t(BLOCK_TYPE_EARTH));
+    world.FillBox(0, BENCH_SIZE / 2 + 1, 0, last, BENCH_SIZE / 2 + 1, last, _block_t(BLOCK_TYPE_GRASS));
+    bench::run("replace in 256^3", 5, [&]() {
+        world.ReplaceInBox(0, 0, 0, last, last, last, BLOCK_TYPE_EARTH, _block_t(BLOCK_TYPE_STONE));
+        world.ReplaceInBox(0, 0, 0, last, last, last, BLOCK_TYPE_STONE, _block_t(BLOCK_TYPE_EARTH));
+    });
+
+    Clipboard clipboard;
+    bench::run("copy 64^3", 20, [&]() {
+        world.CopyBox(0, 100, 0, 63, 163, 63, clipboard);
+    });
+    for(int turns = 0; turns < 2; turns++)
+    {
+        bench::run("paste 64^3, " + std::to_string(turns) + " quarter turns", 20, [&]() {
+            world.Paste(clipboard, 100, 100, 100, turns);
+        });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_edits();
+    bench_edits();
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+#
+# Compare benchmark results against a stored baseline.
+#
+# Both files are written by the benchmark programs with `--json <path>'.
+# A benchmark counts as a regression when its median got slower by more
+# than the threshold AND by more than the noise of both runs (a multiple
+# of their median absolute deviations), so a noisy sample alone does not
+# fail the build.
+#
+# Proper usage:
+#
+# bench/engine_bench --json bench/baseline.json    (on the old build)
+# bench/engine_bench --json bench/results.json     (on the new build)
+# bench/compare.py bench/baseline.json bench/results.json
+#
+# Exits with 1 if anything regressed.
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b["name"]: b for b in json.load(f)["benchmarks"]}
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare benchmark results against a stored baseline.")
+    parser.add_argument("baseline")
+    parser.add_argument("results")
+    parser.add_argument("--threshold", type=float, default=0.10,
+                        help="relative slowdown that counts (default 0.10)")
+    parser.add_argument("--noise", type=float, default=3.0,
+                        help="MADs a change must exceed (default 3)")
+    args = parser.parse_args()
+
+    baseline = load(args.baseline)
+    results = load(args.results)
+
+    regressions = 0
+    print("%-44s %12s %12s %8s" % ("benchmark", "baseline ms", "current ms", "change"))
+    for name, cur in results.items():
+        base = baseline.get(name)
+        if base is None:
+            print("%-44s %12s %12.4f %8s" % (name, "-", cur["median_ms"], "new"))
+            continue
+
+        diff = cur["median_ms"] - base["median_ms"]
+        change = diff / base["median_ms"] if base["median_ms"] > 0 else 0.0
+        noise = args.noise * max(base["mad_ms"], cur["mad_ms"])
+
+        verdict = ""
+        if change > args.threshold and diff > noise:
+            verdict = "  REGRESSION"
+            regressions += 1
+        elif change < -args.threshold and -diff > noise:
+            verdict = "  faster"
+
+        print("%-44s %12.4f %12.4f %+7.1f%%%s" % (
+            name, base["median_ms"], cur["median_ms"], 100.0 * change, verdict))
+
+    for name in baseline:
+        if name not in results:
+            print("%-44s %12.4f %12s %8s" % (name, baseline[name]["median_ms"], "-", "missing"))
+
+    if regressions:
+        print("%d regression(s)" % regressions)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
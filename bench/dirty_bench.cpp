@@ -0,0 +1,227 @@
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// GLFW
+#include <GLFW/glfw3.h>
+
+// CUSTOM
+#include "../engine/window.hpp"
+#include "../engine/shaders.hpp"
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+#include <vector>
+
+// Sections marked dirty by edits: neighbours across section borders, one
+// mark however often a section changes within a tick, and the nearest ones
+// let through first within the rebuild budget; and what choosing them costs.
+//
+// Sections rebuilt while drawing before their turn are checked with an
+// invisible window, from the repository root; skipped without a display.
+
+#define WORLD_WIDTH 128
+#define WORLD_HEIGHT 64
+#define WORLD_SEED 1337
+#define EDITS 10000
+#define BUDGET 8
+
+// sections dirty right now
+std::vector<int> dirty_sections(GameWorld& world)
+{
+    std::vector<int> sections;
+    for(int s = 0; s < world.SectionCount(); s++)
+        if(world.SectionDirty(s)) {
+            sections.push_back(s);
+        }
+    return sections;
+}
+
+// every dirty section released, the next tick starts clean
+void settle(GameWorld& world)
+{
+    world.SetRebuildBudget(0);
+    world.RebuildDirty(glm::vec3(0.0f), 1.0f);
+    world.Tick();
+}
+
+bool check_neighbours()
+{
+    GameWorld world(3 * SECTION_SIZE, 3 * SECTION_SIZE, 3 * SECTION_SIZE);
+    settle(world);
+    const int m = SECTION_SIZE; // first block of the middle section
+    const int middle = world.SectionAt(m, m, m);
+
+    // inside a section, on a face, on an edge and in a corner
+    world.InsertBlock(m + 5, m + 5, m + 5, BLOCK_TYPE_STONE);
+    bool ok = dirty_sections(world) == std::vector<int>(1, middle);
+    settle(world);
+    world.InsertBlock(m, m + 5, m + 5, BLOCK_TYPE_STONE);
+    ok = ok && dirty_sections(world).size() == 2 && world.SectionDirty(world.SectionAt(m - 1, m, m));
+    settle(world);
+    world.InsertBlock(m + SECTION_SIZE - 1, m, m + 5, BLOCK_TYPE_STONE);
+    ok = ok && dirty_sections(world).size() == 3;
+    settle(world);
+    world.InsertBlock(m, m, m, BLOCK_TYPE_STONE);
+    ok = ok && dirty_sections(world).size() == 4 && world.SectionDirty(world.SectionAt(m, m, m - 1));
+    settle(world);
+
+    // damage and the level of fluids change no mesh
+    world.DecreaseBlockHealth(m + 5, m + 5, m + 5, 1);
+    ok = ok && world.DirtyCount() == 0;
+
+    // a bulk edit marks the sections it touches, and those across the
+    // borders it reaches; here only the two it spans
+    world.FillBox(m + 2, m + 2, m + 2, m + 4, m + 4, 2 * m, _block_t(BLOCK_TYPE_SAND));
+    ok = ok && world.DirtyCount() == 2 && world.SectionDirty(world.SectionAt(m, m, 2 * m));
+    world.Tick();
+    ok = ok && world.DirtyStats().dirtied == 2 && world.DirtyStats().edits == 3 * 3 * 15 + 1 &&
+         world.DirtyStats().pending == 2;
+    return ok;
+}
+
+bool check_coalescing(GameWorld& world)
+{
+    settle(world);
+    srand(3);
+    for(int i = 0; i < EDITS; i++)
+    {
+        int x = rand() % WORLD_WIDTH, y = rand() % WORLD_HEIGHT, z = rand() % WORLD_WIDTH;
+        if(!world.InsertBlock(x, y, z, BLOCK_TYPE_STONE)) {
+            world.DeleteBlock(x, y, z);
+        }
+    }
+    size_t dirty = world.DirtyCount();
+    world.Tick();
+    const _dirty_stats_t& stats = world.DirtyStats();
+    bool ok = stats.edits == EDITS && stats.dirtied == dirty && dirty <= (size_t)world.SectionCount();
+
+    // the nearest first, the budget at a time
+    glm::vec3 camera(3.0f, 50.0f, 100.0f);
+    world.SetRebuildBudget(BUDGET);
+    std::vector<int> before = dirty_sections(world);
+    world.RebuildDirty(camera, 1.0f);
+    std::vector<int> after = dirty_sections(world);
+    ok = ok && after.size() == before.size() - BUDGET;
+    float released = 0.0f, kept = 1e9f;
+    for(size_t i = 0; i < before.size(); i++)
+    {
+        float distance = world.SectionDistance(before[i], camera);
+        if(world.SectionDirty(before[i])) {
+            kept = std::min(kept, distance);
+        }
+        else {
+            released = std::max(released, distance);
+        }
+    }
+    ok = ok && released <= kept;
+
+    std::cout << EDITS << " edits dirtied " << dirty << " of " << world.SectionCount()
+              << " sections, " << BUDGET << " let through per frame" << std::endl;
+    return ok;
+}
+
+// a dirty section drawn at another level of detail is rebuilt before its
+// turn. Changed again, it must still be let through once, and not take the
+// budget of another section twice
+bool check_rebuilt_meanwhile()
+{
+    window::WindowedWindow* win = window::create_window("dirty section check", 200,
+                                                        window::ASPECT_RATIO_4_3, false);
+    if(win == NULL)
+    {
+        std::cout << "rebuilt meanwhile check skipped, no window" << std::endl;
+        return true;
+    }
+    GLuint shader = shaders::loadShadersVGF("shaders|default_block_shader");
+    glUseProgram(shader);
+
+    GameWorld world(4 * SECTION_SIZE, SECTION_SIZE, SECTION_SIZE);
+    world.FillBox(0, 0, 0, 4 * SECTION_SIZE - 1, 3, SECTION_SIZE - 1, _block_t(BLOCK_TYPE_STONE));
+    std::vector<unsigned char> lods(world.SectionCount(), 0);
+    world.DrawBlocks(shader, 1, NULL, &lods);
+
+    // the first section waits for the second, then is drawn merged
+    const int first = 0, second = 1, last = 3;
+    glm::vec3 near_second(1.5f * SECTION_SIZE, 0.0f, 0.0f);
+    world.SetRebuildBudget(1);
+    world.InsertBlock(5, 8, 5, BLOCK_TYPE_STONE);
+    world.InsertBlock(SECTION_SIZE + 5, 8, 5, BLOCK_TYPE_STONE);
+    world.RebuildDirty(near_second, 1.0f);
+    bool ok = world.SectionDirty(first) && !world.SectionDirty(second);
+    lods[first] = 1;
+    world.DrawBlocks(shader, 1, NULL, &lods);
+    ok = ok && !world.SectionDirty(first) && world.DirtyCount() == 0;
+
+    // changed again, with a section further away
+    world.DeleteBlock(5, 8, 5);
+    world.InsertBlock(3 * SECTION_SIZE + 5, 8, 5, BLOCK_TYPE_STONE);
+    world.SetRebuildBudget(2);
+    world.RebuildDirty(glm::vec3(0.0f), 1.0f);
+    ok = ok && world.DirtyCount() == 0 && !world.SectionDirty(first) && !world.SectionDirty(last);
+
+    glDeleteProgram(shader);
+    delete win;
+    glfwTerminate();
+    return ok;
+}
+
+void bench_dirty(GameWorld& world)
+{
+    srand(5);
+    bench::run("10k edits, marking sections dirty", 20, [&]() {
+        for(int i = 0; i < EDITS; i++)
+        {
+            int x = rand() % WORLD_WIDTH, y = rand() % WORLD_HEIGHT, z = rand() % WORLD_WIDTH;
+            if(!world.InsertBlock(x, y, z, BLOCK_TYPE_STONE)) {
+                world.DeleteBlock(x, y, z);
+            }
+        }
+        bench::keep(world.DirtyCount());
+    });
+
+    // every section dirty, one block each, and the nearest few picked
+    glm::vec3 camera(64.0f, 40.0f, 64.0f);
+    world.SetRebuildBudget(BUDGET);
+    auto touch_sections = [&]() {
+        for(int s = 0; s < world.SectionCount(); s++)
+        {
+            int x0, y0, z0, x1, y1, z1;
+            world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+            if(!world.InsertBlock(x0 + 5, y0 + 5, z0 + 5, BLOCK_TYPE_STONE)) {
+                world.DeleteBlock(x0 + 5, y0 + 5, z0 + 5);
+            }
+        }
+    };
+    bench::run("dirty every section", 100, [&]() {
+        touch_sections();
+        bench::keep(world.DirtyCount());
+    });
+    bench::run("dirty every section, pick the nearest 8", 100, [&]() {
+        touch_sections();
+        world.RebuildDirty(camera, 1.0f);
+        bench::keep(world.DirtyCount());
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    GameWorld world(WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH);
+    world_generator::generate_terrain(&world, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, WORLD_SEED);
+
+    bool ok = check_neighbours();
+    ok = check_coalescing(world) && ok;
+    ok = check_rebuilt_meanwhile() && ok;
+    std::cout << "dirty section check " << (ok ? "passed" : "FAILED") << std::endl;
+    bench_dirty(world);
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
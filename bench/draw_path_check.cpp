@@ -0,0 +1,190 @@
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// GLFW
+#include <GLFW/glfw3.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// CUSTOM
+#include "../engine/window.hpp"
+#include "../engine/shaders.hpp"
+#include "../engine/texture.hpp"
+#include "../engine/camera.hpp"
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+
+// STANDARD
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// Renders the same views of a generated world through both draw paths of
+// `GameWorld::DrawBlocks', compute shader culling with indirect draws and
+// plain multi draws, and once more drawing every face of every block, and
+// compares the pixels. Exits with 1 on a mismatch, writing the images as
+// PPM files next to the program's working directory.
+//
+// Runs from the repository root and needs a display. Without one, use Mesa:
+//   xvfb-run -a env LIBGL_ALWAYS_SOFTWARE=1 bench/draw_path_check
+
+#define WORLD_SIZE 64
+#define WORLD_HEIGHT 32
+#define BLOCK_SIZE 10
+#define VIEWS 8
+
+// share of the drawn pixels that may differ from drawing all faces: on the
+// edge between a drawn face and a hidden one both are at the same depth,
+// and either may win
+#define HIDDEN_FACE_TOLERANCE 0.001
+
+// whether the camera is within a block, from where the faces culled would
+// be seen from behind
+bool inside_block(GameWorld& world, const glm::vec3& position)
+{
+    int x = (int)std::floor(position.x / BLOCK_SIZE + 0.5f);
+    int y = (int)std::floor(position.y / BLOCK_SIZE + 0.5f);
+    int z = (int)std::floor(position.z / BLOCK_SIZE + 0.5f);
+    return world.InBounds(x, y, z) && world.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+}
+
+void write_ppm(const std::string& path, const std::vector<unsigned char>& pixels,
+               int width, int height)
+{
+    std::ofstream file(path.c_str(), std::ios::out | std::ios::binary);
+    file << "P6\n" << width << " " << height << "\n255\n";
+    // GL rows start at the bottom
+    for(int y = height - 1; y >= 0; y--) {
+        for(int x = 0; x < width; x++) {
+            file.write((const char*)&pixels[(y * width + x) * 4], 3);
+        }
+    }
+}
+
+void render(GameWorld& world, GLuint shader, camera::BasicFPSCamera& cam, bool gpu,
+            int width, int height, std::vector<unsigned char>& pixels)
+{
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    cam.CalculatePosition();
+    glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE,
+                       glm::value_ptr(*cam.ViewMatrix()));
+    glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE,
+                       glm::value_ptr(*cam.ProjectionMatrix()));
+    glm::mat4 view_projection = *cam.ProjectionMatrix() * *cam.ViewMatrix();
+
+    world.DrawBlocks(shader, BLOCK_SIZE, NULL, NULL, gpu ? &view_projection : NULL);
+
+    pixels.resize(width * height * 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+}
+
+int main()
+{
+    window::WindowedWindow* win = window::create_window("draw path check", 400,
+                                                        window::ASPECT_RATIO_4_3, false);
+    if(win == NULL) {
+        return 1;
+    }
+
+    GameWorld world(WORLD_SIZE, WORLD_HEIGHT, WORLD_SIZE);
+    world_generator::generate_terrain(&world, WORLD_SIZE, WORLD_HEIGHT, WORLD_SIZE, 1337);
+
+    GLuint shader = shaders::loadShadersVGF("shaders|default_block_shader");
+    glUseProgram(shader);
+    Texture tex0 = Texture("assets|images|grass|side.png", TEX_GENERATE_MIPMAP | TEX_MIXED_FILTER);
+    Texture tex1 = Texture("assets|images|grass|top.png", TEX_GENERATE_MIPMAP | TEX_MIXED_FILTER);
+    Texture tex2 = Texture("assets|images|grass|bottom.png", TEX_GENERATE_MIPMAP | TEX_MIXED_FILTER);
+    GLuint textures[3] = { tex0.GetTexture(), tex1.GetTexture(), tex2.GetTexture() };
+    const char* names[3] = { "texture0", "texture1", "texture2" };
+    for(int t = 0; t < 3; t++)
+    {
+        glActiveTexture(GL_TEXTURE0 + t);
+        glBindTexture(GL_TEXTURE_2D, textures[t]);
+        glUniform1i(glGetUniformLocation(shader, names[t]), t);
+    }
+    glUniform1f(glGetUniformLocation(shader, "sz"), BLOCK_SIZE / 2.0f);
+    glEnable(GL_DEPTH_TEST);
+
+    // find out whether the GPU path is there at all
+    camera::BasicFPSCamera cam(win->Window(), win->width, win->height);
+    std::vector<unsigned char> gpu, cpu, all_faces;
+    if(!world.WaitForGpuCulling())
+    {
+        std::cout << "draw path check skipped, OpenGL 4.3 is not available: "
+                  << (const char*)glGetString(GL_VERSION) << std::endl;
+        delete win;
+        glfwTerminate();
+        return 0;
+    }
+
+    // around the world, looking inwards and outwards, so that some
+    // sections are always culled
+    bool ok = true;
+    for(int v = 0; v < VIEWS; v++)
+    {
+        float angle = 2.0f * 3.14159265f * v / VIEWS;
+        float center = WORLD_SIZE * BLOCK_SIZE / 2.0f;
+        float radius = WORLD_SIZE * BLOCK_SIZE * 0.4f;
+        cam.SetInitialPosition(center + radius * std::cos(angle), WORLD_HEIGHT * BLOCK_SIZE * 0.6f,
+                               center + radius * std::sin(angle));
+        float look = (v % 2 == 0) ? 0.0f : 2.0f * radius;
+        cam.LookAt(center + look * std::cos(angle), WORLD_HEIGHT * BLOCK_SIZE * 0.2f,
+                   center + look * std::sin(angle));
+
+        render(world, shader, cam, true, win->width, win->height, gpu);
+        render(world, shader, cam, false, win->width, win->height, cpu);
+        world.SetFaceCulling(false);
+        render(world, shader, cam, false, win->width, win->height, all_faces);
+        world.SetFaceCulling(true);
+
+        size_t differing = 0, hidden_differing = 0, drawn = 0;
+        for(size_t p = 0; p < gpu.size(); p += 4)
+        {
+            bool same = true, same_hidden = true;
+            for(int c = 0; c < 3; c++)
+            {
+                same = same && std::abs((int)gpu[p + c] - (int)cpu[p + c]) <= 1;
+                same_hidden = same_hidden && std::abs((int)all_faces[p + c] - (int)cpu[p + c]) <= 1;
+            }
+            differing += !same;
+            hidden_differing += !same_hidden;
+            drawn += cpu[p] || cpu[p + 1] || cpu[p + 2];
+        }
+
+        bool inside = inside_block(world, cam.Position());
+        std::cout << "view " << v << ": " << drawn << " pixels drawn, "
+                  << differing << " differ, " << hidden_differing
+                  << " differ from drawing all faces" << (inside ? " (inside a block)" : "")
+                  << std::endl;
+        if(inside) {
+            hidden_differing = 0;
+        }
+        if(differing > 0 || hidden_differing > drawn * HIDDEN_FACE_TOLERANCE || drawn == 0)
+        {
+            std::ostringstream name;
+            name << "draw_path_" << v;
+            write_ppm(name.str() + "_gpu.ppm", gpu, win->width, win->height);
+            write_ppm(name.str() + "_cpu.ppm", cpu, win->width, win->height);
+            write_ppm(name.str() + "_all_faces.ppm", all_faces, win->width, win->height);
+            ok = false;
+        }
+    }
+
+    std::cout << "draw path check " << (ok ? "passed" : "FAILED") << ", "
+              << (const char*)glGetString(GL_RENDERER) << std::endl;
+
+    glDeleteProgram(shader);
+    delete win;
+    glfwTerminate();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,149 @@
+
+// CUSTOM
+#include "../engine/ecs.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+#include <vector>
+
+// lifetime of dropped items, in ticks
+struct Lifetime
+{
+    Lifetime() : ticks(0) {}
+    Lifetime(int ticks) : ticks(ticks) {}
+    int ticks;
+};
+
+// marks an entity as a mob, gives the mobs their own archetype
+struct Mob
+{
+    int health;
+};
+
+float random_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+ecs::Entity spawn_item(ecs::Registry& reg, const glm::vec3& at, int lifetime)
+{
+    ecs::Entity e = reg.Create();
+    reg.Add(e, ecs::Position(at.x, at.y, at.z));
+    reg.Add(e, ecs::Velocity(random_float(-1, 1), 2.0f, random_float(-1, 1)));
+    reg.Add(e, ecs::Collider(0.125f, 0.125f, 0.125f));
+    reg.Add(e, Lifetime(lifetime));
+    return e;
+}
+
+void populate(ecs::Registry& reg, int mobs, int items)
+{
+    for(int i = 0; i < mobs; i++)
+    {
+        ecs::Entity e = reg.Create();
+        reg.Add(e, ecs::Position(random_float(0, 512), 64.0f, random_float(0, 512)));
+        reg.Add(e, ecs::Velocity(random_float(-1, 1), 0.0f, random_float(-1, 1)));
+        reg.Add(e, ecs::Collider(0.3f, 0.9f, 0.3f));
+        Mob mob = { 20 };
+        reg.Add(e, mob);
+    }
+    for(int i = 0; i < items; i++)
+    {
+        spawn_item(reg, glm::vec3(random_float(0, 512), 64.0f, random_float(0, 512)),
+                   1 << 30);
+    }
+}
+
+void bench_iteration(int count)
+{
+    ecs::Registry reg;
+    populate(reg, count / 2, count / 2);
+    std::string n = std::to_string(count);
+
+    bench::run("iterate pos/vel/col, " + n, 200, [&]() {
+        float sum = 0.0f;
+        reg.Each<ecs::Position, ecs::Velocity, ecs::Collider>(
+            [&](ecs::Entity, ecs::Position& p, ecs::Velocity& v, ecs::Collider& c) {
+                p.value += v.value * 0.05f;
+                sum += c.half_extents.y;
+            });
+        bench::keep(sum);
+    });
+
+    bench::run("integrate_velocities, " + n, 200, [&]() {
+        ecs::integrate_velocities(reg, 0.05f);
+    });
+}
+
+void bench_add_remove(int count)
+{
+    ecs::Registry reg;
+    populate(reg, count, 0);
+    std::vector<ecs::Entity> entities;
+    reg.Each<Mob>([&](ecs::Entity e, Mob&) { entities.push_back(e); });
+    std::string n = std::to_string(count);
+
+    bench::run("remove+add velocity, " + n, 20, [&]() {
+        for(size_t i = 0; i < entities.size(); i++) {
+            reg.Remove<ecs::Velocity>(entities[i]);
+        }
+        for(size_t i = 0; i < entities.size(); i++) {
+            reg.Add(entities[i], ecs::Velocity(0.0f, 0.0f, 1.0f));
+        }
+    });
+
+    bench::run("create+destroy, " + n, 20, [&]() {
+        std::vector<ecs::Entity> tmp;
+        tmp.reserve(count);
+        for(int i = 0; i < count; i++) {
+            tmp.push_back(spawn_item(reg, glm::vec3(0.0f), 10));
+        }
+        for(size_t i = 0; i < tmp.size(); i++) {
+            reg.Destroy(tmp[i]);
+        }
+    });
+}
+
+// every tick, each mob drops an item with some probability, and items
+// that ran out of time despawn. All structural changes happen inside
+// queries and are therefore deferred.
+void bench_spawn_stress(int mobs, int ticks)
+{
+    ecs::Registry reg;
+    populate(reg, mobs, 0);
+    size_t peak = 0;
+
+    bench::run("spawn stress tick, " + std::to_string(mobs) + " mobs", ticks, [&]() {
+        reg.Each<ecs::Position, Mob>([&](ecs::Entity, ecs::Position& p, Mob&) {
+            if(rand() % 8 == 0) {
+                spawn_item(reg, p.value, 20 + rand() % 40);
+            }
+        });
+        reg.Each<Lifetime>([&](ecs::Entity e, Lifetime& l) {
+            if(--l.ticks <= 0) {
+                reg.Destroy(e);
+            }
+        });
+        ecs::integrate_velocities(reg, 0.05f);
+        if(reg.Count() > peak) {
+            peak = reg.Count();
+        }
+    });
+
+    std::cout << "  peak entities " << peak
+              << ", archetypes " << reg.ArchetypeCount() << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+    srand(1);
+
+    bench_iteration(10000);
+    bench_iteration(100000);
+    bench_add_remove(10000);
+    bench_add_remove(100000);
+    bench_spawn_stress(20000, 200);
+
+    return bench::finish();
+}
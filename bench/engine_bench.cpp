@@ -0,0 +1,160 @@
+
+// CUSTOM
+#include "../game_world.hpp"
+#include "../engine/fileIO.hpp"
+#include "../engine/camera.hpp"
+#include "bench.hpp"
+
+// SOIL
+#include <SOIL/SOIL.h>
+
+// STANDARD
+#include <cstdlib>
+#include <vector>
+
+// Engine microbenchmarks, run from the repository root so the shader and
+// texture files are found. None of them needs an OpenGL context.
+
+#define WORLD_SIZE 64
+
+void bench_world()
+{
+    GameWorld world(WORLD_SIZE, WORLD_SIZE, WORLD_SIZE);
+    std::string n = std::to_string(WORLD_SIZE) + "^3";
+
+    // x innermost follows the memory layout, z innermost jumps a whole
+    // layer per step
+    bench::run("InsertBlock+DeleteBlock x-inner, " + n, 30, [&]() {
+        for(int z = 0; z < WORLD_SIZE; z++)
+            for(int y = 0; y < WORLD_SIZE; y++)
+                for(int x = 0; x < WORLD_SIZE; x++)
+                    world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+        for(int z = 0; z < WORLD_SIZE; z++)
+            for(int y = 0; y < WORLD_SIZE; y++)
+                for(int x = 0; x < WORLD_SIZE; x++)
+                    world.DeleteBlock(x, y, z);
+    });
+
+    bench::run("InsertBlock+DeleteBlock z-inner, " + n, 30, [&]() {
+        for(int x = 0; x < WORLD_SIZE; x++)
+            for(int y = 0; y < WORLD_SIZE; y++)
+                for(int z = 0; z < WORLD_SIZE; z++)
+                    world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+        for(int x = 0; x < WORLD_SIZE; x++)
+            for(int y = 0; y < WORLD_SIZE; y++)
+                for(int z = 0; z < WORLD_SIZE; z++)
+                    world.DeleteBlock(x, y, z);
+    });
+
+    // every other block solid, so lookups cannot be predicted
+    for(int z = 0; z < WORLD_SIZE; z++)
+        for(int y = 0; y < WORLD_SIZE; y++)
+            for(int x = (y + z) % 2; x < WORLD_SIZE; x += 2)
+                world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+
+    bench::run("GetBlockType x-inner, " + n, 50, [&]() {
+        int solid = 0;
+        for(int z = 0; z < WORLD_SIZE; z++)
+            for(int y = 0; y < WORLD_SIZE; y++)
+                for(int x = 0; x < WORLD_SIZE; x++)
+                    solid += world.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+        bench::keep(solid);
+    });
+
+    bench::run("GetBlockType z-inner, " + n, 50, [&]() {
+        int solid = 0;
+        for(int x = 0; x < WORLD_SIZE; x++)
+            for(int y = 0; y < WORLD_SIZE; y++)
+                for(int z = 0; z < WORLD_SIZE; z++)
+                    solid += world.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+        bench::keep(solid);
+    });
+
+    std::vector<int> coords;
+    for(int i = 0; i < WORLD_SIZE * WORLD_SIZE * WORLD_SIZE; i++) {
+        coords.push_back(rand() % (WORLD_SIZE * WORLD_SIZE * WORLD_SIZE));
+    }
+    bench::run("GetBlockType random, " + n, 50, [&]() {
+        int solid = 0;
+        for(size_t i = 0; i < coords.size(); i++)
+        {
+            int c = coords[i];
+            solid += world.GetBlockType(c % WORLD_SIZE, (c / WORLD_SIZE) % WORLD_SIZE,
+                                        c / (WORLD_SIZE * WORLD_SIZE)) != BLOCK_TYPE_NONE;
+        }
+        bench::keep(solid);
+    });
+}
+
+void bench_file_io()
+{
+    std::string path = fileIO::getPlatformFilePath("shaders|default_block_shader|geometry.shd");
+    if(fileIO::readFileContents(path.c_str()).empty()) {
+        std::cerr << "  (run from the repository root)" << std::endl;
+    }
+
+    bench::run("readFileContents geometry shader", 1000, [&]() {
+        std::string content = fileIO::readFileContents(path.c_str());
+        bench::keep(content);
+    });
+
+    bench::run("getPlatformFilePath x1000", 100, [&]() {
+        for(int i = 0; i < 1000; i++)
+        {
+            std::string p = fileIO::getPlatformFilePath("assets|images|grass|side.png");
+            bench::keep(p);
+        }
+    });
+}
+
+void bench_camera()
+{
+    camera::BasicFPSCamera cam(NULL, 800.0f, 600.0f);
+
+    bench::run("camera look+CalculatePosition x1000", 100, [&]() {
+        for(int i = 0; i < 1000; i++)
+        {
+            cam.MouseCallback(NULL, 400.0 + (i % 7), 300.0 - (i % 5));
+            cam.MoveForwards(0.01f);
+            cam.CalculatePosition();
+            bench::keep(*cam.ViewMatrix());
+        }
+    });
+}
+
+void bench_texture_decode()
+{
+    static const char* files[] = {
+        "assets|images|grass|side.png",
+        "assets|images|grass|bottom.jpg"
+    };
+    for(int f = 0; f < 2; f++)
+    {
+        std::string path = fileIO::getPlatformFilePath(files[f]);
+        bool rgba = fileIO::getFileExtension(path) == "png";
+        bench::run("decode " + path, 100, [&]() {
+            int width, height;
+            unsigned char* image = SOIL_load_image(path.c_str(), &width, &height, 0,
+                                                   rgba ? SOIL_LOAD_RGBA : SOIL_LOAD_RGB);
+            if(image == NULL) {
+                std::cerr << "Could not read image '" << path << "'" << std::endl;
+                return;
+            }
+            bench::keep(image[0]);
+            SOIL_free_image_data(image);
+        });
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+    srand(1);
+
+    bench_world();
+    bench_file_io();
+    bench_camera();
+    bench_texture_decode();
+
+    return bench::finish();
+}
@@ -0,0 +1,179 @@
+
+// CUSTOM
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+#include <vector>
+
+// Visible faces of every block of a world, found from the occupancy columns
+// of `GameWorld::SectionFaces' and, for comparison, by looking at the six
+// neighbours of every block in a plain array of the world.
+
+#define WORLD_WIDTH 128
+#define WORLD_HEIGHT 64
+#define WORLD_SEED 1337
+
+static const int offsets[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 },
+    { 0, -1, 0 }, { 0, 1, 0 },
+    { 0, 0, -1 }, { 0, 0, 1 }
+};
+
+// whether each block of the world is not air, x fastest
+struct DenseWorld
+{
+    int width, height, depth;
+    std::vector<unsigned char> occupied;
+
+    DenseWorld(GameWorld& world, int w, int h, int d) : width(w), height(h), depth(d)
+    {
+        occupied.resize((size_t)w * h * d);
+        for(int z = 0; z < d; z++)
+            for(int y = 0; y < h; y++)
+                for(int x = 0; x < w; x++)
+                    occupied[((size_t)z * h + y) * w + x] =
+                        world.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+    }
+
+    bool At(int x, int y, int z) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth &&
+               occupied[((size_t)z * height + y) * width + x];
+    }
+};
+
+// the masks of one section like `SectionFaces', a neighbour at a time
+size_t section_faces_per_voxel(const DenseWorld& dense, GameWorld& world, int section,
+                               unsigned char* faces)
+{
+    memset(faces, 0, SECTION_BLOCKS);
+    int x0, y0, z0, x1, y1, z1;
+    world.SectionBlocks(section, x0, y0, z0, x1, y1, z1);
+    size_t visible = 0;
+    for(int z = z0; z <= z1; z++)
+        for(int y = y0; y <= y1; y++)
+            for(int x = x0; x <= x1; x++)
+            {
+                if(!dense.At(x, y, z)) {
+                    continue;
+                }
+                unsigned char mask = 0;
+                for(int f = 0; f < 6; f++)
+                {
+                    if(!dense.At(x + offsets[f][0], y + offsets[f][1], z + offsets[f][2]))
+                    {
+                        mask |= 1 << f;
+                        visible++;
+                    }
+                }
+                faces[((z - z0) * SECTION_SIZE + (y - y0)) * SECTION_SIZE + (x - x0)] = mask;
+            }
+    return visible;
+}
+
+// both ways agree on every block of every section
+bool same_faces(GameWorld& world, const DenseWorld& dense, size_t& visible)
+{
+    std::vector<unsigned char> bitwise(SECTION_BLOCKS), per_voxel(SECTION_BLOCKS);
+    bool ok = true;
+    visible = 0;
+    for(int s = 0; s < world.SectionCount(); s++)
+    {
+        size_t a = world.SectionFaces(s, &bitwise[0]);
+        size_t b = section_faces_per_voxel(dense, world, s, &per_voxel[0]);
+        ok = ok && a == b && bitwise == per_voxel;
+        visible += a;
+    }
+    return ok;
+}
+
+bool check_faces(GameWorld& world, int width, int height, int depth, const std::string& name)
+{
+    size_t visible;
+    DenseWorld dense(world, width, height, depth);
+    bool ok = same_faces(world, dense, visible) && visible > 0;
+
+    // the columns follow edits, also across section borders
+    for(int i = 0; i < 200; i++)
+    {
+        int x = (rand() % (width / SECTION_SIZE)) * SECTION_SIZE + (i % 2 ? SECTION_SIZE - 1 : 0);
+        int y = rand() % height, z = rand() % depth;
+        if(world.GetBlockType(x, y, z) == BLOCK_TYPE_NONE) {
+            world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+        }
+        else {
+            world.DeleteBlock(x, y, z);
+        }
+    }
+    size_t edited;
+    ok = ok && same_faces(world, DenseWorld(world, width, height, depth), edited);
+
+    std::cout << name << ": " << visible << " visible faces" << std::endl;
+    return ok;
+}
+
+void bench_faces(GameWorld& world, int width, int height, int depth, const std::string& name)
+{
+    DenseWorld dense(world, width, height, depth);
+    std::vector<unsigned char> faces(SECTION_BLOCKS);
+    double voxels = (double)world.SectionCount() * SECTION_BLOCKS;
+
+    double ms = bench::run("per voxel neighbours, " + name, 20, [&]() {
+        size_t visible = 0;
+        for(int s = 0; s < world.SectionCount(); s++) {
+            visible += section_faces_per_voxel(dense, world, s, &faces[0]);
+        }
+        bench::keep(visible);
+    });
+    std::cout << "  " << (int)(voxels / ms / 1000.0) << " Mvoxels/s" << std::endl;
+
+    ms = bench::run("occupancy columns, " + name, 20, [&]() {
+        size_t visible = 0;
+        for(int s = 0; s < world.SectionCount(); s++) {
+            visible += world.SectionFaces(s, &faces[0]);
+        }
+        bench::keep(visible);
+    });
+    std::cout << "  " << (int)(voxels / ms / 1000.0) << " Mvoxels/s" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    // generated terrain, and half of the blocks filled at random, which
+    // leaves faces to find nearly everywhere
+    GameWorld terrain(WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH);
+    world_generator::generate_terrain(&terrain, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, WORLD_SEED);
+    GameWorld noise(WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH);
+    srand(1);
+    for(int z = 0; z < WORLD_WIDTH; z++)
+        for(int y = 0; y < WORLD_HEIGHT; y++)
+            for(int x = 0; x < WORLD_WIDTH; x++)
+                if(rand() % 2) {
+                    noise.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+                }
+
+    bench_faces(terrain, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, "terrain");
+    bench_faces(noise, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, "noise");
+
+    // and a world ending within its last sections
+    GameWorld partial(40, 20, 24);
+    for(int z = 0; z < 24; z++)
+        for(int y = 0; y < 20; y++)
+            for(int x = 0; x < 40; x++)
+                if(rand() % 3) {
+                    partial.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+                }
+
+    bool ok = check_faces(terrain, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, "terrain");
+    ok = check_faces(noise, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, "noise") && ok;
+    ok = check_faces(partial, 40, 20, 24, "partial sections") && ok;
+    std::cout << "face culling check " << (ok ? "passed" : "FAILED") << std::endl;
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
@@ -0,0 +1,120 @@
+
+// CUSTOM
+#include "../fluid_simulation.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <vector>
+
+// plain block grid, just enough of a world for the simulation
+class Grid
+{
+public:
+    int width, height, depth;
+    std::vector<_block_t> blocks;
+
+    Grid(int w, int h, int d) : width(w), height(h), depth(d)
+    {
+        blocks.resize((size_t)w * h * d);
+    }
+
+    bool InBounds(int x, int y, int z) const
+    {
+        return x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < depth;
+    }
+
+    const _block_t& BlockAt(int x, int y, int z) const
+    {
+        return blocks[((size_t)z * height + y) * width + x];
+    }
+
+    void SetBlock(int x, int y, int z, const _block_t& block)
+    {
+        blocks[((size_t)z * height + y) * width + x] = block;
+    }
+};
+
+#define SIZE       256
+#define HEIGHT     64
+#define DAM_X      64
+#define WATER_TOP  60
+#define PLATEAU    40
+
+// a reservoir of water sources held back by a dam, above a valley that
+// descends in steps, so the flood keeps falling and travels its full length
+void build_dam(Grid& grid)
+{
+    for(int z = 0; z < SIZE; z++)
+    {
+        for(int x = 0; x < SIZE; x++)
+        {
+            int floor = (x <= DAM_X) ? PLATEAU : std::max(1, PLATEAU - (x - DAM_X) / 6);
+            for(int y = 0; y < floor; y++) {
+                grid.SetBlock(x, y, z, _block_t(BLOCK_TYPE_STONE));
+            }
+            if(x < DAM_X)
+            {
+                for(int y = floor; y < WATER_TOP; y++)
+                {
+                    _block_t water(BLOCK_TYPE_WATER);
+                    water.level = FLUID_SOURCE;
+                    grid.SetBlock(x, y, z, water);
+                }
+            }
+            else if(x == DAM_X)
+            {
+                for(int y = floor; y < HEIGHT; y++) {
+                    grid.SetBlock(x, y, z, _block_t(BLOCK_TYPE_STONE));
+                }
+            }
+        }
+    }
+}
+
+void dam_break(unsigned int threads)
+{
+    Grid grid(SIZE, HEIGHT, SIZE);
+    build_dam(grid);
+    FluidSimulation sim(SIZE, HEIGHT, SIZE, threads);
+
+    // break the dam
+    for(int z = 0; z < SIZE; z++)
+    {
+        for(int y = PLATEAU; y < HEIGHT; y++)
+        {
+            grid.SetBlock(DAM_X, y, z, _block_t());
+            sim.ActivateAround(DAM_X, y, z);
+        }
+    }
+
+    size_t steps = 0, updated = 0, changed = 0, peak = 0;
+    bench::Stopwatch sw;
+    while(!sim.Asleep())
+    {
+        sim.Step(grid);
+        updated += sim.Stats().cells_updated;
+        changed += sim.Stats().cells_changed;
+        peak = std::max(peak, sim.Stats().active);
+        steps++;
+    }
+    double ms = sw.ElapsedMs();
+
+    size_t wet = 0;
+    for(size_t i = 0; i < grid.blocks.size(); i++) {
+        wet += is_fluid(grid.blocks[i].type);
+    }
+
+    std::cout << "dam break, " << threads << " thread(s)" << std::endl
+              << "  " << steps << " steps until asleep, " << ms << " ms, "
+              << "peak active " << peak << ", fluid cells " << wet << std::endl
+              << "  " << updated << " cells updated, " << changed << " changed, "
+              << (updated / (ms / 1000.0) / 1e6) << " M cells/s" << std::endl;
+}
+
+int main()
+{
+    dam_break(1);
+    dam_break(std::max(1u, std::thread::hardware_concurrency()));
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+
+// count every allocation of this program
+#define ALLOC_COUNTER_ENABLED
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// GLFW
+#include <GLFW/glfw3.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// CUSTOM
+#include "../engine/alloc_counter.hpp"
+#include "../engine/frame_arena.hpp"
+#include "../engine/window.hpp"
+#include "../engine/shaders.hpp"
+#include "../engine/texture.hpp"
+#include "../engine/camera.hpp"
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+
+// STANDARD
+#include <cmath>
+#include <iostream>
+
+// Renders frames of a generated world with the camera turning on the spot,
+// so no mesh is rebuilt, and fails if any of them allocates from the heap,
+// on both draw paths of `GameWorld::DrawBlocks'. Checks the frame arena
+// itself first, which needs no OpenGL.
+//
+// Runs from the repository root and needs a display. Without one, use Mesa:
+//   xvfb-run -a env LIBGL_ALWAYS_SOFTWARE=1 bench/frame_alloc_check
+
+#define WORLD_SIZE 64
+#define WORLD_HEIGHT 32
+#define BLOCK_SIZE 10
+#define WARMUP_FRAMES 30
+#define FRAMES 120
+
+// bump allocation, scopes, and overflows freed and folded into the block
+bool check_arena()
+{
+    frame_arena::FrameArena arena(256);
+    bool ok = true;
+
+    void* a = arena.Allocate(10);
+    void* b = arena.Allocate(8, 8);
+    ok = ok && (size_t)a % FRAME_ARENA_ALIGNMENT == 0 && (size_t)b % 8 == 0;
+    ok = ok && (unsigned char*)b >= (unsigned char*)a + 10;
+
+    frame_arena::FrameArena::_mark_t mark = arena.Mark();
+    arena.Allocate(100);
+    arena.Allocate(200); // does not fit
+    ok = ok && arena.Stats().overflows == 1 && arena.Stats().overflow_bytes == 200;
+    arena.Rewind(mark);
+    ok = ok && arena.Stats().used == mark.used && arena.Stats().overflow_bytes == 0;
+    ok = ok && arena.Allocate(16) == (unsigned char*)a + 32;
+
+    // the next frames fit without overflowing
+    size_t high_water = arena.Stats().high_water;
+    arena.Reset();
+    ok = ok && arena.Stats().used == 0 && arena.Stats().capacity >= high_water;
+    size_t allocations = alloc_counter::Allocations();
+    arena.Allocate(high_water);
+    ok = ok && arena.Stats().overflows == 1 && alloc_counter::Allocations() == allocations;
+
+    // containers give back their memory with the scope. The first call
+    // creates the thread's arena, which allocates
+    size_t used = frame_arena::Frame().Stats().used;
+    allocations = alloc_counter::Allocations();
+    {
+        frame_arena::Scope scope;
+        frame_arena::Vector<int> values;
+        for(int i = 0; i < 1000; i++) {
+            values.push_back(i);
+        }
+        ok = ok && values[999] == 999 && frame_arena::Frame().Stats().used > used;
+    }
+    ok = ok && frame_arena::Frame().Stats().used == used;
+    ok = ok && alloc_counter::Allocations() == allocations;
+
+    std::cout << "frame arena check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+// heap allocations of the frames after the warmup
+size_t render_frames(GameWorld& world, GLuint shader, camera::BasicFPSCamera& cam,
+                     GLFWwindow* window, bool gpu)
+{
+    size_t allocations = 0;
+    float center = WORLD_SIZE * BLOCK_SIZE / 2.0f;
+    for(int frame = 0; frame < WARMUP_FRAMES + FRAMES; frame++)
+    {
+        size_t start = alloc_counter::Allocations();
+        frame_arena::Frame().Reset();
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        float angle = 2.0f * 3.14159265f * frame / FRAMES;
+        cam.LookAt(center + 100.0f * std::cos(angle), WORLD_HEIGHT * BLOCK_SIZE * 0.2f,
+                   center + 100.0f * std::sin(angle));
+        cam.CalculatePosition();
+        glUniformMatrix4fv(glGetUniformLocation(shader, "view"), 1, GL_FALSE,
+                           glm::value_ptr(*cam.ViewMatrix()));
+        glUniformMatrix4fv(glGetUniformLocation(shader, "projection"), 1, GL_FALSE,
+                           glm::value_ptr(*cam.ProjectionMatrix()));
+        glm::mat4 view_projection = *cam.ProjectionMatrix() * *cam.ViewMatrix();
+        world.DrawBlocks(shader, BLOCK_SIZE, NULL, NULL, gpu ? &view_projection : NULL);
+        glfwSwapBuffers(window);
+
+        if(frame >= WARMUP_FRAMES) {
+            allocations += alloc_counter::Allocations() - start;
+        }
+    }
+    return allocations;
+}
+
+int main()
+{
+    bool ok = check_arena();
+
+    window::WindowedWindow* win = window::create_window("frame allocation check", 400,
+                                                        window::ASPECT_RATIO_4_3, false);
+    if(win == NULL) {
+        return 1;
+    }
+
+    GameWorld world(WORLD_SIZE, WORLD_HEIGHT, WORLD_SIZE);
+    world_generator::generate_terrain(&world, WORLD_SIZE, WORLD_HEIGHT, WORLD_SIZE, 1337);
+
+    GLuint shader = shaders::loadShadersVGF("shaders|default_block_shader");
+    glUseProgram(shader);
+    glUniform1f(glGetUniformLocation(shader, "sz"), BLOCK_SIZE / 2.0f);
+    glEnable(GL_DEPTH_TEST);
+
+    camera::BasicFPSCamera cam(win->Window(), win->width, win->height);
+    cam.SetInitialPosition(WORLD_SIZE * BLOCK_SIZE / 2.0f, WORLD_HEIGHT * BLOCK_SIZE * 0.6f,
+                           WORLD_SIZE * BLOCK_SIZE / 2.0f);
+
+    bool gpu = world.WaitForGpuCulling();
+    for(int path = gpu ? 0 : 1; path < 2; path++)
+    {
+        size_t allocations = render_frames(world, shader, cam, win->Window(), path == 0);
+        std::cout << (path == 0 ? "gpu culling, indirect: " : "multi draw: ")
+                  << allocations << " heap allocations in " << FRAMES << " frames" << std::endl;
+        ok = ok && allocations == 0;
+    }
+
+    const frame_arena::_frame_arena_stats_t& arena = frame_arena::Frame().Stats();
+    std::cout << "frame allocation check " << (ok ? "passed" : "FAILED") << ", arena high water "
+              << arena.high_water << " bytes, " << arena.overflows << " overflows, "
+              << (const char*)glGetString(GL_RENDERER) << std::endl;
+
+    glDeleteProgram(shader);
+    delete win;
+    glfwTerminate();
+    return ok ? 0 : 1;
+}
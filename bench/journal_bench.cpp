@@ -0,0 +1,286 @@
+
+// CUSTOM
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+#include <vector>
+
+// Edits of a world undone and redone through the journal, checked against
+// copies of the world taken after every edit, with the history kept in
+// memory, spilled to disk and cut short; and what recording and undoing
+// edits of different sizes cost.
+
+#define CHECK_WIDTH 64
+#define CHECK_HEIGHT 48
+#define CHECK_DEPTH 48
+#define CHECK_SEED 1337
+#define CHECK_EDITS 40
+#define CHECK_MEMORY_CAP 4096 // bytes, so most of the history is spilled
+
+#define SPILL_PATH "journal_bench_spill.bin"
+
+#define BENCH_SIZE 128
+
+typedef std::vector<_block_t> Blocks;
+
+bool same_block(const _block_t& a, const _block_t& b)
+{
+    return a.type == b.type && a.health == b.health && a.level == b.level;
+}
+
+Blocks copy_world(GameWorld& world)
+{
+    Blocks blocks;
+    for(int z = 0; z < CHECK_DEPTH; z++)
+        for(int y = 0; y < CHECK_HEIGHT; y++)
+            for(int x = 0; x < CHECK_WIDTH; x++)
+                blocks.push_back(world.BlockAt(x, y, z));
+    return blocks;
+}
+
+// the blocks, and the counts of every section
+bool matches(GameWorld& world, const Blocks& blocks)
+{
+    size_t i = 0;
+    for(int z = 0; z < CHECK_DEPTH; z++)
+        for(int y = 0; y < CHECK_HEIGHT; y++)
+            for(int x = 0; x < CHECK_WIDTH; x++, i++)
+                if(!same_block(world.BlockAt(x, y, z), blocks[i])) {
+                    return false;
+                }
+    for(int s = 0; s < world.SectionCount(); s++)
+    {
+        int x0, y0, z0, x1, y1, z1, count = 0;
+        world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+        for(int z = z0; z <= z1; z++)
+            for(int y = y0; y <= y1; y++)
+                for(int x = x0; x <= x1; x++)
+                    count += world.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+        if(world.Section(s).blocks != count) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// one edit of every kind in turn, some made of several changes
+void edit(GameWorld& world, int e)
+{
+    int x = rand() % CHECK_WIDTH, y = rand() % CHECK_HEIGHT, z = rand() % CHECK_DEPTH;
+    world.BeginEdit();
+    switch(e % 5)
+    {
+    case 0:
+        for(int i = 0; i < 50; i++)
+        {
+            int bx = (x + i * 7) % CHECK_WIDTH, by = (y + i) % CHECK_HEIGHT;
+            if(!world.InsertBlock(bx, by, z, BLOCK_TYPE_SAND)) {
+                world.DeleteBlock(bx, by, z);
+            }
+        }
+        break;
+    case 1:
+        world.DecreaseBlockHealth(x, y, z, 4);
+        world.DecreaseBlockHealth(x, y, z, 4);
+        world.DecreaseBlockHealth(x, y, z, 4);
+        break;
+    case 2:
+        world.FillBox(x - 10, y - 5, z - 8, x + 10, y + 5, z + 8, _block_t(BLOCK_TYPE_STONE, e));
+        break;
+    case 3:
+        world.ReplaceInBox(0, 0, 0, CHECK_WIDTH, y, CHECK_DEPTH, BLOCK_TYPE_STONE,
+                           _block_t(BLOCK_TYPE_NONE, 0));
+        break;
+    default:
+    {
+        Clipboard clipboard;
+        world.CopyBox(x, 0, z, x + 20, 30, z + 12, clipboard);
+        world.Paste(clipboard, z, y / 2, x % CHECK_DEPTH, e, e % 2 == 1);
+        // and changed once more within the same edit
+        world.InsertBlock(z, y / 2, x % CHECK_DEPTH, BLOCK_TYPE_WATER);
+        break;
+    }
+    }
+    world.EndEdit();
+}
+
+// make the edits, undo them all and redo them all, comparing the world
+// with copies of it after every step
+bool check_history(size_t memory_cap, const std::string& spill, const std::string& name)
+{
+    GameWorld world(CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+    world_generator::generate_terrain(&world, CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH, CHECK_SEED);
+    world.Journal().SetMemoryCap(memory_cap);
+    world.Journal().SetSpillPath(spill);
+
+    srand(7);
+    std::vector<Blocks> states(1, copy_world(world));
+    bool ok = true;
+    for(int e = 0; e < CHECK_EDITS; e++)
+    {
+        // edits that changed nothing leave no transaction
+        const _journal_stats_t& stats = world.Journal().Stats();
+        size_t recorded = stats.transactions + stats.dropped;
+        edit(world, e);
+        if(stats.transactions + stats.dropped > recorded) {
+            states.push_back(copy_world(world));
+        }
+        ok = ok && world.Journal().Stats().memory_bytes <= memory_cap;
+    }
+    const _journal_stats_t& stats = world.Journal().Stats();
+    size_t undoable = stats.transactions, spilled = stats.spilled, dropped = stats.dropped;
+    size_t peak_disk = stats.disk_bytes;
+
+    size_t undone = 0;
+    while(world.Undo())
+    {
+        undone++;
+        ok = ok && matches(world, states[states.size() - 1 - undone]);
+    }
+    ok = ok && undone == undoable && stats.redoable == undone;
+    // and every disk read back
+    ok = ok && stats.disk_bytes == 0;
+
+    size_t redone = 0;
+    while(world.Redo())
+    {
+        redone++;
+        ok = ok && matches(world, states[states.size() - 1 - undone + redone]);
+    }
+    ok = ok && redone == undone && matches(world, states.back());
+
+    // a new edit after undoing one leaves nothing to redo
+    world.Undo();
+    edit(world, 0);
+    ok = ok && !world.Redo();
+
+    std::cout << name << ": " << undoable << " of " << states.size() - 1 << " edits undoable, "
+              << spilled << " spilled (" << peak_disk << " bytes), " << dropped << " dropped"
+              << std::endl;
+    return ok;
+}
+
+// a new spill path keeps the history while none of it is on disk
+bool check_spill_path()
+{
+    GameWorld world(CHECK_WIDTH, CHECK_HEIGHT, CHECK_DEPTH);
+    world.Journal().SetMemoryCap(CHECK_MEMORY_CAP);
+    world.BeginEdit();
+    world.InsertBlock(1, 1, 1, BLOCK_TYPE_STONE);
+    world.EndEdit();
+    world.Journal().SetSpillPath(SPILL_PATH);
+    bool ok = world.Journal().Stats().transactions == 1;
+
+    // scattered blocks, past the memory cap
+    for(int e = 0; e < 2; e++)
+    {
+        world.BeginEdit();
+        for(int i = 0; i < CHECK_MEMORY_CAP; i++) {
+            world.InsertBlock(rand() % CHECK_WIDTH, rand() % CHECK_HEIGHT, rand() % CHECK_DEPTH,
+                              BLOCK_TYPE_STONE);
+        }
+        world.EndEdit();
+    }
+    ok = ok && world.Journal().Stats().spilled > 0;
+    world.Journal().SetSpillPath("");
+    ok = ok && world.Journal().Stats().transactions == 0 && !world.Undo();
+    return ok;
+}
+
+bool check_journal()
+{
+    bool ok = check_history(JOURNAL_MEMORY_CAP, "", "in memory");
+    ok = check_history(CHECK_MEMORY_CAP, SPILL_PATH, "spilled to disk") && ok;
+    ok = check_history(CHECK_MEMORY_CAP, "", "cut short") && ok;
+    ok = check_spill_path() && ok;
+    std::cout << "journal check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+void bench_journal()
+{
+    GameWorld world(BENCH_SIZE, BENCH_SIZE, BENCH_SIZE);
+    const int last = BENCH_SIZE - 1;
+    double blocks = (double)BENCH_SIZE * BENCH_SIZE * BENCH_SIZE;
+
+    // the same fill without and with a transaction open
+    bench::run("FillBox 128^3 and back", 10, [&]() {
+        world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_STONE));
+        world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_NONE, 0));
+    });
+    bench::run("FillBox 128^3 and back, recorded", 10, [&]() {
+        world.BeginEdit();
+        world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_STONE));
+        world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_NONE, 0));
+        world.EndEdit();
+    });
+    world.Journal().Clear();
+
+    bench::run("SetBlock 128^3 and back", 2, [&]() {
+        for(int z = 0; z < BENCH_SIZE; z++)
+            for(int y = 0; y < BENCH_SIZE; y++)
+                for(int x = 0; x < BENCH_SIZE; x++)
+                    world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+        for(int z = 0; z < BENCH_SIZE; z++)
+            for(int y = 0; y < BENCH_SIZE; y++)
+                for(int x = 0; x < BENCH_SIZE; x++)
+                    world.DeleteBlock(x, y, z);
+    });
+    bench::run("SetBlock 128^3 and back, recorded", 2, [&]() {
+        world.BeginEdit();
+        for(int z = 0; z < BENCH_SIZE; z++)
+            for(int y = 0; y < BENCH_SIZE; y++)
+                for(int x = 0; x < BENCH_SIZE; x++)
+                    world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+        world.EndEdit();
+        size_t bytes = world.Journal().Stats().memory_bytes;
+        world.BeginEdit();
+        for(int z = 0; z < BENCH_SIZE; z++)
+            for(int y = 0; y < BENCH_SIZE; y++)
+                for(int x = 0; x < BENCH_SIZE; x++)
+                    world.DeleteBlock(x, y, z);
+        world.EndEdit();
+        bench::keep(bytes);
+    });
+    std::cout << "  " << world.Journal().Stats().memory_bytes / (2 * blocks)
+              << " bytes per changed block, " << 2 * sizeof(_block_t) + sizeof(unsigned)
+              << " with the position and both blocks kept plainly" << std::endl;
+    world.Journal().Clear();
+
+    // undoing and redoing takes time with the size of the edit
+    for(int size = 1; size <= BENCH_SIZE; size *= 8)
+    {
+        world.BeginEdit();
+        for(int z = 0; z < size; z++)
+            for(int x = 0; x < size; x++)
+                world.InsertBlock(x, 0, z, BLOCK_TYPE_STONE);
+        world.EndEdit();
+        bench::run("undo and redo " + std::to_string(size * size) + " blocks", 10, [&]() {
+            world.Undo();
+            world.Redo();
+        });
+        world.Undo();
+    }
+    world.BeginEdit();
+    world.FillBox(0, 0, 0, last, last, last, _block_t(BLOCK_TYPE_STONE));
+    world.EndEdit();
+    bench::run("undo and redo a 128^3 fill", 10, [&]() {
+        world.Undo();
+        world.Redo();
+    });
+    std::cout << "  " << world.Journal().Stats().memory_bytes << " bytes of history" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_journal();
+    bench_journal();
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
@@ -0,0 +1,195 @@
+
+// CUSTOM
+#include "../engine/block_layout.hpp"
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <vector>
+
+using namespace block_layout;
+
+// Neighbour heavy work on the sections of a generated world, with their
+// blocks stored in each of the layouts of block_layout.hpp. GameWorld
+// itself uses the one picked with BLOCK_LAYOUT at compile time.
+//
+// Build with -march=native (or -mbmi2) for Morton indices through `pdep':
+//   make bench/layout_bench BENCHFLAGS="-std=c++11 -O2 -march=native"
+
+#define WORLD_WIDTH 128
+#define WORLD_HEIGHT 64
+#define WORLD_SEED 1337
+
+static const int offsets[6][3] = {
+    { -1, 0, 0 }, { 1, 0, 0 },
+    { 0, -1, 0 }, { 0, 1, 0 },
+    { 0, 0, -1 }, { 0, 0, 1 }
+};
+
+// the blocks of every section of `world', one section after the other
+template<_layout_t layout>
+std::vector<_block_t> copy_sections(GameWorld& world)
+{
+    std::vector<_block_t> blocks((size_t)world.SectionCount() * SECTION_BLOCKS);
+    for(int s = 0; s < world.SectionCount(); s++)
+    {
+        int x0, y0, z0, x1, y1, z1;
+        world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+        for(int z = z0; z <= z1; z++)
+            for(int y = y0; y <= y1; y++)
+                for(int x = x0; x <= x1; x++)
+                    blocks[(size_t)s * SECTION_BLOCKS + Index<layout>(x, y, z)] = world.BlockAt(x, y, z);
+    }
+    return blocks;
+}
+
+// faces of solid blocks next to a non-solid block of the same section,
+// checked one neighbour at a time
+template<_layout_t layout>
+size_t count_faces(const std::vector<_block_t>& blocks)
+{
+    size_t faces = 0;
+    for(size_t s = 0; s < blocks.size() / SECTION_BLOCKS; s++)
+    {
+        const _block_t* section = &blocks[s * SECTION_BLOCKS];
+        for(int z = 0; z < SECTION_SIZE; z++)
+            for(int y = 0; y < SECTION_SIZE; y++)
+                for(int x = 0; x < SECTION_SIZE; x++)
+                {
+                    if(!is_solid(section[Index<layout>(x, y, z)].type)) {
+                        continue;
+                    }
+                    for(int i = 0; i < 6; i++)
+                    {
+                        int nx = x + offsets[i][0], ny = y + offsets[i][1], nz = z + offsets[i][2];
+                        bool inside = nx >= 0 && nx < SECTION_SIZE && ny >= 0 && ny < SECTION_SIZE &&
+                                      nz >= 0 && nz < SECTION_SIZE;
+                        faces += !inside || !is_solid(section[Index<layout>(nx, ny, nz)].type);
+                    }
+                }
+    }
+    return faces;
+}
+
+// open areas of every section, flood filled like
+// `GameWorld::UpdateConnectivity'. Returns the number of areas
+template<_layout_t layout>
+size_t flood_fill(const std::vector<_block_t>& blocks, std::vector<bool>& visited,
+                  std::vector<int>& stack)
+{
+    size_t areas = 0;
+    for(size_t s = 0; s < blocks.size() / SECTION_BLOCKS; s++)
+    {
+        const _block_t* section = &blocks[s * SECTION_BLOCKS];
+        visited.assign(SECTION_BLOCKS, false);
+        for(int start = 0; start < SECTION_BLOCKS; start++)
+        {
+            int sx = start % SECTION_SIZE, sy = (start / SECTION_SIZE) % SECTION_SIZE,
+                sz = start / (SECTION_SIZE * SECTION_SIZE);
+            unsigned index = Index<layout>(sx, sy, sz);
+            if(visited[index] || is_solid(section[index].type)) {
+                continue;
+            }
+            areas++;
+            visited[index] = true;
+            stack.push_back(start);
+            while(!stack.empty())
+            {
+                int cell = stack.back();
+                stack.pop_back();
+                int x = cell % SECTION_SIZE, y = (cell / SECTION_SIZE) % SECTION_SIZE,
+                    z = cell / (SECTION_SIZE * SECTION_SIZE);
+                for(int i = 0; i < 6; i++)
+                {
+                    int nx = x + offsets[i][0], ny = y + offsets[i][1], nz = z + offsets[i][2];
+                    if(nx < 0 || nx >= SECTION_SIZE || ny < 0 || ny >= SECTION_SIZE ||
+                       nz < 0 || nz >= SECTION_SIZE) {
+                        continue;
+                    }
+                    unsigned n = Index<layout>(nx, ny, nz);
+                    if(!visited[n] && !is_solid(section[n].type))
+                    {
+                        visited[n] = true;
+                        stack.push_back((nz * SECTION_SIZE + ny) * SECTION_SIZE + nx);
+                    }
+                }
+            }
+        }
+    }
+    return areas;
+}
+
+// every layout numbers the blocks of a cube 0 to SECTION_BLOCKS - 1 once
+template<_layout_t layout>
+bool check_layout()
+{
+    std::vector<bool> seen(SECTION_BLOCKS, false);
+    bool ok = true;
+    for(int z = 0; z < SECTION_SIZE; z++)
+        for(int y = 0; y < SECTION_SIZE; y++)
+            for(int x = 0; x < SECTION_SIZE; x++)
+            {
+                unsigned index = Index<layout>(x, y, z);
+                ok = ok && index < SECTION_BLOCKS && !seen[index];
+                ok = ok && index < SECTION_BLOCKS && (seen[index] = true);
+                // world coordinates wrap around
+                ok = ok && Index<layout>(x + 3 * SECTION_SIZE, y + SECTION_SIZE, z) == index;
+            }
+    return ok;
+}
+
+template<_layout_t layout>
+void bench_layout(GameWorld& world, size_t& faces, size_t& areas)
+{
+    std::vector<_block_t> blocks = copy_sections<layout>(world);
+    std::vector<bool> visited;
+    std::vector<int> stack;
+    std::string name = Name(layout);
+
+    faces = count_faces<layout>(blocks);
+    areas = flood_fill<layout>(blocks, visited, stack);
+    bench::run("face culling, " + name, 20, [&]() {
+        bench::keep(count_faces<layout>(blocks));
+    });
+    bench::run("flood fill, " + name, 20, [&]() {
+        bench::keep(flood_fill<layout>(blocks, visited, stack));
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_layout<LAYOUT_XYZ>() && check_layout<LAYOUT_XZY>() &&
+              check_layout<LAYOUT_YZX>() && check_layout<LAYOUT_MORTON>();
+    ok = ok && Index<LAYOUT_MORTON>(1, 0, 0) == 1 && Index<LAYOUT_MORTON>(0, 1, 0) == 2 &&
+         Index<LAYOUT_MORTON>(0, 0, 1) == 4 && Index<LAYOUT_MORTON>(2, 0, 0) == 8 &&
+         Index<LAYOUT_MORTON>(15, 15, 15) == SECTION_BLOCKS - 1;
+
+    GameWorld world(WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH);
+    world_generator::generate_terrain(&world, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, WORLD_SEED);
+    std::cout << "GameWorld layout: " << Name(BLOCK_LAYOUT) << ", Morton indices through "
+    #ifdef __BMI2__
+              << "pdep" << std::endl;
+    #else
+              << "a table" << std::endl;
+    #endif
+
+    // the same answers in every layout
+    size_t faces[LAYOUT_COUNT], areas[LAYOUT_COUNT];
+    bench_layout<LAYOUT_XYZ>(world, faces[0], areas[0]);
+    bench_layout<LAYOUT_XZY>(world, faces[1], areas[1]);
+    bench_layout<LAYOUT_YZX>(world, faces[2], areas[2]);
+    bench_layout<LAYOUT_MORTON>(world, faces[3], areas[3]);
+    for(int l = 1; l < LAYOUT_COUNT; l++) {
+        ok = ok && faces[l] == faces[0] && areas[l] == areas[0];
+    }
+    ok = ok && faces[0] > 0 && areas[0] > 0;
+
+    std::cout << "layout check " << (ok ? "passed" : "FAILED") << ", " << faces[0]
+              << " faces, " << areas[0] << " open areas" << std::endl;
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
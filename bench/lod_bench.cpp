@@ -0,0 +1,141 @@
+
+// CUSTOM
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cmath>
+
+#define LOD_DISTANCE 64
+
+// majority merging, filled cubes along section borders and hidden faces
+bool check_merge()
+{
+    GameWorld world(2 * SECTION_SIZE, SECTION_SIZE, SECTION_SIZE);
+
+    // a 2x2x2 cube inside the section with 5 stone, 2 sand and 1 empty
+    int n = 0;
+    for(int z = 4; z < 6; z++)
+        for(int y = 4; y < 6; y++)
+            for(int x = 4; x < 6; x++, n++)
+                if(n < 7)
+                    world.InsertBlock(x, y, z, n < 5 ? BLOCK_TYPE_STONE : BLOCK_TYPE_SAND);
+
+    // and one with a single block, which is dropped
+    world.InsertBlock(8, 8, 8, BLOCK_TYPE_STONE);
+
+    // a single block on the border is kept
+    world.InsertBlock(SECTION_SIZE - 1, 8, 8, BLOCK_TYPE_SAND);
+
+    const std::vector<_lod_cell_t>& cells = world.SectionLod(0, 1);
+    bool ok = cells.size() == 2;
+    ok = ok && cells[0].x == 4 && cells[0].y == 4 && cells[0].z == 4 && cells[0].type == BLOCK_TYPE_STONE;
+    ok = ok && cells[1].x == SECTION_SIZE - 2 && cells[1].type == BLOCK_TYPE_SAND;
+
+    // editing throws the merged blocks away
+    world.DeleteBlock(SECTION_SIZE - 1, 8, 8);
+    ok = ok && world.SectionLod(0, 1).size() == 1;
+
+    // at the coarsest level every cube touches the border, the two
+    // remaining cubes of blocks fill their own
+    ok = ok && world.SectionLod(0, LOD_LEVELS).size() == 2;
+
+    // cubes hide each other's faces, those inside a solid section all of
+    // them, and the border always shows
+    GameWorld solid(SECTION_SIZE, SECTION_SIZE, SECTION_SIZE);
+    solid.FillBox(0, 0, 0, SECTION_SIZE - 1, SECTION_SIZE - 1, SECTION_SIZE - 1,
+                  _block_t(BLOCK_TYPE_STONE));
+    const std::vector<_lod_cell_t>& shell = solid.SectionLod(0, 1);
+    int side = SECTION_SIZE / 2;
+    ok = ok && (int)shell.size() == side * side * side - (side - 2) * (side - 2) * (side - 2);
+    ok = ok && shell[0].faces == (1 << FACE_NEG_X | 1 << FACE_NEG_Y | 1 << FACE_NEG_Z);
+    world.FillBox(6, 4, 4, 7, 5, 5, _block_t(BLOCK_TYPE_STONE));
+    ok = ok && world.SectionLod(0, 1).size() == 2 &&
+         world.SectionLod(0, 1)[0].faces == (ALL_FACES & ~(1 << FACE_POS_X));
+
+    std::cout << "merge check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+// blocks and merged blocks within `view' blocks of a camera in the middle of
+// the world, i.e. what `DrawBlocks' would draw without culling
+void count_view(GameWorld& world, const glm::vec3& eye, int view, int lod_distance,
+                size_t& blocks, size_t& cells)
+{
+    std::vector<unsigned char> levels;
+    world.SetLodDistance(lod_distance);
+    world.SelectLods(eye, 1.0f, levels);
+
+    blocks = cells = 0;
+    for(int s = 0; s < world.SectionCount(); s++)
+    {
+        int x0, y0, z0, x1, y1, z1;
+        world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+        glm::vec3 min = glm::vec3(x0, y0, z0) - 0.5f;
+        glm::vec3 max = glm::vec3(x1, y1, z1) + 0.5f;
+        if(glm::length(glm::clamp(eye, min, max) - eye) > view) {
+            continue;
+        }
+        if(levels[s] > 0) {
+            cells += world.SectionLod(s, levels[s]).size();
+        }
+        else {
+            blocks += world.Section(s).blocks;
+        }
+    }
+}
+
+void bench_view_distances(int size, int height)
+{
+    GameWorld world(size, height, size);
+    world_generator::generate_terrain(&world, size, height, size, 1337);
+    glm::vec3 eye(size / 2.0f, height * 0.75f, size / 2.0f);
+
+    static const int views[] = { 64, 128, 256, 512 };
+    for(int v = 0; v < 4; v++)
+    {
+        size_t full, blocks, cells;
+        count_view(world, eye, views[v], 0, full, cells);
+        count_view(world, eye, views[v], LOD_DISTANCE, blocks, cells);
+        std::cout << "  view " << views[v] << " blocks: " << full * TRIANGLES_PER_BLOCK
+                  << " triangles, with LOD " << (blocks + cells) * TRIANGLES_PER_BLOCK
+                  << std::endl;
+    }
+
+    std::vector<unsigned char> levels;
+    std::string n = std::to_string(size) + "x" + std::to_string(height) + "x" + std::to_string(size);
+    world.SetLodDistance(LOD_DISTANCE);
+    bench::run("SelectLods, " + n, 200, [&]() {
+        world.SelectLods(eye, 1.0f, levels);
+        bench::keep(levels[0]);
+    });
+
+    bench::run("build every LOD level, " + n, 5, [&]() {
+        for(int s = 0; s < world.SectionCount(); s++)
+        {
+            // changing a block throws its section's levels away
+            int x0, y0, z0, x1, y1, z1;
+            world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+            _block_type_t type = world.GetBlockType(x1, y1, z1);
+            world.SetBlock(x1, y1, z1, _block_t(type == BLOCK_TYPE_STONE ? BLOCK_TYPE_EARTH : BLOCK_TYPE_STONE, 10));
+            world.SetBlock(x1, y1, z1, type == BLOCK_TYPE_NONE ? _block_t() : _block_t(type, 10));
+        }
+        size_t cells = 0;
+        for(int s = 0; s < world.SectionCount(); s++)
+            for(int l = 1; l <= LOD_LEVELS; l++)
+                cells += world.SectionLod(s, l).size();
+        bench::keep(cells);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_merge();
+    bench_view_distances(512, 64);
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
@@ -0,0 +1,316 @@
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// GLFW
+#include <GLFW/glfw3.h>
+
+// CUSTOM
+#include "../engine/window.hpp"
+#include "../engine/mesh_buffer.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+using mesh_buffer::RangeAllocator;
+using mesh_buffer::_mesh_t;
+
+// share of the page the churn keeps in use
+#define CHURN_FULL 0.75
+
+// stream buffer of the defragment check
+#define STREAM_BUFFER_SIZE (4 << 20)
+
+// best fit, merging of free neighbours and the statistics
+bool check_allocator()
+{
+    RangeAllocator ranges(100);
+    size_t a = 0, b = 0, c = 0, d = 0;
+    bool ok = ranges.Allocate(10, a) && ranges.Allocate(20, b) &&
+              ranges.Allocate(30, c) && ranges.Allocate(40, d);
+    ok = ok && a == 0 && b == 10 && c == 30 && d == 60;
+    ok = ok && ranges.Used() == 100 && ranges.Free() == 0 && !ranges.Allocate(1, a);
+
+    // two holes, of 20 and 40: 15 goes into the smaller one
+    ranges.Free(b, 20);
+    ranges.Free(d, 40);
+    ok = ok && ranges.FreeRanges() == 2 && ranges.LargestFree() == 40;
+    ok = ok && ranges.Fragmentation() > 0.3 && ranges.Fragmentation() < 0.34;
+    size_t e = 0;
+    ok = ok && ranges.Allocate(15, e) && e == 10;
+
+    // freeing the rest merges everything back into one range
+    ranges.Free(e, 15);
+    ranges.Free(a, 10);
+    ranges.Free(c, 30);
+    ok = ok && ranges.FreeRanges() == 1 && ranges.LargestFree() == 100;
+    ok = ok && ranges.Used() == 0 && ranges.Fragmentation() == 0.0;
+
+    // too large, or nothing at all
+    ok = ok && !ranges.Allocate(101, a) && !ranges.Allocate(0, a);
+
+    std::cout << "allocator check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+// a page fragmented past MESH_BUFFER_FRAGMENTATION: every other mesh freed
+// once it is full. Returns the handles left
+std::vector<int> fragment_page(RangeAllocator& ranges, std::vector<_mesh_t>& meshes, size_t size)
+{
+    std::vector<int> live;
+    for(size_t first; ranges.Allocate(size, first);)
+    {
+        _mesh_t mesh = { 0, first, size };
+        meshes.push_back(mesh);
+    }
+    for(size_t m = 0; m < meshes.size(); m++)
+    {
+        if(m % 2 == 0)
+        {
+            ranges.Free(meshes[m].first, meshes[m].count);
+            meshes[m].page = -1;
+        }
+        else {
+            live.push_back((int)m);
+        }
+    }
+    return live;
+}
+
+// the plan of `MeshBuffer::Compact', carried out on vertices kept here:
+// every mesh moves to its new place with its vertices, and the free space
+// ends up in one range
+bool check_pack()
+{
+    const size_t capacity = 1 << 12, size = 100;
+    RangeAllocator ranges(capacity);
+    std::vector<_mesh_t> meshes;
+    std::vector<int> live = fragment_page(ranges, meshes, size);
+    bool ok = mesh_buffer::NeedsCompaction(ranges) && ranges.Free() >= capacity / 8;
+
+    // every vertex holds its mesh
+    std::vector<int> vertices(capacity, -1);
+    for(size_t i = 0; i < live.size(); i++) {
+        std::fill(vertices.begin() + meshes[live[i]].first,
+                  vertices.begin() + meshes[live[i]].first + size, live[i]);
+    }
+
+    std::vector<mesh_buffer::_mesh_move_t> moves;
+    size_t head = mesh_buffer::PackPage(ranges, meshes, 0, moves);
+    std::vector<int> packed(capacity, -1);
+    for(size_t i = 0; i < moves.size(); i++) {
+        std::copy(vertices.begin() + moves[i].from, vertices.begin() + moves[i].from + moves[i].count,
+                  packed.begin() + moves[i].to);
+    }
+
+    ok = ok && head == live.size() * size && moves.size() == live.size();
+    for(size_t i = 0; i < live.size(); i++)
+    {
+        const _mesh_t& mesh = meshes[live[i]];
+        ok = ok && mesh.first == i * size &&
+             std::count(packed.begin() + mesh.first, packed.begin() + mesh.first + size,
+                        live[i]) == (int)size;
+    }
+    ok = ok && ranges.FreeRanges() == 1 && ranges.LargestFree() == capacity - head &&
+         !mesh_buffer::NeedsCompaction(ranges);
+
+    std::cout << "pack check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+// vertices of mesh `handle', all made of it
+std::vector<GLfloat> mesh_vertices(int handle, size_t count)
+{
+    return std::vector<GLfloat>(4 * count, (GLfloat)handle);
+}
+
+// `MeshBuffer::Defragment' itself, on a page fragmented the same way, and a
+// page of its own for a mesh too large for one, emptied: meshes keep their
+// vertices where their handles now point, the free space of the page is in
+// one range and the empty page is deleted. Then a second page drained into
+// the first. Needs a window, from the repository root; skipped without a
+// display
+bool check_defragment()
+{
+    window::WindowedWindow* win = window::create_window("mesh buffer check", 200,
+                                                        window::ASPECT_RATIO_4_3, false);
+    if(win == NULL)
+    {
+        std::cout << "defragment check skipped, no window" << std::endl;
+        return true;
+    }
+    bool ok = true;
+    {
+        stream_buffer::StreamBuffer stream(STREAM_BUFFER_SIZE, GL_ARRAY_BUFFER, true);
+        mesh_buffer::MeshBuffer meshes(&stream);
+        const size_t size = MESH_BUFFER_PAGE_VERTICES / 64;
+        std::vector<int> handles, live;
+        for(int m = 0; m < 64; m++)
+        {
+            int handle = meshes.Allocate(size);
+            std::vector<GLfloat> vertices = mesh_vertices(handle, size);
+            std::copy(vertices.begin(), vertices.end(), meshes.Map(handle));
+            meshes.Unmap(handle);
+            handles.push_back(handle);
+            stream.EndFrame();
+        }
+        for(size_t m = 0; m < handles.size(); m++)
+        {
+            if(m % 2 == 0) {
+                meshes.Free(handles[m]);
+            }
+            else {
+                live.push_back(handles[m]);
+            }
+        }
+        ok = meshes.Stats().fragmentation > MESH_BUFFER_FRAGMENTATION;
+        int large = meshes.Allocate(MESH_BUFFER_PAGE_VERTICES + 1);
+        meshes.Free(large);
+        ok = ok && meshes.Pages() == 2;
+
+        ok = ok && meshes.Defragment() == 1 && meshes.Pages() == 1;
+        mesh_buffer::_mesh_buffer_stats_t stats = meshes.Stats();
+        ok = ok && stats.free_ranges == 1 && stats.pages_deleted == 1 &&
+             stats.moved == live.size() * size;
+
+        glBindBuffer(GL_COPY_READ_BUFFER, meshes.PageBuffer(0));
+        for(size_t i = 0; i < live.size(); i++)
+        {
+            const _mesh_t& mesh = meshes.Mesh(live[i]);
+            std::vector<GLfloat> vertices(4 * mesh.count);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, mesh.first * 4 * sizeof(GLfloat),
+                               vertices.size() * sizeof(GLfloat), &vertices[0]);
+            ok = ok && mesh.page == 0 && mesh.first == i * size &&
+                 vertices == mesh_vertices(live[i], size);
+        }
+    }
+    // a second page, half freed, drained into the room left on the first
+    {
+        stream_buffer::StreamBuffer stream(STREAM_BUFFER_SIZE, GL_ARRAY_BUFFER, true);
+        mesh_buffer::MeshBuffer meshes(&stream);
+        const size_t size = MESH_BUFFER_PAGE_VERTICES / 64;
+        std::vector<int> handles;
+        for(int m = 0; m < 128; m++)
+        {
+            int handle = meshes.Allocate(size);
+            std::vector<GLfloat> vertices = mesh_vertices(handle, size);
+            std::copy(vertices.begin(), vertices.end(), meshes.Map(handle));
+            meshes.Unmap(handle);
+            handles.push_back(handle);
+            stream.EndFrame();
+        }
+        std::vector<int> live;
+        for(int m = 0; m < 128; m++)
+        {
+            // the first 40 of page 0 and every other of page 1
+            if(m < 40 || (m >= 64 && m % 2 == 0)) {
+                meshes.Free(handles[m]);
+            }
+            else {
+                live.push_back(handles[m]);
+            }
+        }
+        ok = ok && meshes.Pages() == 2 && meshes.Defragment() == 1 && meshes.Pages() == 1;
+        glBindBuffer(GL_COPY_READ_BUFFER, meshes.PageBuffer(0));
+        for(size_t i = 0; i < live.size(); i++)
+        {
+            const _mesh_t& mesh = meshes.Mesh(live[i]);
+            std::vector<GLfloat> vertices(4 * mesh.count);
+            glGetBufferSubData(GL_COPY_READ_BUFFER, mesh.first * 4 * sizeof(GLfloat),
+                               vertices.size() * sizeof(GLfloat), &vertices[0]);
+            ok = ok && mesh.page == 0 && vertices == mesh_vertices(live[i], size);
+        }
+    }
+    std::cout << "defragment check " << (ok ? "passed" : "FAILED") << ", "
+              << (const char*)glGetString(GL_RENDERER) << std::endl;
+    delete win;
+    glfwTerminate();
+    return ok;
+}
+
+// section meshes coming and going in random sizes, as when flying over a
+// world: how scattered does the free space get, and how much does
+// compacting it the way `MeshBuffer::Defragment' does move
+void bench_churn()
+{
+    const size_t capacity = MESH_BUFFER_PAGE_VERTICES;
+    RangeAllocator ranges(capacity);
+    std::vector<_mesh_t> meshes;
+    std::vector<int> live;
+    std::vector<mesh_buffer::_mesh_move_t> moves;
+    srand(1);
+
+    size_t failed = 0, compactions = 0, moved = 0;
+    double worst = 0.0;
+    const int steps = 200000;
+    for(int i = 0; i < steps; i++)
+    {
+        // keep the page about CHURN_FULL full
+        bool grow = ranges.Used() < capacity * CHURN_FULL;
+        if((grow || rand() % 2 == 0) && !(live.empty() && !grow))
+        {
+            // mostly small meshes, now and then a large one
+            _mesh_t mesh = { 0, 0, (size_t)(16 + rand() % (rand() % 8 == 0 ? 16384 : 1024)) };
+            if(ranges.Allocate(mesh.count, mesh.first))
+            {
+                live.push_back((int)meshes.size());
+                meshes.push_back(mesh);
+            }
+            else {
+                failed++;
+            }
+        }
+        if(!live.empty() && (!grow || rand() % 2 == 0))
+        {
+            size_t victim = rand() % live.size();
+            _mesh_t& mesh = meshes[live[victim]];
+            ranges.Free(mesh.first, mesh.count);
+            mesh.page = -1;
+            live[victim] = live.back();
+            live.pop_back();
+        }
+
+        worst = std::max(worst, ranges.Fragmentation());
+        if(mesh_buffer::NeedsCompaction(ranges))
+        {
+            moved += mesh_buffer::PackPage(ranges, meshes, 0, moves);
+            compactions++;
+        }
+    }
+
+    std::cout << "  churn: " << live.size() << " meshes, " << ranges.FreeRanges()
+              << " free ranges, fragmentation " << ranges.Fragmentation()
+              << " (worst " << worst << "), " << failed << " failed allocations, "
+              << compactions << " compactions moving " << moved << " vertices" << std::endl;
+
+    // allocating and freeing against that scattered free space
+    bench::run("RangeAllocator allocate+free x1000", 200, [&]() {
+        for(int i = 0; i < 1000; i++)
+        {
+            size_t offset;
+            size_t size = 16 + (i * 7919) % 4096;
+            if(ranges.Allocate(size, offset)) {
+                ranges.Free(offset, size);
+            }
+        }
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_allocator();
+    ok = check_pack() && ok;
+    ok = check_defragment() && ok;
+    bench_churn();
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
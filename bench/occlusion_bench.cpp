@@ -0,0 +1,184 @@
+
+// CUSTOM
+#include "../world_culling.hpp"
+#include "../world_generator.hpp"
+#include "../engine/camera.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cmath>
+
+#define BLOCK_SIZE 1.0f
+
+glm::mat4 view_projection(camera::BasicFPSCamera& cam)
+{
+    cam.CalculatePosition();
+    return *cam.ProjectionMatrix() * *cam.ViewMatrix();
+}
+
+// a wall section between the camera and a section behind it
+bool check_wall()
+{
+    GameWorld world(3 * SECTION_SIZE, SECTION_SIZE, SECTION_SIZE);
+    for(int z = 0; z < SECTION_SIZE; z++)
+        for(int y = 0; y < SECTION_SIZE; y++)
+            world.InsertBlock(2 * SECTION_SIZE + 4, y / 4, z, BLOCK_TYPE_STONE);
+
+    // one unit per block, so all of it lies within the far plane
+    const float size = 1.0f;
+    glm::vec3 eye(-2.0f, 8.0f, 8.0f);
+
+    camera::BasicFPSCamera cam(NULL, 800.0f, 600.0f);
+    cam.SetInitialPosition(eye.x, eye.y, eye.z);
+    cam.LookAt(40.0f, 8.0f, 8.0f);
+
+    WorldCulling culling;
+    bool ok = true;
+
+    // nothing in between yet
+    const std::vector<bool>* visible = &culling.Cull(world, view_projection(cam), eye, size);
+    ok = ok && (*visible)[2];
+
+    // a solid section in the middle hides the one behind it
+    for(int z = 0; z < SECTION_SIZE; z++)
+        for(int y = 0; y < SECTION_SIZE; y++)
+            for(int x = SECTION_SIZE; x < 2 * SECTION_SIZE; x++)
+                world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+    visible = &culling.Cull(world, view_projection(cam), eye, size);
+    ok = ok && (*visible)[1] && !(*visible)[2] && culling.Stats().occluded == 1;
+
+    // tearing the wall down to its bottom layer uncovers it again
+    for(int z = 0; z < SECTION_SIZE; z++)
+        for(int y = 1; y < SECTION_SIZE; y++)
+            for(int x = SECTION_SIZE; x < 2 * SECTION_SIZE; x++)
+                world.DeleteBlock(x, y, z);
+    visible = &culling.Cull(world, view_projection(cam), eye, size);
+    ok = ok && (*visible)[2] && world.Section(1).solid_layers == 1;
+
+    std::cout << "wall check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+// solid rock with a tunnel along x that turns towards +z, and a sealed
+// air pocket above it
+bool check_caves()
+{
+    const int size = 4 * SECTION_SIZE;
+    GameWorld world(size, 2 * SECTION_SIZE, size);
+    for(int z = 0; z < size; z++)
+        for(int y = 0; y < 2 * SECTION_SIZE; y++)
+            for(int x = 0; x < size; x++)
+                world.InsertBlock(x, y, z, BLOCK_TYPE_STONE);
+
+    // tunnel at y 7-9, z 7-9, from x 0 to 41, then along z to the end
+    for(int y = 7; y <= 9; y++)
+    {
+        for(int i = 7; i <= 9; i++)
+        {
+            for(int x = 0; x <= 41; x++)
+                world.DeleteBlock(x, y, i);
+            for(int z = 7; z < size; z++)
+                world.DeleteBlock(32 + i, y, z);
+        }
+    }
+    for(int y = 20; y < 24; y++)
+        for(int z = 4; z < 8; z++)
+            for(int x = 20; x < 24; x++)
+                world.DeleteBlock(x, y, z);
+
+    int nx = world.SectionsX(), ny = world.SectionsY();
+    #define SECTION(sx, sy, sz) (((sz) * ny + (sy)) * nx + (sx))
+
+    bool ok = true;
+
+    // a straight piece of tunnel only connects its two ends
+    const _section_t& straight = world.Section(SECTION(1, 0, 0));
+    ok = ok && straight.connected[FACE_NEG_X] == ((1 << FACE_NEG_X) | (1 << FACE_POS_X));
+    ok = ok && straight.connected[FACE_POS_Y] == 0;
+
+    // and the bend connects -x with +z
+    const _section_t& bend = world.Section(SECTION(2, 0, 0));
+    ok = ok && (bend.connected[FACE_NEG_X] & (1 << FACE_POS_Z)) != 0;
+
+    // standing in the tunnel, looking down it
+    glm::vec3 eye(2.0f, 8.0f, 8.0f);
+    camera::BasicFPSCamera cam(NULL, 800.0f, 600.0f);
+    cam.SetInitialPosition(eye.x, eye.y, eye.z);
+    cam.LookAt(40.0f, 8.0f, 8.0f);
+
+    WorldCulling culling;
+    const std::vector<bool>& visible = culling.Cull(world, view_projection(cam), eye, 1.0f);
+    ok = ok && visible[SECTION(1, 0, 0)] && visible[SECTION(2, 0, 0)];
+    ok = ok && visible[SECTION(2, 0, 1)];     // round the bend
+    ok = ok && !visible[SECTION(1, 1, 0)];    // the pocket above
+    ok = ok && !visible[SECTION(1, 0, 1)];    // rock beside the tunnel
+
+    std::cout << "cave check " << (ok ? "passed" : "FAILED") << ", "
+              << culling.Stats().cave_culled << " of " << culling.Stats().sections
+              << " sections culled by the walk" << std::endl;
+
+    // without the walk, only the frustum and the occluders are left
+    culling.SetCaveCulling(false);
+    culling.Cull(world, view_projection(cam), eye, 1.0f);
+    std::cout << "  without it " << culling.Stats().frustum_culled + culling.Stats().occluded
+              << " of " << culling.Stats().sections << " culled" << std::endl;
+
+    #undef SECTION
+    return ok;
+}
+
+// a scripted flight over generated terrain, as in `main --benchmark'
+void bench_flight(int size, int height)
+{
+    GameWorld world(size, height, size);
+    world_generator::generate_terrain(&world, size, height, size, 1337);
+
+    camera::BasicFPSCamera cam(NULL, 800.0f, 600.0f);
+    WorldCulling culling;
+
+    const int frames = 300;
+    double culled = 0.0, caves = 0.0, occluded = 0.0, raster_ms = 0.0, test_ms = 0.0;
+    size_t triangles = 0;
+    int frame = 0;
+    std::string n = std::to_string(size) + "x" + std::to_string(height) + "x" + std::to_string(size);
+    bench::run("cull flight frame, " + n, frames, [&]() {
+        float center = size * BLOCK_SIZE / 2.0f;
+        float radius = size * BLOCK_SIZE * 0.3f;
+        float angle = 2.0f * 3.14159265f * frame / frames;
+        float ahead = angle + 0.4f;
+        glm::vec3 pos(center + radius * std::cos(angle), height * BLOCK_SIZE * 0.4f,
+                      center + radius * std::sin(angle));
+        cam.SetInitialPosition(pos.x, pos.y, pos.z);
+        cam.LookAt(center + radius * std::cos(ahead), height * BLOCK_SIZE * 0.4f,
+                   center + radius * std::sin(ahead));
+
+        culling.Cull(world, view_projection(cam), pos, BLOCK_SIZE);
+        const _culling_stats_t& stats = culling.Stats();
+        culled += stats.CulledPercent();
+        caves += stats.sections ? 100.0 * stats.cave_culled / stats.sections : 0.0;
+        occluded += stats.sections ? 100.0 * stats.occluded / stats.sections : 0.0;
+        raster_ms += stats.raster_ms;
+        test_ms += stats.test_ms;
+        triangles += stats.triangles;
+        frame++;
+    });
+
+    std::cout << "  culled " << culled / frame << "% of sections, "
+              << caves / frame << "% by the walk, "
+              << occluded / frame << "% by occlusion, rasterizer "
+              << raster_ms / frame << " ms, tests " << test_ms / frame << " ms, "
+              << triangles / frame << " occluder triangles per frame" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_wall();
+    ok = check_caves() && ok;
+    bench_flight(64, 32);
+    bench_flight(256, 64);
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
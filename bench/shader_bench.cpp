@@ -0,0 +1,113 @@
+
+// CUSTOM
+#include "../engine/shader_preprocessor.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+using shader_preprocessor::_defines_t;
+
+// scratch files of the checks, in the working directory
+void write_file(const char* path, const char* content)
+{
+    std::ofstream file(path, std::ios::out | std::ios::binary);
+    file << content;
+}
+
+// the expanded source, or "ERROR: <message>"
+std::string preprocess(const char* path, const _defines_t& defines)
+{
+    std::string out, error;
+    if(!shader_preprocessor::Preprocess(path, defines, out, error)) {
+        return "ERROR: " + error;
+    }
+    return out;
+}
+
+// includes, defines after #version, and the errors
+bool check_preprocessor()
+{
+    write_file("shader_bench_main.shd",
+               "// comment\n#version 330 core\n#include \"shader_bench_a.shd\"\nvoid main() {}\n");
+    write_file("shader_bench_a.shd", "  #include \"shader_bench_b.shd\"\nint a;\n");
+    write_file("shader_bench_b.shd", "int b;\n");
+    write_file("shader_bench_cycle.shd", "#include \"shader_bench_cycle.shd\"\n");
+    write_file("shader_bench_missing.shd", "#version 330 core\n#include \"shader_bench_none.shd\"\n");
+    write_file("shader_bench_malformed.shd", "#include shader_bench_b.shd\n");
+    write_file("shader_bench_version.shd", "#version 330 core\n#include \"shader_bench_main.shd\"\n");
+
+    _defines_t none, defines;
+    defines["TEXTURE_ARRAY"] = "";
+    defines["LIGHTS"] = "4";
+
+    // nested includes in place, defines right after #version, sorted
+    bool ok = preprocess("shader_bench_main.shd", none) ==
+              "// comment\n#version 330 core\nint b;\nint a;\nvoid main() {}\n";
+    ok = ok && preprocess("shader_bench_main.shd", defines) ==
+               "// comment\n#version 330 core\n#define LIGHTS 4\n#define TEXTURE_ARRAY \n"
+               "int b;\nint a;\nvoid main() {}\n";
+    ok = ok && shader_preprocessor::VariantName(defines) == "LIGHTS=4,TEXTURE_ARRAY";
+    ok = ok && shader_preprocessor::VariantName(none) == "";
+
+    // without #version the defines come first
+    ok = ok && preprocess("shader_bench_a.shd", defines) ==
+               "#define LIGHTS 4\n#define TEXTURE_ARRAY \nint b;\nint a;\n";
+
+    // errors name the file and line
+    ok = ok && preprocess("shader_bench_cycle.shd", none).find("cycle") != std::string::npos;
+    ok = ok && preprocess("shader_bench_missing.shd", none).find(
+                   "shader_bench_missing.shd:2: could not read") != std::string::npos;
+    ok = ok && preprocess("shader_bench_malformed.shd", none).find(
+                   "shader_bench_malformed.shd:1: expected") != std::string::npos;
+    ok = ok && preprocess("shader_bench_version.shd", none).find(
+                   "shader_bench_main.shd:2: #version") != std::string::npos;
+    ok = ok && preprocess("shader_bench_none.shd", none).find("ERROR") == 0;
+
+    const char* files[] = { "shader_bench_main.shd", "shader_bench_a.shd", "shader_bench_b.shd",
+                            "shader_bench_cycle.shd", "shader_bench_missing.shd",
+                            "shader_bench_malformed.shd", "shader_bench_version.shd" };
+    for(size_t i = 0; i < sizeof(files) / sizeof(files[0]); i++) {
+        remove(files[i]);
+    }
+
+    // the block shader's variants, from the repository root
+    std::string branching = preprocess("shaders/default_block_shader/fragment.shd", none);
+    std::string specialised = preprocess("shaders/default_block_shader/fragment.shd", defines);
+    bool shaders = branching.find("ERROR") != 0 && specialised.find("ERROR") != 0;
+    ok = ok && (!shaders || (branching.find("#define FACE_TOP") != std::string::npos &&
+                             specialised.find("#define TEXTURE_ARRAY") != std::string::npos));
+    if(!shaders) {
+        std::cout << "  (shaders/ not found, run from the repository root to check them)" << std::endl;
+    }
+
+    std::cout << "preprocessor check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_preprocessor();
+
+    // what preprocessing adds to loading a program
+    _defines_t defines;
+    defines["TEXTURE_ARRAY"] = "";
+    const char* stages[3] = { "shaders/default_block_shader/vertex.shd",
+                              "shaders/default_block_shader/geometry.shd",
+                              "shaders/default_block_shader/fragment.shd" };
+    bench::run("preprocess default_block_shader", 1000, [&]() {
+        for(int i = 0; i < 3; i++)
+        {
+            std::string out, error;
+            shader_preprocessor::Preprocess(stages[i], defines, out, error);
+            bench::keep(out.size());
+        }
+    });
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
@@ -0,0 +1,170 @@
+
+// CUSTOM
+#include "../engine/slab_pool.hpp"
+#include "../game_world.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+using slab_pool::SlabPool;
+
+// partly used slabs first, constant time frees, and trimming
+bool check_pool()
+{
+    SlabPool pool(SECTION_BLOCKS * sizeof(_block_t));
+    const size_t per_slab = pool.Stats().objects_per_slab;
+    bool ok = per_slab > 1 && pool.Stats().object_size % SLAB_POOL_ALIGNMENT == 0;
+
+    // two slabs worth, all distinct, aligned and inside their slab
+    std::vector<void*> objects;
+    for(size_t i = 0; i < 2 * per_slab; i++) {
+        objects.push_back(pool.Allocate());
+    }
+    std::vector<void*> sorted(objects);
+    std::sort(sorted.begin(), sorted.end());
+    ok = ok && std::unique(sorted.begin(), sorted.end()) == sorted.end() && sorted[0] != NULL;
+    for(size_t i = 0; i < objects.size(); i++) {
+        ok = ok && (uintptr_t)objects[i] % SLAB_POOL_ALIGNMENT == 0;
+    }
+    for(size_t i = 1; i < sorted.size(); i++) {
+        ok = ok && (size_t)((char*)sorted[i] - (char*)sorted[i - 1]) >= pool.Stats().object_size;
+    }
+    ok = ok && pool.Stats().slabs == 2 && pool.Stats().used == 2 * per_slab &&
+         pool.Stats().Occupancy() == 1.0;
+
+    // emptying the first slab, then one object of the second: the next
+    // object comes from the second, so the first stays empty
+    for(size_t i = 0; i < per_slab; i++) {
+        pool.Free(objects[i]);
+    }
+    pool.Free(objects[per_slab]);
+    ok = ok && pool.Stats().empty_slabs == 1 && pool.Stats().used == per_slab - 1;
+    ok = ok && pool.Allocate() == objects[per_slab];
+    ok = ok && pool.Stats().empty_slabs == 1;
+
+    // the empty slab goes back, the used one stays
+    ok = ok && pool.Trim(1) == 0 && pool.Trim() == 1;
+    ok = ok && pool.Stats().slabs == 1 && pool.Stats().released == 1 &&
+         pool.Stats().peak == 2 * per_slab;
+    for(size_t i = per_slab; i < 2 * per_slab; i++) {
+        pool.Free(objects[i]);
+    }
+    ok = ok && pool.Stats().used == 0 && pool.Trim() == 1 && pool.Stats().MappedBytes() == 0;
+
+    // a section of the world has storage only while it holds blocks
+    GameWorld world(2 * SECTION_SIZE, SECTION_SIZE, SECTION_SIZE);
+    ok = ok && world.StorageStats().used == 0 && world.GetBlockType(3, 4, 5) == BLOCK_TYPE_NONE;
+    world.InsertBlock(3, 4, 5, BLOCK_TYPE_STONE);
+    world.InsertBlock(SECTION_SIZE + 3, 4, 5, BLOCK_TYPE_STONE);
+    ok = ok && world.StorageStats().used == 2 && world.GetBlockType(3, 4, 5) == BLOCK_TYPE_STONE;
+    ok = ok && world.GetBlockType(4, 4, 5) == BLOCK_TYPE_NONE;
+    world.DeleteBlock(3, 4, 5);
+    ok = ok && world.StorageStats().used == 1 && world.GetBlockType(3, 4, 5) == BLOCK_TYPE_NONE;
+    ok = ok && world.GetBlockType(SECTION_SIZE + 3, 4, 5) == BLOCK_TYPE_STONE;
+
+    std::cout << "slab pool check " << (ok ? "passed" : "FAILED") << std::endl;
+    return ok;
+}
+
+// sections loaded and unloaded in random order, as when streaming a world
+// around the player: `live' buffers of section blocks, of which `turnover'
+// are replaced per iteration. Every new buffer is filled with air, like
+// `GameWorld::SetBlock' does
+void bench_churn(size_t live, size_t turnover)
+{
+    std::string n = std::to_string(live) + " live, " + std::to_string(turnover) + " replaced";
+    _block_t air;
+
+    std::vector<_block_t*> buffers(live, (_block_t*)NULL);
+    srand(1);
+    bench::run("new _block_t[] churn, " + n, 50, [&]() {
+        for(size_t i = 0; i < turnover; i++)
+        {
+            size_t victim = rand() % live;
+            delete[] buffers[victim];
+            buffers[victim] = new _block_t[SECTION_BLOCKS];
+        }
+        bench::keep(buffers[0]);
+    });
+    for(size_t i = 0; i < live; i++) {
+        delete[] buffers[i];
+    }
+
+    SlabPool pool(SECTION_BLOCKS * sizeof(_block_t), true);
+    std::fill(buffers.begin(), buffers.end(), (_block_t*)NULL);
+    srand(1);
+    bench::run("SlabPool churn, " + n, 50, [&]() {
+        for(size_t i = 0; i < turnover; i++)
+        {
+            size_t victim = rand() % live;
+            pool.Free(buffers[victim]);
+            buffers[victim] = (_block_t*)pool.Allocate();
+            std::uninitialized_fill(buffers[victim], buffers[victim] + SECTION_BLOCKS, air);
+        }
+        bench::keep(buffers[0]);
+    });
+    std::cout << "  pool: " << pool.Stats().slabs << " slabs, "
+              << (int)(pool.Stats().Occupancy() * 100.0) << "% occupied" << std::endl;
+    for(size_t i = 0; i < live; i++) {
+        pool.Free(buffers[i]);
+    }
+    std::cout << "  trimmed " << pool.Trim() << " slabs" << std::endl;
+}
+
+// allocating and freeing alone, without touching the memory
+void bench_alloc_free()
+{
+    const size_t count = 1024;
+    std::vector<_block_t*> buffers(count);
+    bench::run("new+delete _block_t[] x1024", 100, [&]() {
+        for(size_t i = 0; i < count; i++) {
+            buffers[i] = new _block_t[SECTION_BLOCKS];
+        }
+        for(size_t i = 0; i < count; i++) {
+            delete[] buffers[i];
+        }
+    });
+
+    SlabPool pool(SECTION_BLOCKS * sizeof(_block_t), true);
+    bench::run("SlabPool Allocate+Free x1024", 100, [&]() {
+        for(size_t i = 0; i < count; i++) {
+            buffers[i] = (_block_t*)pool.Allocate();
+        }
+        for(size_t i = 0; i < count; i++) {
+            pool.Free(buffers[i]);
+        }
+    });
+}
+
+// sections filled and cleared again through the world, which takes and
+// gives back their storage every time
+void bench_world()
+{
+    const int size = 4 * SECTION_SIZE;
+    GameWorld world(size, SECTION_SIZE, size);
+    bench::run("GameWorld fill+clear 16 sections", 20, [&]() {
+        for(int z = 0; z < size; z++)
+            for(int x = 0; x < size; x++)
+                world.InsertBlock(x, 0, z, BLOCK_TYPE_STONE);
+        for(int z = 0; z < size; z++)
+            for(int x = 0; x < size; x++)
+                world.DeleteBlock(x, 0, z);
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = check_pool();
+    bench_churn(512, 64);
+    bench_churn(4096, 256);
+    bench_alloc_free();
+    bench_world();
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
@@ -0,0 +1,254 @@
+
+// CUSTOM
+#include "../game_world.hpp"
+#include "../world_generator.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Readers on other threads going through snapshots of a world while the
+// main thread keeps changing it, checked for seeing exactly the blocks of
+// the moment each snapshot was taken; and how reading scales with threads.
+
+#define STRESS_WIDTH 64
+#define STRESS_HEIGHT 32
+#define STRESS_ROUNDS 32
+#define STRESS_READERS 4
+#define STRESS_SNAPSHOT_EVERY 4096 // block changes
+
+#define WORLD_WIDTH 128
+#define WORLD_HEIGHT 64
+#define WORLD_SEED 1337
+
+// block of round `round' in the stress test: every third round clears the
+// world, which gives sections their storage back
+_block_t round_block(int round)
+{
+    if(round % 3 == 0) {
+        return _block_t(BLOCK_TYPE_NONE, 0);
+    }
+    return _block_t(BLOCK_TYPE_STONE, round);
+}
+
+// a snapshot taken after the first `written' blocks of round `round' were
+// set, blocks x fastest, then y, then z
+struct Job
+{
+    WorldSnapshot snapshot;
+    int round;
+    int written;
+};
+
+bool matches(const WorldSnapshot& snapshot, int round, int written)
+{
+    _block_t done = round_block(round), before = round_block(round - 1);
+    int i = 0;
+    for(int z = 0; z < STRESS_WIDTH; z++)
+        for(int y = 0; y < STRESS_HEIGHT; y++)
+            for(int x = 0; x < STRESS_WIDTH; x++, i++)
+            {
+                const _block_t& expected = i < written ? done : before;
+                const _block_t& block = snapshot.BlockAt(x, y, z);
+                if(block.type != expected.type ||
+                   (block.type != BLOCK_TYPE_NONE && block.health != expected.health)) {
+                    return false;
+                }
+            }
+    return true;
+}
+
+// one writer, the main thread, and STRESS_READERS readers checking the
+// most recent snapshot over and over, without locks while reading
+bool stress()
+{
+    GameWorld world(STRESS_WIDTH, STRESS_HEIGHT, STRESS_WIDTH);
+    std::mutex latest_mutex;
+    std::shared_ptr<Job> latest(new Job());
+    latest->snapshot = world.Snapshot();
+    latest->round = 0;
+    latest->written = STRESS_WIDTH * STRESS_HEIGHT * STRESS_WIDTH;
+
+    std::atomic<bool> done(false);
+    std::atomic<size_t> checks(0), failures(0);
+    std::vector<std::thread> readers;
+    for(int t = 0; t < STRESS_READERS; t++)
+    {
+        readers.push_back(std::thread([&]() {
+            while(!done.load())
+            {
+                std::shared_ptr<Job> job;
+                {
+                    std::lock_guard<std::mutex> lock(latest_mutex);
+                    job = latest;
+                }
+                if(!matches(job->snapshot, job->round, job->written)) {
+                    failures++;
+                }
+                checks++;
+            }
+        }));
+    }
+
+    size_t snapshots = 0;
+    for(int round = 1; round <= STRESS_ROUNDS; round++)
+    {
+        _block_t block = round_block(round);
+        int written = 0;
+        for(int z = 0; z < STRESS_WIDTH; z++)
+            for(int y = 0; y < STRESS_HEIGHT; y++)
+                for(int x = 0; x < STRESS_WIDTH; x++)
+                {
+                    world.SetBlock(x, y, z, block);
+                    if(++written % STRESS_SNAPSHOT_EVERY == 0)
+                    {
+                        std::shared_ptr<Job> job(new Job());
+                        job->snapshot = world.Snapshot();
+                        job->round = round;
+                        job->written = written;
+                        std::lock_guard<std::mutex> lock(latest_mutex);
+                        latest = job;
+                        snapshots++;
+                    }
+                }
+        world.Tick();
+    }
+    done = true;
+    for(size_t t = 0; t < readers.size(); t++) {
+        readers[t].join();
+    }
+
+    // the writer saw the last snapshot, and the readers checked it
+    bool ok = failures == 0 && checks > 0 && matches(latest->snapshot, STRESS_ROUNDS,
+                                                     STRESS_WIDTH * STRESS_HEIGHT * STRESS_WIDTH);
+    ok = ok && world.RegionStats().copies > 0;
+
+    // nothing left over once the snapshots are gone
+    latest.reset();
+    ok = ok && world.RegionStats().retired == 0 &&
+         world.StorageStats().used == (size_t)world.SectionCount();
+
+    std::cout << "snapshot check " << (ok ? "passed" : "FAILED") << ", " << snapshots
+              << " snapshots, " << checks << " checked by " << STRESS_READERS << " readers, "
+              << failures << " inconsistent, " << world.RegionStats().copies
+              << " regions copied" << std::endl;
+    return ok;
+}
+
+// blocks that are not air, read through a snapshot
+size_t count_blocks(const WorldSnapshot& snapshot, int width, int height, int depth)
+{
+    size_t count = 0;
+    for(int z = 0; z < depth; z++)
+        for(int y = 0; y < height; y++)
+            for(int x = 0; x < width; x++)
+                count += snapshot.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+    return count;
+}
+
+// every thread reads the whole world from the same snapshot
+void bench_readers(GameWorld& world)
+{
+    WorldSnapshot snapshot = world.Snapshot();
+    double blocks = (double)WORLD_WIDTH * WORLD_HEIGHT * WORLD_WIDTH;
+
+    bench::run("GameWorld read, 1 thread", 10, [&]() {
+        size_t count = 0;
+        for(int z = 0; z < WORLD_WIDTH; z++)
+            for(int y = 0; y < WORLD_HEIGHT; y++)
+                for(int x = 0; x < WORLD_WIDTH; x++)
+                    count += world.GetBlockType(x, y, z) != BLOCK_TYPE_NONE;
+        bench::keep(count);
+    });
+
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    for(int threads = 1; threads <= 8; threads *= 2)
+    {
+        std::vector<size_t> counts(threads);
+        double ms = bench::run("snapshot read, " + std::to_string(threads) + " threads", 10, [&]() {
+            std::vector<std::thread> readers;
+            for(int t = 0; t < threads; t++)
+            {
+                readers.push_back(std::thread([&, t]() {
+                    counts[t] = count_blocks(snapshot, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH);
+                }));
+            }
+            for(int t = 0; t < threads; t++) {
+                readers[t].join();
+            }
+            bench::keep(counts[0]);
+        });
+        std::cout << "  " << (int)(threads * blocks / ms / 1000.0) << " Mblocks/s on "
+                  << cores << " cores" << std::endl;
+    }
+}
+
+// damage that changes nothing, none at all or to an empty position, must
+// not copy a region even while a snapshot is held
+bool check_no_damage(GameWorld& world)
+{
+    WorldSnapshot snapshot = world.Snapshot();
+    size_t copies = world.RegionStats().copies;
+    int empty = 0;
+    for(int s = 0; s < world.SectionCount(); s++)
+    {
+        int x0, y0, z0, x1, y1, z1;
+        world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+        world.DecreaseBlockHealth(x0, y0, z0, 0);
+        if(world.GetBlockType(x1, y1, z1) == BLOCK_TYPE_NONE)
+        {
+            world.DecreaseBlockHealth(x1, y1, z1, 1);
+            empty++;
+        }
+    }
+    bool ok = world.RegionStats().copies == copies && empty > 0;
+    std::cout << "no damage check " << (ok ? "passed" : "FAILED") << ", "
+              << world.RegionStats().copies - copies << " regions copied" << std::endl;
+    return ok;
+}
+
+// the first change of every section after a snapshot copies its region
+void bench_copies(GameWorld& world)
+{
+    auto touch_sections = [&]() {
+        for(int s = 0; s < world.SectionCount(); s++)
+        {
+            int x0, y0, z0, x1, y1, z1;
+            world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+            _block_t block = world.BlockAt(x0, y0, z0);
+            _block_t changed = block;
+            changed.health = block.health + 1;
+            world.SetBlock(x0, y0, z0, changed);
+            world.SetBlock(x0, y0, z0, block);
+        }
+    };
+    bench::run("change every section", 20, [&]() {
+        touch_sections();
+    });
+    bench::run("change every section, snapshot held", 20, [&]() {
+        WorldSnapshot snapshot = world.Snapshot();
+        touch_sections();
+    });
+    std::cout << "  " << world.StorageStats().used << " sections with blocks, "
+              << world.RegionStats().copies << " regions copied in total" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+
+    bool ok = stress();
+
+    GameWorld world(WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH);
+    world_generator::generate_terrain(&world, WORLD_WIDTH, WORLD_HEIGHT, WORLD_WIDTH, WORLD_SEED);
+    ok = check_no_damage(world) && ok;
+    bench_readers(world);
+    bench_copies(world);
+
+    int code = bench::finish();
+    return ok ? code : 1;
+}
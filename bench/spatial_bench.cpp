@@ -0,0 +1,129 @@
+
+// CUSTOM
+#include "../engine/spatial_hash.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+#include <vector>
+
+float random_float(float lo, float hi)
+{
+    return lo + (hi - lo) * (rand() / (float)RAND_MAX);
+}
+
+// brute-force baseline: test every point against the query sphere
+size_t brute_force_radius(const std::vector<glm::vec3>& points,
+                          const glm::vec3& center, float radius)
+{
+    float r2 = radius * radius;
+    size_t found = 0;
+    for(size_t i = 0; i < points.size(); i++)
+    {
+        glm::vec3 d = points[i] - center;
+        if(glm::dot(d, d) <= r2) {
+            found++;
+        }
+    }
+    return found;
+}
+
+void bench_points(int count)
+{
+    // mobs spread over a 512x64x512 block area, a cell is 4 blocks
+    std::vector<glm::vec3> points(count);
+    for(int i = 0; i < count; i++) {
+        points[i] = glm::vec3(random_float(0, 512), random_float(0, 64),
+                              random_float(0, 512));
+    }
+    std::vector<glm::vec3> queries(1000);
+    for(size_t i = 0; i < queries.size(); i++) {
+        queries[i] = points[rand() % count];
+    }
+    const float radius = 8.0f;
+    std::string n = std::to_string(count);
+
+    spatial::SpatialHash grid(4.0f);
+    for(int i = 0; i < count; i++) {
+        grid.Insert(i, points[i]);
+    }
+
+    // the two must agree before their timings mean anything
+    size_t expected = 0, actual = 0;
+    for(size_t q = 0; q < queries.size(); q++)
+    {
+        expected += brute_force_radius(points, queries[q], radius);
+        grid.ForEachInRadius(queries[q], radius,
+                             [&actual](uint32_t, const glm::vec3&) { actual++; });
+    }
+    if(expected != actual)
+    {
+        std::cerr << "spatial hash found " << actual << " neighbours, brute force "
+                  << expected << std::endl;
+        exit(1);
+    }
+
+    bench::run("brute force 1000 radius queries, " + n, 5, [&]() {
+        size_t found = 0;
+        for(size_t q = 0; q < queries.size(); q++) {
+            found += brute_force_radius(points, queries[q], radius);
+        }
+        bench::keep(found);
+    });
+
+    bench::run("hash 1000 radius queries, " + n, 50, [&]() {
+        size_t found = 0;
+        for(size_t q = 0; q < queries.size(); q++) {
+            grid.ForEachInRadius(queries[q], radius,
+                                 [&found](uint32_t, const glm::vec3&) { found++; });
+        }
+        bench::keep(found);
+    });
+
+    bench::run("hash 1000 AABB queries, " + n, 50, [&]() {
+        size_t found = 0;
+        glm::vec3 ext(4.0f, 2.0f, 4.0f);
+        for(size_t q = 0; q < queries.size(); q++) {
+            grid.ForEachInAABB(queries[q] - ext, queries[q] + ext,
+                               [&found](uint32_t, const glm::vec3&) { found++; });
+        }
+        bench::keep(found);
+    });
+
+    bench::run("hash move all, " + n, 20, [&]() {
+        for(int i = 0; i < count; i++)
+        {
+            points[i].x += 0.25f;
+            grid.Move(i, points[i]);
+        }
+    });
+
+    bench::run("hash remove+insert all, " + n, 20, [&]() {
+        for(int i = 0; i < count; i++) {
+            grid.Remove(i);
+        }
+        for(int i = 0; i < count; i++) {
+            grid.Insert(i, points[i]);
+        }
+    });
+
+    bench::run("hash rebuild 1 thread, " + n, 20, [&]() {
+        grid.Rebuild(&points[0], points.size(), 1);
+    });
+
+    bench::run("hash rebuild all threads, " + n, 20, [&]() {
+        grid.Rebuild(&points[0], points.size());
+    });
+}
+
+int main(int argc, char* argv[])
+{
+    bench::parse_args(argc, argv);
+    srand(1);
+
+    bench_points(1000);
+    bench_points(10000);
+    bench_points(100000);
+
+    return bench::finish();
+}
@@ -0,0 +1,67 @@
+
+// CUSTOM
+#include "../engine/tick_scheduler.hpp"
+#include "bench.hpp"
+
+// STANDARD
+#include <cstdlib>
+
+// queue `count' updates at distinct positions, due 1 to 100 ticks from now
+void fill(ticks::TickScheduler& scheduler, int count)
+{
+    scheduler.Reserve(count);
+    for(int i = 0; i < count; i++)
+    {
+        // distinct positions in a 256 x 256 x 256 volume
+        scheduler.Schedule(i & 255, (i >> 8) & 255, (i >> 16) & 255,
+                           1 + rand() % 100);
+    }
+}
+
+void bench_queue(int count, size_t budget)
+{
+    std::string name = std::to_string(count) + " updates, budget "
+                     + std::to_string(budget);
+
+    ticks::TickScheduler scheduler(budget);
+    bench::Stopwatch sw;
+    fill(scheduler, count);
+    double schedule_ms = sw.ElapsedMs();
+
+    // every update reschedules one in ten of its positions, as falling
+    // blocks would
+    size_t ticks = 0, executed = 0, max_carried = 0;
+    sw.Reset();
+    while(scheduler.PendingCount() > 0)
+    {
+        executed += scheduler.Process([&](int x, int y, int z) {
+            if(((x ^ y ^ z) & 15) == 0 && y > 0) {
+                scheduler.Schedule(x, y - 1, z, 2);
+            }
+        });
+        if(scheduler.Stats().carried_over > max_carried) {
+            max_carried = scheduler.Stats().carried_over;
+        }
+        ticks++;
+    }
+    double process_ms = sw.ElapsedMs();
+
+    std::cout << name << std::endl
+              << "  schedule  " << schedule_ms << " ms ("
+              << (schedule_ms * 1e6 / count) << " ns/update)" << std::endl
+              << "  process   " << process_ms << " ms ("
+              << (process_ms * 1e6 / executed) << " ns/update), "
+              << executed << " updates over " << ticks << " ticks, "
+              << "max carried over " << max_carried << std::endl;
+}
+
+int main()
+{
+    srand(1);
+
+    bench_queue(1000000, 65536);
+    bench_queue(4000000, 65536);
+    bench_queue(4000000, 16384);
+
+    return 0;
+}
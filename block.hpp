@@ -0,0 +1,60 @@
+#ifndef BLOCK_HPP
+#define BLOCK_HPP
+
+// level of a fluid source block
+#define FLUID_SOURCE 8
+
+typedef enum {
+    BLOCK_TYPE_EARTH,
+    BLOCK_TYPE_GRASS,
+    BLOCK_TYPE_STONE,
+    BLOCK_TYPE_SAND,
+    BLOCK_TYPE_WATER,
+    BLOCK_TYPE_LAVA,
+
+    // a block that does not exist, should not be used
+    // for collision detection or AI routines, and
+    // definitely not should be drawn.
+    BLOCK_TYPE_NONE
+} _block_type_t;
+
+typedef struct _block_t {
+    // default health of a block is 10. When health
+    // reaches < 0 it should be destroyed.
+    _block_t() : type(BLOCK_TYPE_NONE), health(0), level(0) {}
+    _block_t(_block_type_t type) : type(type), health(10), level(0) {}
+    _block_t(_block_type_t type, int health) : type(type), health(health), level(0) {}
+
+    _block_type_t type;
+    int health;
+
+    // fluid level, FLUID_SOURCE for source blocks, and 1 (almost dried up)
+    // to FLUID_SOURCE - 1 for flowing fluid. Unused by other blocks.
+    unsigned char level;
+} _block_t;
+
+
+// blocks reacting to random ticks (grass spreading or dying)
+inline bool receives_random_ticks(_block_type_t type)
+{
+    return type == BLOCK_TYPE_GRASS;
+}
+
+// blocks that fall down when there is nothing below them
+inline bool affected_by_gravity(_block_type_t type)
+{
+    return type == BLOCK_TYPE_SAND;
+}
+
+inline bool is_fluid(_block_type_t type)
+{
+    return type == BLOCK_TYPE_WATER || type == BLOCK_TYPE_LAVA;
+}
+
+// anything fluids cannot flow into
+inline bool is_solid(_block_type_t type)
+{
+    return type != BLOCK_TYPE_NONE && !is_fluid(type);
+}
+
+#endif // BLOCK_HPP
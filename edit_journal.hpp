@@ -0,0 +1,549 @@
+#ifndef EDIT_JOURNAL_HPP
+#define EDIT_JOURNAL_HPP
+
+// STANDARD
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// CUSTOM
+#include "block.hpp"
+
+// bytes of history kept in memory before the oldest is spilled to disk
+#ifndef JOURNAL_MEMORY_CAP
+#define JOURNAL_MEMORY_CAP (16 << 20)
+#endif
+
+// kinds of records
+#define JOURNAL_BLOCK 0 // one block, before and after
+#define JOURNAL_BOX   1 // every block of a box, before and after
+
+typedef struct _journal_stats_t {
+    _journal_stats_t() : transactions(0), redoable(0), memory_bytes(0), disk_bytes(0),
+                         spilled(0), dropped(0) {}
+
+    size_t transactions; // that can be undone
+    size_t redoable;     // undone, that can be redone
+    size_t memory_bytes; // encoded history in memory
+    size_t disk_bytes;   // encoded history in the spill file
+    size_t spilled;      // transactions written to disk, in total
+    size_t dropped;      // transactions forgotten for lack of room, in total
+} _journal_stats_t;
+
+// a run of equal blocks within a box record, from block `start' (in box
+// order, x fastest) until the next run
+typedef struct _journal_run_t {
+    size_t start;
+    _block_t block;
+} _journal_run_t;
+
+// one decoded record of a transaction
+typedef struct _journal_record_t {
+    int kind;
+
+    // JOURNAL_BLOCK: (z * height + y) * width + x
+    unsigned position;
+    _block_t before, after;
+
+    // JOURNAL_BOX: inclusive corners, and the runs of blocks before and
+    // after in `_journal_transaction_t::runs'
+    int min[3], max[3];
+    size_t before_runs, after_runs, run_count[2];
+} _journal_record_t;
+
+typedef struct _journal_transaction_t {
+    std::vector<_journal_record_t> records;
+    std::vector<_journal_run_t> runs;
+} _journal_transaction_t;
+
+// History of the changes made to the blocks of a world, grouped into
+// transactions that are undone and redone as a whole.
+//
+// Transactions are kept encoded: a changed block takes the distance from
+// the previously changed position as a variable length integer, and the
+// blocks before and after in a few bytes each, and a box changed in bulk
+// takes its corners and the runs of equal blocks it held before and after,
+// so filling a large box costs a few bytes instead of a record per block.
+// Undoing or redoing decodes one transaction, in time proportional to its
+// size.
+//
+// Once the encoded history outgrows the memory cap, the oldest
+// transactions are written to a spill file and read back when undone. Without
+// a spill file they are forgotten. Redoable transactions are always in memory
+// and go away with the next transaction.
+//
+// Proper usage:
+//
+// EditJournal journal(JOURNAL_MEMORY_CAP, "journal.bin");
+// journal.Begin();
+// journal.RecordBlock(position, before, after);
+// journal.End();
+// _journal_transaction_t transaction;
+// if(journal.Undo(transaction)) {
+//     ... (apply `before' of the records, last one first) ...
+// }
+class EditJournal
+{
+public:
+    // blocks of a box in box order, encoded as runs of equal blocks
+    class Runs
+    {
+    private:
+        std::vector<unsigned char> _data;
+        _block_t _block;
+        size_t _length;
+
+        void Flush()
+        {
+            if(_length > 0)
+            {
+                PutVarint(_data, _length);
+                PutBlock(_data, _block);
+            }
+        }
+
+    public:
+        Runs() : _length(0) {}
+
+        void Add(const _block_t* blocks, int count)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                if(_length > 0 && SameBlock(blocks[i], _block))
+                {
+                    _length++;
+                    continue;
+                }
+                Flush();
+                _block = blocks[i];
+                _length = 1;
+            }
+        }
+
+        // the encoded runs, no more blocks can be added
+        const std::vector<unsigned char>& Finish()
+        {
+            Flush();
+            _length = 0;
+            return _data;
+        }
+    };
+
+private:
+    struct Transaction
+    {
+        Transaction() : size(0), offset(-1), records(0) {}
+
+        std::vector<unsigned char> data; // empty while on disk
+        size_t size;
+        long offset;                     // in the spill file, -1 in memory
+        size_t records;
+    };
+
+    size_t _memory_cap;
+    std::string _spill_path;
+    std::fstream _spill;
+    long _spill_end;
+    size_t _on_disk;
+
+    std::deque<Transaction> _undo; // oldest first
+    std::vector<Transaction> _redo; // most recently undone last
+
+    Transaction _open;
+    int _depth;
+    unsigned _last_position;
+
+    _journal_stats_t _stats;
+
+    EditJournal(const EditJournal&);
+    EditJournal& operator=(const EditJournal&);
+
+    // ENCODING
+    static bool SameBlock(const _block_t& a, const _block_t& b)
+    {
+        return a.type == b.type && a.health == b.health && a.level == b.level;
+    }
+
+    static void PutVarint(std::vector<unsigned char>& data, uint64_t value)
+    {
+        while(value >= 0x80)
+        {
+            data.push_back((unsigned char)(value | 0x80));
+            value >>= 7;
+        }
+        data.push_back((unsigned char)value);
+    }
+
+    // small magnitudes of either sign in few bytes
+    static void PutSigned(std::vector<unsigned char>& data, int64_t value)
+    {
+        PutVarint(data, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    }
+
+    static void PutBlock(std::vector<unsigned char>& data, const _block_t& block)
+    {
+        data.push_back((unsigned char)block.type);
+        data.push_back(block.level);
+        PutSigned(data, block.health);
+    }
+
+    static uint64_t GetVarint(const unsigned char*& p)
+    {
+        uint64_t value = 0;
+        for(int shift = 0; ; shift += 7)
+        {
+            unsigned char byte = *p++;
+            value |= (uint64_t)(byte & 0x7F) << shift;
+            if(byte < 0x80) {
+                return value;
+            }
+        }
+    }
+
+    static int64_t GetSigned(const unsigned char*& p)
+    {
+        uint64_t value = GetVarint(p);
+        return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+    }
+
+    static _block_t GetBlock(const unsigned char*& p)
+    {
+        _block_t block;
+        block.type = (_block_type_t)*p++;
+        block.level = *p++;
+        block.health = (int)GetSigned(p);
+        return block;
+    }
+
+    // runs of a box of `volume' blocks, appended to `runs'
+    static size_t GetRuns(const unsigned char*& p, size_t volume, std::vector<_journal_run_t>& runs)
+    {
+        size_t count = 0;
+        for(size_t start = 0; start < volume; count++)
+        {
+            _journal_run_t run;
+            run.start = start;
+            start += GetVarint(p);
+            run.block = GetBlock(p);
+            runs.push_back(run);
+        }
+        return count;
+    }
+
+    void Decode(const Transaction& transaction, _journal_transaction_t& out) const
+    {
+        out.records.clear();
+        out.runs.clear();
+        const unsigned char* p = transaction.data.empty() ? NULL : &transaction.data[0];
+        unsigned position = 0;
+        for(size_t r = 0; r < transaction.records; r++)
+        {
+            _journal_record_t record;
+            uint64_t head = GetVarint(p);
+            record.kind = (head & 1) ? JOURNAL_BOX : JOURNAL_BLOCK;
+            if(record.kind == JOURNAL_BLOCK)
+            {
+                uint64_t delta = head >> 1;
+                position += (unsigned)((int64_t)(delta >> 1) ^ -(int64_t)(delta & 1));
+                record.position = position;
+                record.before = GetBlock(p);
+                record.after = GetBlock(p);
+            }
+            else
+            {
+                size_t volume = 1;
+                for(int a = 0; a < 3; a++) {
+                    record.min[a] = (int)GetVarint(p);
+                }
+                for(int a = 0; a < 3; a++)
+                {
+                    record.max[a] = record.min[a] + (int)GetVarint(p);
+                    volume *= record.max[a] - record.min[a] + 1;
+                }
+                record.before_runs = out.runs.size();
+                record.run_count[0] = GetRuns(p, volume, out.runs);
+                record.after_runs = out.runs.size();
+                record.run_count[1] = GetRuns(p, volume, out.runs);
+            }
+            out.records.push_back(record);
+        }
+    }
+
+    // SPILLING
+    bool Write(Transaction& transaction)
+    {
+        if(!_spill.is_open())
+        {
+            _spill.open(_spill_path.c_str(), std::ios::in | std::ios::out | std::ios::binary |
+                                             std::ios::trunc);
+            if(!_spill.is_open())
+            {
+                std::cerr << "Could not open the journal spill file '" << _spill_path << "'"
+                          << std::endl;
+                return false;
+            }
+        }
+        _spill.clear();
+        _spill.seekp(_spill_end);
+        _spill.write((const char*)&transaction.data[0], transaction.size);
+        if(!_spill)
+        {
+            std::cerr << "Could not write to the journal spill file '" << _spill_path << "'"
+                      << std::endl;
+            return false;
+        }
+        transaction.offset = _spill_end;
+        _spill_end += (long)transaction.size;
+        std::vector<unsigned char>().swap(transaction.data);
+        _on_disk++;
+        _stats.disk_bytes += transaction.size;
+        return true;
+    }
+
+    bool Read(Transaction& transaction)
+    {
+        transaction.data.resize(transaction.size);
+        _spill.clear();
+        _spill.seekg(transaction.offset);
+        _spill.read((char*)&transaction.data[0], transaction.size);
+        if(!_spill)
+        {
+            std::cerr << "Could not read from the journal spill file '" << _spill_path << "'"
+                      << std::endl;
+            return false;
+        }
+        transaction.offset = -1;
+        _stats.disk_bytes -= transaction.size;
+        // the file starts over once nothing in it is needed
+        if(--_on_disk == 0) {
+            _spill_end = 0;
+        }
+        return true;
+    }
+
+    // spill, or drop, the oldest transactions in memory until the history
+    // fits under the cap again
+    void Enforce()
+    {
+        for(size_t t = 0; t < _undo.size() && _stats.memory_bytes > _memory_cap; t++)
+        {
+            Transaction& transaction = _undo[t];
+            if(transaction.offset >= 0) {
+                continue;
+            }
+            if(!_spill_path.empty() && Write(transaction))
+            {
+                _stats.memory_bytes -= transaction.size;
+                _stats.spilled++;
+                continue;
+            }
+            // forget everything up to here, spilled or not
+            for(size_t d = 0; d <= t; d++) {
+                Forget(_undo[d]);
+            }
+            _undo.erase(_undo.begin(), _undo.begin() + t + 1);
+            _stats.dropped += t + 1;
+            t = (size_t)-1;
+        }
+        _stats.transactions = _undo.size();
+    }
+
+    void Forget(const Transaction& transaction)
+    {
+        if(transaction.offset >= 0)
+        {
+            _stats.disk_bytes -= transaction.size;
+            if(--_on_disk == 0) {
+                _spill_end = 0;
+            }
+        }
+        else {
+            _stats.memory_bytes -= transaction.size;
+        }
+    }
+
+public:
+    // spilling to `spill_path' once more than `memory_cap' bytes are used,
+    // forgetting the oldest history instead without a path
+    EditJournal(size_t memory_cap = JOURNAL_MEMORY_CAP, const std::string& spill_path = "")
+        : _memory_cap(memory_cap), _spill_path(spill_path), _spill_end(0), _on_disk(0),
+          _depth(0), _last_position(0) {}
+
+    ~EditJournal()
+    {
+        if(_spill.is_open())
+        {
+            _spill.close();
+            remove(_spill_path.c_str());
+        }
+    }
+
+    void SetMemoryCap(size_t bytes)
+    {
+        _memory_cap = bytes;
+        Enforce();
+    }
+
+    size_t MemoryCap() const
+    {
+        return _memory_cap;
+    }
+
+    // where to spill to from now on, "" forgets instead. Transactions
+    // already spilled are lost with the old file, and so is the rest of the
+    // history then, which could not be undone past them
+    void SetSpillPath(const std::string& path)
+    {
+        if(path == _spill_path) {
+            return;
+        }
+        if(_on_disk > 0) {
+            Clear();
+        }
+        if(_spill.is_open())
+        {
+            _spill.close();
+            remove(_spill_path.c_str());
+        }
+        _spill_path = path;
+    }
+
+    // TRANSACTIONS
+    // changes between `Begin' and `End' are undone as one. Nested calls
+    // join the outermost transaction
+    void Begin()
+    {
+        if(_depth++ == 0)
+        {
+            _open = Transaction();
+            _last_position = 0;
+        }
+    }
+
+    void End()
+    {
+        if(_depth == 0)
+        {
+            std::cerr << "Ending a journal transaction that was not begun" << std::endl;
+            return;
+        }
+        if(--_depth > 0 || _open.records == 0) {
+            return;
+        }
+        // a new change makes what was undone unreachable
+        for(size_t t = 0; t < _redo.size(); t++) {
+            _stats.memory_bytes -= _redo[t].size;
+        }
+        _redo.clear();
+        _stats.redoable = 0;
+
+        _open.size = _open.data.size();
+        std::vector<unsigned char>(_open.data).swap(_open.data);
+        _stats.memory_bytes += _open.size;
+        _undo.push_back(Transaction());
+        std::swap(_undo.back(), _open);
+        Enforce();
+    }
+
+    // whether changes are being recorded
+    bool Recording() const
+    {
+        return _depth > 0;
+    }
+
+    void RecordBlock(unsigned position, const _block_t& before, const _block_t& after)
+    {
+        // kind in the lowest bit, the distance from the last position above
+        int64_t delta = (int64_t)position - (int64_t)_last_position;
+        PutVarint(_open.data, ((((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63)) << 1) | JOURNAL_BLOCK);
+        PutBlock(_open.data, before);
+        PutBlock(_open.data, after);
+        _last_position = position;
+        _open.records++;
+    }
+
+    // every block of the inclusive box from `min' to `max' changed, from
+    // the runs `before' to the runs `after'
+    void RecordBox(const int min[3], const int max[3], Runs& before, Runs& after)
+    {
+        PutVarint(_open.data, JOURNAL_BOX);
+        for(int a = 0; a < 3; a++) {
+            PutVarint(_open.data, min[a]);
+        }
+        for(int a = 0; a < 3; a++) {
+            PutVarint(_open.data, max[a] - min[a]);
+        }
+        const std::vector<unsigned char>& b = before.Finish();
+        _open.data.insert(_open.data.end(), b.begin(), b.end());
+        const std::vector<unsigned char>& a = after.Finish();
+        _open.data.insert(_open.data.end(), a.begin(), a.end());
+        _open.records++;
+    }
+
+    // the most recent transaction, to apply the `before' of its records in
+    // reverse order. False if there is none, or it could not be read back
+    bool Undo(_journal_transaction_t& transaction)
+    {
+        if(_depth > 0 || _undo.empty()) {
+            return false;
+        }
+        Transaction& last = _undo.back();
+        if(last.offset >= 0)
+        {
+            if(!Read(last)) {
+                return false;
+            }
+            _stats.memory_bytes += last.size;
+        }
+        Decode(last, transaction);
+        _redo.push_back(Transaction());
+        std::swap(_redo.back(), last);
+        _undo.pop_back();
+        _stats.transactions = _undo.size();
+        _stats.redoable = _redo.size();
+        return true;
+    }
+
+    // the most recently undone transaction, to apply the `after' of its
+    // records in order
+    bool Redo(_journal_transaction_t& transaction)
+    {
+        if(_depth > 0 || _redo.empty()) {
+            return false;
+        }
+        Decode(_redo.back(), transaction);
+        _undo.push_back(Transaction());
+        std::swap(_undo.back(), _redo.back());
+        _redo.pop_back();
+        _stats.redoable = _redo.size();
+        Enforce();
+        return true;
+    }
+
+    // forget all history
+    void Clear()
+    {
+        for(size_t t = 0; t < _undo.size(); t++) {
+            Forget(_undo[t]);
+        }
+        for(size_t t = 0; t < _redo.size(); t++) {
+            Forget(_redo[t]);
+        }
+        _undo.clear();
+        _redo.clear();
+        _stats.transactions = _stats.redoable = 0;
+    }
+
+    const _journal_stats_t& Stats() const
+    {
+        return _stats;
+    }
+};
+
+#endif // EDIT_JOURNAL_HPP
@@ -0,0 +1,63 @@
+#ifndef ALLOC_COUNTER_HPP
+#define ALLOC_COUNTER_HPP
+
+// STANDARD
+#include <stddef.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+// Counts every heap allocation made through operator new, so a frame can
+// be checked for allocating nothing once the game runs steadily.
+//
+// Replaces the global operator new and delete, which may only happen once
+// per program, and only when ALLOC_COUNTER_ENABLED is defined. Otherwise
+// nothing is counted and `Enabled' is false. Memory the C library or the
+// OpenGL driver allocate with malloc is not counted.
+//
+// Proper usage:
+//
+// size_t before = alloc_counter::Allocations();
+// ... (render a frame) ...
+// size_t allocations = alloc_counter::Allocations() - before;
+namespace alloc_counter
+{
+    static std::atomic<size_t> _allocations(0);
+    static std::atomic<size_t> _bytes(0);
+
+    bool Enabled()
+    {
+    #ifdef ALLOC_COUNTER_ENABLED
+        return true;
+    #else
+        return false;
+    #endif
+    }
+
+    // since the program started
+    size_t Allocations() { return _allocations.load(std::memory_order_relaxed); }
+    size_t Bytes() { return _bytes.load(std::memory_order_relaxed); }
+
+    void* Allocate(size_t bytes)
+    {
+        _allocations.fetch_add(1, std::memory_order_relaxed);
+        _bytes.fetch_add(bytes, std::memory_order_relaxed);
+        void* ptr = malloc(bytes > 0 ? bytes : 1);
+        if(ptr == NULL) {
+            throw std::bad_alloc();
+        }
+        return ptr;
+    }
+
+} // namespace alloc_counter
+
+#ifdef ALLOC_COUNTER_ENABLED
+void* operator new(size_t bytes) { return alloc_counter::Allocate(bytes); }
+void* operator new[](size_t bytes) { return alloc_counter::Allocate(bytes); }
+void operator delete(void* ptr) noexcept { free(ptr); }
+void operator delete[](void* ptr) noexcept { free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { free(ptr); }
+#endif
+
+#endif // ALLOC_COUNTER_HPP
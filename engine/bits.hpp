@@ -0,0 +1,47 @@
+#ifndef BITS_HPP
+#define BITS_HPP
+
+// STANDARD
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Counting bits of a word with the single instructions CPUs have for it
+// (tzcnt/bsf and popcnt on x86), through the compiler's builtins.
+//
+// Proper usage:
+//
+// while(mask != 0) {
+//     int bit = bits::CountTrailingZeros(mask);
+//     ... (use `bit') ...
+//     mask &= mask - 1;
+// }
+namespace bits
+{
+    // index of the lowest set bit, `value' must not be 0
+    inline int CountTrailingZeros(uint32_t value)
+    {
+    #if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return (int)index;
+    #else
+        return __builtin_ctz(value);
+    #endif
+    }
+
+    // number of set bits
+    inline int PopCount(uint32_t value)
+    {
+    #if defined(_MSC_VER)
+        return (int)__popcnt(value);
+    #else
+        return __builtin_popcount(value);
+    #endif
+    }
+
+} // namespace bits
+
+#endif // BITS_HPP
@@ -0,0 +1,110 @@
+#ifndef BLOCK_LAYOUT_HPP
+#define BLOCK_LAYOUT_HPP
+
+// STANDARD
+#include <stddef.h>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+// Order of the blocks of a cube of BLOCK_LAYOUT_SIDE blocks per axis in
+// memory, i.e. of a world section:
+//
+// LAYOUT_XYZ    - x fastest, then y, then z. Rows along x
+// LAYOUT_XZY    - x fastest, then z, then y. Horizontal layers
+// LAYOUT_YZX    - y fastest, then z, then x. Vertical columns
+// LAYOUT_MORTON - the bits of x, y and z interleaved (a Z-order curve), so
+//                 neighbours along every axis are mostly close by
+//
+// The layout GameWorld uses is picked at compile time with BLOCK_LAYOUT,
+// e.g. -DBLOCK_LAYOUT=LAYOUT_MORTON, so looking up a block costs no more
+// than before. `Index<layout>' gives every layout, for benchmarks. Morton
+// indices use BMI2's `pdep' when compiled for it (-mbmi2 or -march=native),
+// and a small table otherwise.
+//
+// Proper usage:
+//
+// _block_t* blocks = ... (BLOCK_LAYOUT_SIDE^3 blocks) ...;
+// _block_t& block = blocks[block_layout::Index(x, y, z)];
+namespace block_layout
+{
+    // bits per coordinate, 16 blocks a side
+    #define BLOCK_LAYOUT_BITS 4
+    #define BLOCK_LAYOUT_SIDE (1 << BLOCK_LAYOUT_BITS)
+
+    typedef enum {
+        LAYOUT_XYZ,
+        LAYOUT_XZY,
+        LAYOUT_YZX,
+        LAYOUT_MORTON
+    } _layout_t;
+
+    #define LAYOUT_COUNT 4
+
+    #ifndef BLOCK_LAYOUT
+    #define BLOCK_LAYOUT LAYOUT_XYZ
+    #endif
+
+    const char* Name(_layout_t layout)
+    {
+        static const char* names[LAYOUT_COUNT] = { "xyz", "xzy", "yzx", "morton" };
+        return names[layout];
+    }
+
+    // the 4 bits of `v' moved to bits 0, 3, 6 and 9
+    inline unsigned Spread(unsigned v)
+    {
+    #ifdef __BMI2__
+        return _pdep_u32(v, 0x249);
+    #else
+        static const unsigned short spread[BLOCK_LAYOUT_SIDE] = {
+            0x000, 0x001, 0x008, 0x009, 0x040, 0x041, 0x048, 0x049,
+            0x200, 0x201, 0x208, 0x209, 0x240, 0x241, 0x248, 0x249
+        };
+        return spread[v];
+    #endif
+    }
+
+    // position of block (x, y, z) within its cube, coordinates of the
+    // world are taken modulo the side
+    template<_layout_t layout>
+    inline unsigned Index(unsigned x, unsigned y, unsigned z);
+
+    template<>
+    inline unsigned Index<LAYOUT_XYZ>(unsigned x, unsigned y, unsigned z)
+    {
+        const unsigned mask = BLOCK_LAYOUT_SIDE - 1;
+        return (((z & mask) << BLOCK_LAYOUT_BITS | (y & mask)) << BLOCK_LAYOUT_BITS) | (x & mask);
+    }
+
+    template<>
+    inline unsigned Index<LAYOUT_XZY>(unsigned x, unsigned y, unsigned z)
+    {
+        const unsigned mask = BLOCK_LAYOUT_SIDE - 1;
+        return (((y & mask) << BLOCK_LAYOUT_BITS | (z & mask)) << BLOCK_LAYOUT_BITS) | (x & mask);
+    }
+
+    template<>
+    inline unsigned Index<LAYOUT_YZX>(unsigned x, unsigned y, unsigned z)
+    {
+        const unsigned mask = BLOCK_LAYOUT_SIDE - 1;
+        return (((x & mask) << BLOCK_LAYOUT_BITS | (z & mask)) << BLOCK_LAYOUT_BITS) | (y & mask);
+    }
+
+    template<>
+    inline unsigned Index<LAYOUT_MORTON>(unsigned x, unsigned y, unsigned z)
+    {
+        const unsigned mask = BLOCK_LAYOUT_SIDE - 1;
+        return Spread(x & mask) | Spread(y & mask) << 1 | Spread(z & mask) << 2;
+    }
+
+    // in the layout chosen at compile time
+    inline unsigned Index(unsigned x, unsigned y, unsigned z)
+    {
+        return Index<BLOCK_LAYOUT>(x, y, z);
+    }
+
+} // namespace block_layout
+
+#endif // BLOCK_LAYOUT_HPP
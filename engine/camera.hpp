@@ -31,6 +31,7 @@ namespace camera
         glm::vec3 up;
 
         GLfloat fov, max_fov, min_fov;
+        GLfloat far_plane;
 
         GLfloat lastX;
         GLfloat lastY;
@@ -53,6 +54,7 @@ namespace camera
             fov = 45.0f;
             max_fov = 45.0f;
             min_fov = 44.3f;
+            far_plane = 200.0f;
 
             lastX = width / 2.0f;
             lastY = height / 2.0f;
@@ -63,6 +65,7 @@ namespace camera
 
         const glm::mat4* ViewMatrix() { return &view; }
         const glm::mat4* ProjectionMatrix() { return &projection; }
+        const glm::vec3& Position() { return pos; }
 
         void SetInitialPosition(GLfloat x, GLfloat y, GLfloat z)
         {
@@ -73,6 +76,28 @@ namespace camera
         {
         }
 
+        // distance of the far plane, in world units
+        void SetViewDistance(GLfloat distance)
+        {
+            far_plane = distance;
+        }
+
+        GLfloat ViewDistance() const { return far_plane; }
+
+        // turn the camera towards a point, e.g. for scripted flights
+        void LookAt(GLfloat x, GLfloat y, GLfloat z)
+        {
+            glm::vec3 dir = glm::vec3(x, y, z) - pos;
+            if(glm::length(dir) == 0.0f) {
+                return;
+            }
+            front = glm::normalize(dir);
+
+            // keep mouse look continuing from here
+            pitch = glm::degrees(asin(front.y));
+            yaw = glm::degrees(atan2(front.z, front.x));
+        }
+
         void MouseCallback(GLFWwindow* window, double xpos, double ypos)
         {
             GLfloat xoffset = xpos - lastX;
@@ -135,7 +160,7 @@ namespace camera
         {
             view = glm::lookAt(pos, pos + front, up);
             projection = glm::perspective(fov, window_width / window_height,
-                                          0.1f, 200.0f);
+                                          0.1f, far_plane);
         }
     }; // BasicFPSCamera
 
@@ -0,0 +1,562 @@
+#ifndef ECS_HPP
+#define ECS_HPP
+
+// GLM
+#include <glm/glm.hpp>
+
+// STANDARD
+#include <stdint.h>
+#include <cstdlib>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <iostream>
+
+// Entity-component system.
+//
+// Components are stored per archetype (the exact set of component types an
+// entity has) as structure-of-arrays: one tightly packed column per component
+// type. A query only visits archetypes that contain all requested components,
+// and walks their columns linearly, which keeps iteration cache friendly even
+// with tens of thousands of entities.
+//
+// Structural changes (create/destroy/add/remove) issued while a query is
+// running are deferred, and applied once the outermost query has finished.
+//
+// Proper usage:
+//
+// ecs::Registry reg;
+// ecs::Entity e = reg.Create();
+// reg.Add(e, ecs::Position(x, y, z));
+// reg.Add(e, ecs::Velocity(0.0f, 0.0f, 1.0f));
+//
+// reg.Each<ecs::Position, ecs::Velocity>(
+//     [&](ecs::Entity e, ecs::Position& p, ecs::Velocity& v) {
+//         p.value += v.value * dt;
+//     });
+// maximum number of distinct component types, one bit each in a mask
+#define ECS_MAX_COMPONENTS 64
+
+namespace ecs
+{
+    typedef uint64_t mask_t;
+
+    // handle to an entity. The generation is bumped every time the slot is
+    // reused, so handles to destroyed entities can be detected.
+    struct Entity
+    {
+        uint32_t index;
+        uint32_t generation;
+
+        bool operator==(const Entity& other) const
+        {
+            return index == other.index && generation == other.generation;
+        }
+        bool operator!=(const Entity& other) const { return !(*this == other); }
+    };
+
+    // COMMON COMPONENTS
+    struct Position
+    {
+        Position() : value(0.0f) {}
+        Position(float x, float y, float z) : value(x, y, z) {}
+        glm::vec3 value;
+    };
+
+    struct Velocity
+    {
+        Velocity() : value(0.0f) {}
+        Velocity(float x, float y, float z) : value(x, y, z) {}
+        glm::vec3 value;
+    };
+
+    // axis-aligned box centered on the entity's position
+    struct Collider
+    {
+        Collider() : half_extents(0.5f) {}
+        Collider(float x, float y, float z) : half_extents(x, y, z) {}
+        glm::vec3 half_extents;
+    };
+
+
+    unsigned int next_component_id()
+    {
+        static unsigned int counter = 0;
+        return counter++;
+    }
+
+    // every component type gets a unique small id on first use. Ids are
+    // handed out at run time, so running out of them can only be caught
+    // here, and aborts: past ECS_MAX_COMPONENTS they would not fit a mask
+    template<typename T>
+    unsigned int component_id()
+    {
+        static unsigned int id = next_component_id();
+        if(id >= ECS_MAX_COMPONENTS)
+        {
+            std::cerr << "Too many component types, raise ECS_MAX_COMPONENTS"
+                      << std::endl;
+            abort();
+        }
+        return id;
+    }
+
+    template<typename... Ts> struct mask_of;
+    template<> struct mask_of<>
+    {
+        static mask_t get() { return 0; }
+    };
+    template<typename T, typename... Rest> struct mask_of<T, Rest...>
+    {
+        static mask_t get()
+        {
+            return (mask_t(1) << component_id<T>()) | mask_of<Rest...>::get();
+        }
+    };
+
+
+    // type-erased component column, so an archetype can hold any mix of types
+    class BaseColumn
+    {
+    public:
+        virtual ~BaseColumn() {}
+
+        // a new, empty column of the same component type
+        virtual BaseColumn* CreateEmpty() const = 0;
+
+        // remove `row' by moving the last element into its place
+        virtual void SwapRemove(size_t row) = 0;
+
+        // append `row' to `dst', which must hold the same component type
+        virtual void MoveRowTo(size_t row, BaseColumn* dst) = 0;
+
+        virtual void Reserve(size_t n) = 0;
+    };
+
+    template<typename T>
+    class Column : public BaseColumn
+    {
+    public:
+        std::vector<T> data;
+
+        BaseColumn* CreateEmpty() const
+        {
+            return new Column<T>();
+        }
+
+        void SwapRemove(size_t row)
+        {
+            if(row + 1 != data.size()) {
+                data[row] = std::move(data.back());
+            }
+            data.pop_back();
+        }
+
+        void MoveRowTo(size_t row, BaseColumn* dst)
+        {
+            static_cast<Column<T>*>(dst)->data.push_back(std::move(data[row]));
+        }
+
+        void Reserve(size_t n)
+        {
+            data.reserve(n);
+        }
+    };
+
+
+    // all entities sharing exactly the same set of components
+    class Archetype
+    {
+    public:
+        mask_t mask;
+        std::vector<Entity> entities;
+        std::vector<unsigned int> ids;
+
+        // indexed by component id, NULL when the component is not present
+        BaseColumn* columns[ECS_MAX_COMPONENTS];
+
+        // cached archetype index reached by adding/removing a component,
+        // -1 until first looked up
+        int add_edge[ECS_MAX_COMPONENTS];
+        int remove_edge[ECS_MAX_COMPONENTS];
+
+        Archetype(mask_t mask) : mask(mask)
+        {
+            for(int i = 0; i < ECS_MAX_COMPONENTS; i++)
+            {
+                columns[i] = NULL;
+                add_edge[i] = -1;
+                remove_edge[i] = -1;
+            }
+        }
+
+        ~Archetype()
+        {
+            for(size_t i = 0; i < ids.size(); i++)
+            {
+                delete columns[ids[i]];
+            }
+        }
+
+        template<typename T>
+        T* Data()
+        {
+            Column<T>* col = static_cast<Column<T>*>(columns[component_id<T>()]);
+            return col->data.empty() ? NULL : &col->data[0];
+        }
+
+        template<typename T>
+        std::vector<T>& Vector()
+        {
+            return static_cast<Column<T>*>(columns[component_id<T>()])->data;
+        }
+    };
+
+
+    class Registry
+    {
+    private:
+        // where an entity lives: archetype index (-1 if the slot is free) and row
+        struct Record
+        {
+            int archetype;
+            uint32_t row;
+            uint32_t generation;
+        };
+
+        std::vector<Record> _records;
+        std::vector<uint32_t> _free;
+
+        std::vector<Archetype*> _archetypes;
+        std::unordered_map<mask_t, int> _archetype_index;
+
+        // nesting depth of running queries, structural changes are
+        // deferred while this is non-zero
+        int _iterating;
+        std::vector<std::function<void(Registry&)> > _deferred;
+
+        int FindOrCreateArchetype(mask_t mask, const Archetype* like)
+        {
+            std::unordered_map<mask_t, int>::iterator it = _archetype_index.find(mask);
+            if(it != _archetype_index.end()) {
+                return it->second;
+            }
+
+            Archetype* arch = new Archetype(mask);
+            for(unsigned int id = 0; id < ECS_MAX_COMPONENTS; id++)
+            {
+                if(mask & (mask_t(1) << id))
+                {
+                    arch->ids.push_back(id);
+                    if(like != NULL && like->columns[id] != NULL) {
+                        arch->columns[id] = like->columns[id]->CreateEmpty();
+                    }
+                }
+            }
+
+            int index = (int)_archetypes.size();
+            _archetypes.push_back(arch);
+            _archetype_index[mask] = index;
+            return index;
+        }
+
+        // remove a row from an archetype, fixing up the record of the
+        // entity that gets swapped into its place
+        void RemoveRow(Archetype* arch, uint32_t row)
+        {
+            for(size_t i = 0; i < arch->ids.size(); i++)
+            {
+                arch->columns[arch->ids[i]]->SwapRemove(row);
+            }
+
+            if(row + 1 != arch->entities.size())
+            {
+                arch->entities[row] = arch->entities.back();
+                _records[arch->entities[row].index].row = row;
+            }
+            arch->entities.pop_back();
+        }
+
+        // move an entity and all components it keeps into archetype `dst'.
+        // Columns in `dst' that the source lacks are left for the caller
+        void MoveEntity(Entity e, int dst_index)
+        {
+            Record& rec = _records[e.index];
+            Archetype* src = _archetypes[rec.archetype];
+            Archetype* dst = _archetypes[dst_index];
+            uint32_t row = rec.row;
+
+            for(size_t i = 0; i < src->ids.size(); i++)
+            {
+                unsigned int id = src->ids[i];
+                if(dst->columns[id] != NULL) {
+                    src->columns[id]->MoveRowTo(row, dst->columns[id]);
+                }
+            }
+            RemoveRow(src, row);
+
+            dst->entities.push_back(e);
+            rec.archetype = dst_index;
+            rec.row = (uint32_t)(dst->entities.size() - 1);
+        }
+
+        template<typename Func, typename... Ptrs>
+        static void RunRows(Func& func, size_t n, const Entity* entities, Ptrs... ptrs)
+        {
+            for(size_t i = 0; i < n; i++)
+            {
+                func(entities[i], ptrs[i]...);
+            }
+        }
+
+    public:
+        Registry() : _iterating(0)
+        {
+            // archetype 0 is the empty archetype, where new entities start
+            FindOrCreateArchetype(0, NULL);
+        }
+
+        ~Registry()
+        {
+            for(size_t i = 0; i < _archetypes.size(); i++)
+            {
+                delete _archetypes[i];
+            }
+        }
+
+        // creating an entity never invalidates a running query, so it is
+        // always immediate, and the handle can be used right away
+        Entity Create()
+        {
+            Entity e;
+            if(!_free.empty())
+            {
+                e.index = _free.back();
+                _free.pop_back();
+                e.generation = _records[e.index].generation;
+            }
+            else
+            {
+                e.index = (uint32_t)_records.size();
+                e.generation = 0;
+                Record rec = { -1, 0, 0 };
+                _records.push_back(rec);
+            }
+
+            Archetype* empty = _archetypes[0];
+            empty->entities.push_back(e);
+            _records[e.index].archetype = 0;
+            _records[e.index].row = (uint32_t)(empty->entities.size() - 1);
+            return e;
+        }
+
+        bool Alive(Entity e) const
+        {
+            return e.index < _records.size()
+                && _records[e.index].archetype >= 0
+                && _records[e.index].generation == e.generation;
+        }
+
+        // return false if the entity was already destroyed
+        bool Destroy(Entity e)
+        {
+            if(!Alive(e)) {
+                return false;
+            }
+            if(_iterating > 0)
+            {
+                _deferred.push_back([e](Registry& reg) { reg.Destroy(e); });
+                return true;
+            }
+
+            Record& rec = _records[e.index];
+            RemoveRow(_archetypes[rec.archetype], rec.row);
+            rec.archetype = -1;
+            rec.generation++;
+            _free.push_back(e.index);
+            return true;
+        }
+
+        // add a component, or overwrite it if the entity already has one.
+        // return false if the entity is not alive
+        template<typename T>
+        bool Add(Entity e, const T& value)
+        {
+            if(!Alive(e)) {
+                return false;
+            }
+
+            unsigned int id = component_id<T>();
+            Archetype* src = _archetypes[_records[e.index].archetype];
+            if(src->columns[id] != NULL)
+            {
+                // overwriting in place is not a structural change
+                src->Vector<T>()[_records[e.index].row] = value;
+                return true;
+            }
+            if(_iterating > 0)
+            {
+                _deferred.push_back([e, value](Registry& reg) { reg.Add<T>(e, value); });
+                return true;
+            }
+
+            int dst_index = src->add_edge[id];
+            if(dst_index < 0)
+            {
+                dst_index = FindOrCreateArchetype(src->mask | (mask_t(1) << id), src);
+                Archetype* dst = _archetypes[dst_index];
+                if(dst->columns[id] == NULL) {
+                    dst->columns[id] = new Column<T>();
+                }
+                src->add_edge[id] = dst_index;
+            }
+
+            MoveEntity(e, dst_index);
+            _archetypes[dst_index]->Vector<T>().push_back(value);
+            return true;
+        }
+
+        // return false if the entity is not alive or lacks the component
+        template<typename T>
+        bool Remove(Entity e)
+        {
+            if(!Alive(e)) {
+                return false;
+            }
+
+            unsigned int id = component_id<T>();
+            Archetype* src = _archetypes[_records[e.index].archetype];
+            if(src->columns[id] == NULL) {
+                return false;
+            }
+            if(_iterating > 0)
+            {
+                _deferred.push_back([e](Registry& reg) { reg.Remove<T>(e); });
+                return true;
+            }
+
+            int dst_index = src->remove_edge[id];
+            if(dst_index < 0)
+            {
+                dst_index = FindOrCreateArchetype(src->mask & ~(mask_t(1) << id), src);
+                src->remove_edge[id] = dst_index;
+            }
+
+            MoveEntity(e, dst_index);
+            return true;
+        }
+
+        // NULL if the entity is not alive or lacks the component.
+        // The pointer is invalidated by the next structural change
+        template<typename T>
+        T* Get(Entity e)
+        {
+            if(!Alive(e)) {
+                return NULL;
+            }
+            Archetype* arch = _archetypes[_records[e.index].archetype];
+            if(arch->columns[component_id<T>()] == NULL) {
+                return NULL;
+            }
+            return &arch->Vector<T>()[_records[e.index].row];
+        }
+
+        template<typename T>
+        bool Has(Entity e)
+        {
+            return Get<T>(e) != NULL;
+        }
+
+        size_t Count() const
+        {
+            return _records.size() - _free.size();
+        }
+
+        size_t ArchetypeCount() const
+        {
+            return _archetypes.size();
+        }
+
+        // call `func(Entity, Ts&...)' for every entity having all of `Ts'
+        template<typename... Ts, typename Func>
+        void Each(Func func)
+        {
+            static_assert(sizeof...(Ts) > 0, "a query needs at least one component");
+            mask_t mask = mask_of<Ts...>::get();
+
+            _iterating++;
+            for(size_t a = 0; a < _archetypes.size(); a++)
+            {
+                Archetype* arch = _archetypes[a];
+                if((arch->mask & mask) != mask || arch->entities.empty()) {
+                    continue;
+                }
+                RunRows(func, arch->entities.size(), &arch->entities[0],
+                        arch->Data<Ts>()...);
+            }
+            _iterating--;
+
+            if(_iterating == 0) {
+                Flush();
+            }
+        }
+
+        // call `func(size_t n, const Entity*, Ts*...)' once per matching
+        // archetype, with the raw columns - for loops the compiler can vectorise
+        template<typename... Ts, typename Func>
+        void EachArray(Func func)
+        {
+            static_assert(sizeof...(Ts) > 0, "a query needs at least one component");
+            mask_t mask = mask_of<Ts...>::get();
+
+            _iterating++;
+            for(size_t a = 0; a < _archetypes.size(); a++)
+            {
+                Archetype* arch = _archetypes[a];
+                if((arch->mask & mask) != mask || arch->entities.empty()) {
+                    continue;
+                }
+                func(arch->entities.size(), &arch->entities[0], arch->Data<Ts>()...);
+            }
+            _iterating--;
+
+            if(_iterating == 0) {
+                Flush();
+            }
+        }
+
+        // apply structural changes recorded during queries. Called
+        // automatically when the outermost query returns
+        void Flush()
+        {
+            // commands may record new commands, so drain until empty
+            while(!_deferred.empty())
+            {
+                std::vector<std::function<void(Registry&)> > commands;
+                commands.swap(_deferred);
+                for(size_t i = 0; i < commands.size(); i++)
+                {
+                    commands[i](*this);
+                }
+            }
+        }
+    };
+
+
+    // SYSTEMS
+
+    // move every entity with a velocity
+    void integrate_velocities(Registry& reg, float dt)
+    {
+        reg.EachArray<Position, Velocity>(
+            [dt](size_t n, const Entity*, Position* pos, Velocity* vel) {
+                for(size_t i = 0; i < n; i++)
+                {
+                    pos[i].value += vel[i].value * dt;
+                }
+            });
+    }
+
+} // namespace ecs
+
+#endif // ECS_HPP
@@ -7,6 +7,14 @@
 
 #include "system.hpp"
 
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+#include <errno.h>
+
 namespace fileIO
 {
     // returns the extension for a target file string
@@ -68,6 +76,18 @@ namespace fileIO
         return filepath;
     }
 
+    // create the directory `path' (not its parents), true when it exists
+    // afterwards
+    bool createDirectory(const char* path)
+    {
+    #if defined(_WIN32)
+        int result = _mkdir(path);
+    #else
+        int result = mkdir(path, 0755);
+    #endif
+        return result == 0 || errno == EEXIST;
+    }
+
     // almost same as above, e.g. usage:
     // getPlatformPath("path1|path2|path3") -> "path1/path2/path3/"
     std::string getPlatformPath(const char* path)
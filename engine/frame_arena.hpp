@@ -0,0 +1,231 @@
+#ifndef FRAME_ARENA_HPP
+#define FRAME_ARENA_HPP
+
+// STANDARD
+#include <stddef.h>
+#include <stdint.h>
+#include <new>
+#include <vector>
+#include <limits>
+
+// Bump allocator for data that lives no longer than a frame, such as the
+// draw lists built by `GameWorld::DrawBlocks'. Allocating moves a pointer
+// through one block of memory, freeing does nothing, and `Reset' at the
+// start of every frame makes the whole block available again.
+//
+// Every thread has an arena of its own, see `Frame'. When the block runs
+// out, allocations fall back to the heap and are freed by the next `Reset',
+// which then also grows the block to the most the frame needed, so the
+// next frames fit again. `Scope' gives back what was allocated within it,
+// for code that may run more than once per frame.
+//
+// Proper usage:
+//
+// while(gameisrunning) {
+//     frame_arena::Frame().Reset();
+//     {
+//         frame_arena::Scope scope;
+//         frame_arena::Vector<int> visible;
+//         ... (fill and use `visible') ...
+//     }
+// }
+namespace frame_arena
+{
+    // initial size of every thread's arena
+    #define FRAME_ARENA_SIZE (1 << 20)
+
+    // enough for any type the arena is used for
+    #define FRAME_ARENA_ALIGNMENT 16
+
+    typedef struct _frame_arena_stats_t {
+        _frame_arena_stats_t() : capacity(0), used(0), high_water(0), overflows(0),
+                                 overflow_bytes(0) {}
+
+        size_t capacity;       // of the block
+        size_t used;           // of the block, since the last `Reset'
+        size_t high_water;     // the most a frame needed, overflow included
+        size_t overflows;      // allocations that went to the heap, in total
+        size_t overflow_bytes; // since the last `Reset'
+    } _frame_arena_stats_t;
+
+    class FrameArena
+    {
+    private:
+        // heap allocation of an overflow, in front of the memory handed out
+        struct Overflow
+        {
+            Overflow* next;
+            size_t bytes;
+        };
+
+        unsigned char* _block;
+        Overflow* _overflows; // most recent first
+        _frame_arena_stats_t _stats;
+
+        static size_t Align(size_t value, size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        // free the overflows allocated after `until'
+        void FreeOverflows(Overflow* until)
+        {
+            while(_overflows != NULL && _overflows != until)
+            {
+                Overflow* next = _overflows->next;
+                _stats.overflow_bytes -= _overflows->bytes;
+                ::operator delete(_overflows);
+                _overflows = next;
+            }
+        }
+
+        FrameArena(const FrameArena&);
+        FrameArena& operator=(const FrameArena&);
+
+    public:
+        // where `Rewind' goes back to
+        typedef struct _mark_t {
+            size_t used;
+            Overflow* overflows;
+        } _mark_t;
+
+        FrameArena(size_t capacity) : _block(NULL), _overflows(NULL)
+        {
+            _stats.capacity = capacity;
+            _block = (unsigned char*)::operator new(capacity);
+        }
+
+        ~FrameArena()
+        {
+            FreeOverflows(NULL);
+            ::operator delete(_block);
+        }
+
+        // `bytes' aligned to `alignment', a power of two up to
+        // FRAME_ARENA_ALIGNMENT
+        void* Allocate(size_t bytes, size_t alignment = FRAME_ARENA_ALIGNMENT)
+        {
+            size_t start = Align(_stats.used, alignment);
+            if(start + bytes <= _stats.capacity)
+            {
+                _stats.used = start + bytes;
+                if(_stats.used + _stats.overflow_bytes > _stats.high_water) {
+                    _stats.high_water = _stats.used + _stats.overflow_bytes;
+                }
+                return _block + start;
+            }
+
+            // full, from the heap until the next `Reset'
+            size_t header = Align(sizeof(Overflow), FRAME_ARENA_ALIGNMENT);
+            Overflow* overflow = (Overflow*)::operator new(header + bytes);
+            overflow->next = _overflows;
+            overflow->bytes = bytes;
+            _overflows = overflow;
+            _stats.overflows++;
+            _stats.overflow_bytes += bytes;
+            if(_stats.used + _stats.overflow_bytes > _stats.high_water) {
+                _stats.high_water = _stats.used + _stats.overflow_bytes;
+            }
+            return (unsigned char*)overflow + header;
+        }
+
+        _mark_t Mark() const
+        {
+            _mark_t mark = { _stats.used, _overflows };
+            return mark;
+        }
+
+        // give back everything allocated since `mark'
+        void Rewind(const _mark_t& mark)
+        {
+            FreeOverflows(mark.overflows);
+            _stats.used = mark.used;
+        }
+
+        // give back everything, at the start of a frame. Grows the block if
+        // the last frames did not fit
+        void Reset()
+        {
+            FreeOverflows(NULL);
+            _stats.used = 0;
+            if(_stats.high_water > _stats.capacity)
+            {
+                ::operator delete(_block);
+                _stats.capacity = Align(_stats.high_water + _stats.high_water / 4,
+                                        FRAME_ARENA_ALIGNMENT);
+                _block = (unsigned char*)::operator new(_stats.capacity);
+            }
+        }
+
+        const _frame_arena_stats_t& Stats() const
+        {
+            return _stats;
+        }
+    };
+
+    // the arena of the calling thread
+    FrameArena& Frame()
+    {
+        static thread_local FrameArena arena(FRAME_ARENA_SIZE);
+        return arena;
+    }
+
+    // gives back the arena memory allocated during its lifetime
+    class Scope
+    {
+    private:
+        FrameArena& _arena;
+        FrameArena::_mark_t _mark;
+
+        Scope(const Scope&);
+        Scope& operator=(const Scope&);
+
+    public:
+        Scope() : _arena(Frame()), _mark(_arena.Mark()) {}
+        ~Scope() { _arena.Rewind(_mark); }
+    };
+
+    // for standard containers, allocating from the calling thread's arena.
+    // The containers must not outlive the frame, or the enclosing `Scope'
+    template<typename T>
+    class Allocator
+    {
+    public:
+        typedef T value_type;
+        typedef T* pointer;
+        typedef const T* const_pointer;
+        typedef T& reference;
+        typedef const T& const_reference;
+        typedef size_t size_type;
+        typedef ptrdiff_t difference_type;
+
+        template<typename U>
+        struct rebind { typedef Allocator<U> other; };
+
+        Allocator() {}
+        template<typename U>
+        Allocator(const Allocator<U>&) {}
+
+        T* allocate(size_t n)
+        {
+            if(n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+                throw std::bad_alloc();
+            }
+            return (T*)Frame().Allocate(n * sizeof(T), alignof(T) < FRAME_ARENA_ALIGNMENT ?
+                                                       alignof(T) : FRAME_ARENA_ALIGNMENT);
+        }
+
+        void deallocate(T*, size_t) {}
+
+        template<typename U>
+        bool operator==(const Allocator<U>&) const { return true; }
+        template<typename U>
+        bool operator!=(const Allocator<U>&) const { return false; }
+    };
+
+    template<typename T>
+    using Vector = std::vector<T, Allocator<T> >;
+
+} // namespace frame_arena
+
+#endif // FRAME_ARENA_HPP
@@ -0,0 +1,176 @@
+#ifndef FRAME_STATS_HPP
+#define FRAME_STATS_HPP
+
+// STANDARD
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+// CUSTOM
+#include "system.hpp"
+#include "profiler.hpp"
+
+// Per-frame measurements of a benchmark run, summarised as percentiles and
+// written as a JSON report, so runs can be compared by scripts.
+//
+// Proper usage:
+//
+// frame_stats::FrameStats stats;
+// stats.AddInfo("renderer", (const char*)glGetString(GL_RENDERER));
+// while(frames < N) {
+//     ... (render one frame) ...
+//     stats.Record(frame_ms, draw_calls, triangles);
+// }
+// stats.AddMetric("gpu_DrawBlocks_ms", gpu.AverageMs("DrawBlocks"));
+// stats.WriteJson("report.json");
+namespace frame_stats
+{
+    class FrameStats
+    {
+    private:
+        std::vector<double> _frame_ms;
+        std::vector<size_t> _draw_calls;
+        std::vector<size_t> _triangles;
+
+        std::vector<std::pair<std::string, std::string> > _info;
+        std::vector<std::pair<std::string, double> > _metrics;
+
+        template<typename T>
+        static double Mean(const std::vector<T>& values)
+        {
+            if(values.empty()) {
+                return 0.0;
+            }
+            double sum = 0.0;
+            for(size_t i = 0; i < values.size(); i++) {
+                sum += values[i];
+            }
+            return sum / values.size();
+        }
+
+        template<typename T>
+        static T Max(const std::vector<T>& values)
+        {
+            return values.empty() ? T() : *std::max_element(values.begin(), values.end());
+        }
+
+    public:
+        // room for `frames' records, so recording does not allocate
+        void Reserve(size_t frames)
+        {
+            _frame_ms.reserve(frames);
+            _draw_calls.reserve(frames);
+            _triangles.reserve(frames);
+        }
+
+        void Record(double frame_ms, size_t draw_calls, size_t triangles)
+        {
+            _frame_ms.push_back(frame_ms);
+            _draw_calls.push_back(draw_calls);
+            _triangles.push_back(triangles);
+        }
+
+        // free-form description of the run, e.g. GL_RENDERER
+        void AddInfo(const std::string& key, const std::string& value)
+        {
+            _info.push_back(std::make_pair(key, value));
+        }
+
+        // any further number worth tracking, e.g. GPU pass timings
+        void AddMetric(const std::string& key, double value)
+        {
+            _metrics.push_back(std::make_pair(key, value));
+        }
+
+        size_t Frames() const
+        {
+            return _frame_ms.size();
+        }
+
+        // frame time at percentile `p' (0 - 100), nearest rank
+        double FramePercentile(double p) const
+        {
+            if(_frame_ms.empty()) {
+                return 0.0;
+            }
+            std::vector<double> sorted(_frame_ms);
+            std::sort(sorted.begin(), sorted.end());
+            size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.5);
+            rank = std::min(std::max(rank, (size_t)1), sorted.size());
+            return sorted[rank - 1];
+        }
+
+        double FrameMean() const
+        {
+            return Mean(_frame_ms);
+        }
+
+        // print a short summary
+        void Report(std::ostream& out) const
+        {
+            out << std::fixed << std::setprecision(3)
+                << Frames() << " frames, "
+                << FrameMean() << " ms mean, "
+                << FramePercentile(50) << " ms p50, "
+                << FramePercentile(99) << " ms p99, "
+                << Max(_frame_ms) << " ms max" << std::endl;
+        }
+
+        // Return false if the file could not be written
+        bool WriteJson(const char* path) const
+        {
+            std::ofstream file(path, std::ios::out);
+            if(!file.is_open())
+            {
+                std::cerr << "Could not write benchmark report '" << path << "'." << std::endl;
+                return false;
+            }
+
+            file << std::fixed << std::setprecision(4);
+            file << "{\n  \"frames\": " << Frames() << ",\n";
+
+            file << "  \"frame_ms\": {"
+                 << "\"mean\": " << FrameMean()
+                 << ", \"p50\": " << FramePercentile(50)
+                 << ", \"p90\": " << FramePercentile(90)
+                 << ", \"p99\": " << FramePercentile(99)
+                 << ", \"max\": " << Max(_frame_ms) << "},\n";
+
+            file << "  \"draw_calls\": {\"mean\": " << Mean(_draw_calls)
+                 << ", \"max\": " << Max(_draw_calls) << "},\n";
+            file << "  \"triangles\": {\"mean\": " << Mean(_triangles)
+                 << ", \"max\": " << Max(_triangles) << "},\n";
+
+            file << "  \"memory\": {\"resident_bytes\": " << System::resident_memory()
+                 << ", \"peak_bytes\": " << System::peak_memory() << "},\n";
+
+            file << "  \"metrics\": {";
+            for(size_t i = 0; i < _metrics.size(); i++)
+            {
+                file << (i ? ", " : "") << "\""
+                     << profiler::json_escape(_metrics[i].first.c_str()) << "\": "
+                     << _metrics[i].second;
+            }
+            file << "},\n";
+
+            file << "  \"info\": {";
+            for(size_t i = 0; i < _info.size(); i++)
+            {
+                file << (i ? ", " : "") << "\""
+                     << profiler::json_escape(_info[i].first.c_str()) << "\": \""
+                     << profiler::json_escape(_info[i].second.c_str()) << "\"";
+            }
+            file << "}\n}\n";
+
+            return true;
+        }
+    };
+
+} // namespace frame_stats
+
+#endif // FRAME_STATS_HPP
@@ -0,0 +1,245 @@
+#ifndef GPU_CULLING_HPP
+#define GPU_CULLING_HPP
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+// STANDARD
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// CUSTOM
+#include "mesh_buffer.hpp"
+#include "stream_buffer.hpp"
+#include "frame_arena.hpp"
+#include "shaders.hpp"
+#include "profiler.hpp"
+
+// Draws the meshes of a MeshBuffer from an indirect buffer, after a compute
+// shader dropped those outside the view frustum.
+//
+// Every mesh becomes a draw command, and its bounding box goes alongside.
+// Both are uploaded through the stream buffer. The compute shader
+// (shaders/cull_sections) copies the commands into an indirect buffer on
+// the GPU, setting the instance count of culled ones to 0. Then one
+// glMultiDrawArraysIndirect per mesh buffer page draws what is left.
+// Compacting the list would need ARB_indirect_parameters to draw a count
+// only the GPU knows, so the culled commands stay as empty draws.
+//
+// Needs OpenGL 4.3 for compute shaders and indirect multi-draws. Without
+// it `Supported' is false, and callers draw the meshes themselves. So do
+// they while the culling shader is still being built, until `Ready'.
+//
+// Proper usage:
+//
+// gpu_culling::GpuCulling culling(&stream);
+// while(gameisrunning) {
+//     culling.SetViewProjection(projection * view);
+//     if(culling.Ready()) {
+//         culling.Draw(meshes, &handles[0], handles.size(), &bounds[0]);
+//     }
+// }
+namespace gpu_culling
+{
+    // invocations per work group, as in the compute shader
+    #define GPU_CULLING_GROUP_SIZE 64
+
+    // as laid out for glMultiDrawArraysIndirect
+    typedef struct _draw_command_t {
+        GLuint count;
+        GLuint instance_count;
+        GLuint first;
+        GLuint base_instance;
+    } _draw_command_t;
+
+    class GpuCulling
+    {
+    private:
+        bool _supported;
+        int _build; // of the program, see `shaders::submitProgram'
+        GLuint _program;
+        GLint _view_projection_loc, _command_count_loc;
+        stream_buffer::StreamBuffer* _stream;
+        GLint _ssbo_alignment;
+
+        // commands after culling, drawn from
+        GLuint _indirect;
+        size_t _indirect_capacity;
+
+        glm::mat4 _view_projection;
+
+        // the next `bytes' of the stream buffer, bound to SSBO `binding'
+        template<typename T>
+        bool Upload(GLuint binding, const T* data, size_t bytes)
+        {
+            size_t offset = 0;
+            void* dst = _stream->Map(bytes, _ssbo_alignment, offset);
+            if(dst == NULL) {
+                return false;
+            }
+            memcpy(dst, data, bytes);
+            _stream->Unmap();
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, _stream->Buffer(),
+                              offset, bytes);
+            return true;
+        }
+
+        // take the program once `_build' is done
+        void Built()
+        {
+            _program = shaders::readyProgram(_build);
+            if(_program == 0)
+            {
+                std::cerr << "Could not build the culling shader, "
+                          << "drawing without GPU culling" << std::endl;
+                _supported = false;
+                return;
+            }
+            _view_projection_loc = glGetUniformLocation(_program, "view_projection");
+            _command_count_loc = glGetUniformLocation(_program, "command_count");
+        }
+
+    public:
+        // needs a current OpenGL context
+        GpuCulling(stream_buffer::StreamBuffer* stream)
+            : _build(-1), _program(0), _stream(stream), _ssbo_alignment(256), _indirect(0),
+              _indirect_capacity(0)
+        {
+            _supported = GLEW_VERSION_4_3 != 0;
+            if(!_supported) {
+                return;
+            }
+
+            _build = shaders::submitShadersC("shaders|cull_sections");
+            glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &_ssbo_alignment);
+            glGenBuffers(1, &_indirect);
+        }
+
+        ~GpuCulling()
+        {
+            if(_program != 0) {
+                glDeleteProgram(_program);
+            }
+            if(_indirect != 0) {
+                glDeleteBuffers(1, &_indirect);
+            }
+        }
+
+        bool Supported() const { return _supported; }
+
+        // whether `Draw' can be called, without waiting for the culling
+        // shader to be built
+        bool Ready()
+        {
+            if(_supported && _program == 0 && shaders::programDone(_build)) {
+                Built();
+            }
+            return _supported && _program != 0;
+        }
+
+        // as `Ready', but waits for the culling shader
+        bool Wait()
+        {
+            if(_supported && _program == 0)
+            {
+                shaders::waitProgram(_build);
+                Built();
+            }
+            return _supported;
+        }
+
+        // of the frame, in the units the bounds are given in
+        void SetViewProjection(const glm::mat4& view_projection)
+        {
+            _view_projection = view_projection;
+        }
+
+        // cull and draw `count' meshes of `handles' as points with the
+        // currently bound shader. `bounds' holds the minimum and maximum
+        // corner of each. Returns the number of draw calls
+        size_t Draw(const mesh_buffer::MeshBuffer& meshes, const int* handles, size_t count,
+                    const glm::vec3* bounds)
+        {
+            PROFILE_SCOPE("GpuCulling::Draw");
+            if(count == 0) {
+                return 0;
+            }
+
+            // commands grouped by page, so each page draws a consecutive run
+            frame_arena::Scope scope;
+            frame_arena::Vector<size_t> page_starts, order;
+            meshes.GroupByPage(handles, count, page_starts, order);
+            frame_arena::Vector<_draw_command_t> commands(count);
+            frame_arena::Vector<glm::vec4> command_bounds(2 * count);
+            for(size_t i = 0; i < count; i++)
+            {
+                size_t h = order[i];
+                const mesh_buffer::_mesh_t& mesh = meshes.Mesh(handles[h]);
+                _draw_command_t command = { (GLuint)mesh.count, 1, (GLuint)mesh.first, 0 };
+                commands[i] = command;
+                command_bounds[2 * i] = glm::vec4(bounds[2 * h], 1.0f);
+                command_bounds[2 * i + 1] = glm::vec4(bounds[2 * h + 1], 1.0f);
+            }
+
+            if(count * sizeof(_draw_command_t) > _indirect_capacity)
+            {
+                _indirect_capacity = std::max(count * sizeof(_draw_command_t),
+                                              2 * _indirect_capacity);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect);
+                glBufferData(GL_DRAW_INDIRECT_BUFFER, _indirect_capacity, NULL, GL_DYNAMIC_DRAW);
+            }
+
+            // cull
+            GLint shader = 0;
+            glGetIntegerv(GL_CURRENT_PROGRAM, &shader);
+            glUseProgram(_program);
+            if(!Upload(0, &command_bounds[0], command_bounds.size() * sizeof(glm::vec4)) ||
+               !Upload(1, &commands[0], count * sizeof(_draw_command_t)))
+            {
+                glUseProgram(shader);
+                return 0;
+            }
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, _indirect, 0,
+                              count * sizeof(_draw_command_t));
+            glUniformMatrix4fv(_view_projection_loc, 1, GL_FALSE,
+                               glm::value_ptr(_view_projection));
+            glUniform1ui(_command_count_loc, (GLuint)count);
+            glDispatchCompute((GLuint)((count + GPU_CULLING_GROUP_SIZE - 1) / GPU_CULLING_GROUP_SIZE),
+                              1, 1);
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+            glUseProgram(shader);
+
+            // draw, a page at a time
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect);
+            size_t calls = 0;
+            for(size_t p = 0; p + 1 < page_starts.size(); p++)
+            {
+                size_t first = page_starts[p], page_count = page_starts[p + 1] - first;
+                if(page_count == 0) {
+                    continue;
+                }
+                glBindVertexArray(meshes.PageVertexArray((int)p));
+                glMultiDrawArraysIndirect(GL_POINTS,
+                                          (const void*)(first * sizeof(_draw_command_t)),
+                                          (GLsizei)page_count, 0);
+                calls++;
+            }
+            glBindVertexArray(0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return calls;
+        }
+    };
+
+} // namespace gpu_culling
+
+#endif // GPU_CULLING_HPP
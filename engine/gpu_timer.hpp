@@ -0,0 +1,252 @@
+#ifndef GPU_TIMER_HPP
+#define GPU_TIMER_HPP
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// STANDARD
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+
+// CUSTOM
+#include "profiler.hpp"
+
+// GPU time spent per render pass, measured with GL_TIME_ELAPSED queries.
+//
+// Each pass owns a small ring of query objects. A result is only read once
+// the driver reports it available, usually a frame or two later, so the CPU
+// never waits for the GPU. If every query of a pass is still in flight, that
+// frame simply goes unmeasured.
+//
+// Time-elapsed queries cannot be nested, so passes must not overlap.
+// Timer queries are core in OpenGL 3.3 and supported by Mesa's llvmpipe.
+//
+// When built with PROFILER_ENABLED the results also show up in the profiler
+// report and trace, on a track of their own, named "gpu <pass>".
+//
+// Proper usage:
+//
+// gpu_timer::GpuTimer gpu;
+// while(gameisrunning) {
+//     gpu.Collect();
+//     {
+//         gpu_timer::Scope pass(gpu, "DrawBlocks");
+//         ... (render calls) ...
+//     }
+// }
+// gpu.Report(std::cout);
+namespace gpu_timer
+{
+    // queries in flight per pass
+    #define GPU_TIMER_QUERIES 4
+
+    // samples in the rolling average
+    #define GPU_TIMER_WINDOW 64
+
+    class GpuTimer
+    {
+    private:
+        struct Pass
+        {
+            std::string name;
+            std::string track_name; // "gpu <name>", for the profiler
+            GLuint queries[GPU_TIMER_QUERIES];
+            bool pending[GPU_TIMER_QUERIES];
+            uint64_t cpu_start[GPU_TIMER_QUERIES];
+            unsigned int next;
+
+            double samples[GPU_TIMER_WINDOW]; // milliseconds
+            unsigned int sample_head;
+            unsigned int sample_count;
+            double last_ms;
+        };
+
+        bool _supported;
+        std::vector<Pass*> _passes;
+        Pass* _running;
+        int _running_slot;
+
+        profiler::ThreadBuffer* _track;
+
+        Pass* Find(const char* name)
+        {
+            for(size_t i = 0; i < _passes.size(); i++) {
+                if(_passes[i]->name == name) {
+                    return _passes[i];
+                }
+            }
+
+            Pass* pass = new Pass();
+            pass->name = name;
+            pass->track_name = std::string("gpu ") + name;
+            glGenQueries(GPU_TIMER_QUERIES, pass->queries);
+            for(int i = 0; i < GPU_TIMER_QUERIES; i++) {
+                pass->pending[i] = false;
+                pass->cpu_start[i] = 0;
+            }
+            pass->next = 0;
+            pass->sample_head = 0;
+            pass->sample_count = 0;
+            pass->last_ms = 0.0;
+            _passes.push_back(pass);
+            return pass;
+        }
+
+    public:
+        // needs a current OpenGL context
+        GpuTimer() : _running(NULL), _running_slot(-1), _track(NULL)
+        {
+            _supported = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+            if(!_supported) {
+                std::cerr << "Timer queries not supported, GPU timings disabled"
+                          << std::endl;
+            }
+        }
+
+        ~GpuTimer()
+        {
+            for(size_t i = 0; i < _passes.size(); i++)
+            {
+                glDeleteQueries(GPU_TIMER_QUERIES, _passes[i]->queries);
+                delete _passes[i];
+            }
+        }
+
+        bool Supported() const { return _supported; }
+
+        // start timing pass `name'. Passes are created on first use
+        void Begin(const char* name)
+        {
+            if(!_supported) {
+                return;
+            }
+            if(_running != NULL)
+            {
+                std::cerr << "GPU pass '" << name << "' started inside '"
+                          << _running->name << "'" << std::endl;
+                return;
+            }
+
+            Pass* pass = Find(name);
+            unsigned int slot = pass->next;
+            if(pass->pending[slot]) {
+                return; // every query still in flight, skip this frame
+            }
+
+            glBeginQuery(GL_TIME_ELAPSED, pass->queries[slot]);
+            pass->cpu_start[slot] = profiler::now_ns();
+            _running = pass;
+            _running_slot = (int)slot;
+        }
+
+        void End()
+        {
+            if(_running == NULL) {
+                return;
+            }
+            glEndQuery(GL_TIME_ELAPSED);
+            _running->pending[_running_slot] = true;
+            _running->next = (_running->next + 1) % GPU_TIMER_QUERIES;
+            _running = NULL;
+            _running_slot = -1;
+        }
+
+        // read every finished query without blocking, call once per frame
+        void Collect()
+        {
+            for(size_t p = 0; p < _passes.size(); p++)
+            {
+                Pass* pass = _passes[p];
+                for(int i = 0; i < GPU_TIMER_QUERIES; i++)
+                {
+                    if(!pass->pending[i]) {
+                        continue;
+                    }
+
+                    GLint available = 0;
+                    glGetQueryObjectiv(pass->queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+                    if(!available) {
+                        continue;
+                    }
+
+                    GLuint64 ns = 0;
+                    glGetQueryObjectui64v(pass->queries[i], GL_QUERY_RESULT, &ns);
+                    pass->pending[i] = false;
+
+                    pass->last_ms = ns / 1e6;
+                    pass->samples[pass->sample_head] = pass->last_ms;
+                    pass->sample_head = (pass->sample_head + 1) % GPU_TIMER_WINDOW;
+                    if(pass->sample_count < GPU_TIMER_WINDOW) {
+                        pass->sample_count++;
+                    }
+
+#ifdef PROFILER_ENABLED
+                    // GPU clocks are not CPU clocks: place the pass where
+                    // the CPU issued it, with the duration the GPU measured
+                    if(_track == NULL) {
+                        _track = profiler::create_track("gpu");
+                    }
+                    _track->Push(pass->track_name.c_str(), pass->cpu_start[i],
+                                 pass->cpu_start[i] + ns);
+#endif
+                }
+            }
+        }
+
+        // rolling average in milliseconds, 0 for unknown passes
+        double AverageMs(const char* name) const
+        {
+            for(size_t i = 0; i < _passes.size(); i++)
+            {
+                const Pass* pass = _passes[i];
+                if(pass->name != name || pass->sample_count == 0) {
+                    continue;
+                }
+                double sum = 0.0;
+                for(unsigned int s = 0; s < pass->sample_count; s++) {
+                    sum += pass->samples[s];
+                }
+                return sum / pass->sample_count;
+            }
+            return 0.0;
+        }
+
+        // print the latest and average GPU time of every pass
+        void Report(std::ostream& out) const
+        {
+            for(size_t i = 0; i < _passes.size(); i++)
+            {
+                const Pass* pass = _passes[i];
+                out << std::left << std::setw(24) << pass->track_name
+                    << std::right << std::fixed << std::setprecision(4)
+                    << std::setw(10) << pass->last_ms << " ms last, "
+                    << AverageMs(pass->name.c_str()) << " ms avg" << std::endl;
+            }
+        }
+    };
+
+    // times the enclosing scope as a GPU pass
+    class Scope
+    {
+    private:
+        GpuTimer& timer;
+    public:
+        Scope(GpuTimer& timer, const char* name) : timer(timer)
+        {
+            timer.Begin(name);
+        }
+        ~Scope()
+        {
+            timer.End();
+        }
+    };
+
+} // namespace gpu_timer
+
+#endif // GPU_TIMER_HPP
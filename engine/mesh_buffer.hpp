@@ -0,0 +1,578 @@
+#ifndef MESH_BUFFER_HPP
+#define MESH_BUFFER_HPP
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// STANDARD
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// CUSTOM
+#include "stream_buffer.hpp"
+#include "frame_arena.hpp"
+#include "profiler.hpp"
+
+// Many small meshes packed into a few large vertex buffers, so drawing all
+// of them takes one VAO bind and one glMultiDrawArrays per buffer instead
+// of a buffer object, a bind and a draw call per mesh.
+//
+// Every buffer ("page") hands out vertex ranges with a RangeAllocator.
+// Vertex data is written to the stream buffer and copied into place on the
+// GPU. Pages whose free space has fallen apart into many small pieces are
+// compacted by `Defragment', which moves their live meshes into earlier
+// pages where they fit, and copies the rest into a new buffer; pages left
+// empty are deleted. Meshes are referred to by handle, so nobody notices
+// them moving. Where they go is worked out without OpenGL, by `PackPage'.
+//
+// Vertices are a vec4 at attribute 0, a position and one value more.
+//
+// Proper usage:
+//
+// mesh_buffer::MeshBuffer meshes(&stream);
+// int mesh = meshes.Allocate(count);
+// GLfloat* vertices = meshes.Map(mesh);
+// ... (write count * 4 floats) ...
+// meshes.Unmap(mesh);
+// while(gameisrunning) {
+//     meshes.Draw(&visible_meshes[0], visible_meshes.size());
+//     meshes.Defragment();
+// }
+// meshes.Free(mesh);
+namespace mesh_buffer
+{
+    // vertices per buffer, larger meshes get a buffer of their own
+    #define MESH_BUFFER_PAGE_VERTICES (1 << 20)
+
+    // pages are compacted once their largest free range is less than this
+    // fraction of their free space...
+    #define MESH_BUFFER_FRAGMENTATION 0.5
+
+    // ...and the free space is at least this fraction of the page
+    #define MESH_BUFFER_MIN_FREE 0.125
+
+    // best-fit allocator of ranges out of `capacity' units (vertices,
+    // bytes, whatever the caller counts in). Free ranges are
+    // kept sorted by offset, to merge neighbours when freeing, and by
+    // size, to find the smallest one large enough in O(log n)
+    class RangeAllocator
+    {
+    private:
+        size_t _capacity;
+        size_t _used;
+        std::map<size_t, size_t> _by_offset;      // offset -> size
+        std::multimap<size_t, size_t> _by_size;   // size -> offset
+
+        void Insert(size_t offset, size_t size)
+        {
+            _by_offset[offset] = size;
+            _by_size.insert(std::make_pair(size, offset));
+        }
+
+        void Erase(size_t offset, size_t size)
+        {
+            _by_offset.erase(offset);
+            std::multimap<size_t, size_t>::iterator it = _by_size.find(size);
+            while(it->second != offset) {
+                ++it;
+            }
+            _by_size.erase(it);
+        }
+
+    public:
+        RangeAllocator(size_t capacity = 0)
+        {
+            Reset(capacity);
+        }
+
+        // forget every allocation
+        void Reset(size_t capacity)
+        {
+            _capacity = capacity;
+            _used = 0;
+            _by_offset.clear();
+            _by_size.clear();
+            if(capacity > 0) {
+                Insert(0, capacity);
+            }
+        }
+
+        // the smallest free range that fits `size' units, returns false
+        // if there is none
+        bool Allocate(size_t size, size_t& offset)
+        {
+            std::multimap<size_t, size_t>::iterator it = _by_size.lower_bound(size);
+            if(size == 0 || it == _by_size.end()) {
+                return false;
+            }
+            size_t free_size = it->first;
+            offset = it->second;
+            Erase(offset, free_size);
+            if(free_size > size) {
+                Insert(offset + size, free_size - size);
+            }
+            _used += size;
+            return true;
+        }
+
+        // give back a range from `Allocate', merging it with free neighbours
+        void Free(size_t offset, size_t size)
+        {
+            _used -= size;
+
+            std::map<size_t, size_t>::iterator next = _by_offset.lower_bound(offset);
+            if(next != _by_offset.end() && offset + size == next->first)
+            {
+                size_t next_size = next->second;
+                Erase(next->first, next_size);
+                size += next_size;
+            }
+
+            std::map<size_t, size_t>::iterator prev = _by_offset.lower_bound(offset);
+            if(prev != _by_offset.begin())
+            {
+                --prev;
+                if(prev->first + prev->second == offset)
+                {
+                    size_t prev_offset = prev->first;
+                    size += prev->second;
+                    Erase(prev_offset, prev->second);
+                    offset = prev_offset;
+                }
+            }
+            Insert(offset, size);
+        }
+
+        size_t Capacity() const { return _capacity; }
+        size_t Used() const { return _used; }
+        size_t Free() const { return _capacity - _used; }
+        size_t FreeRanges() const { return _by_offset.size(); }
+
+        size_t LargestFree() const
+        {
+            return _by_size.empty() ? 0 : _by_size.rbegin()->first;
+        }
+
+        // 0 if all free space is in one piece, approaching 1 the more it
+        // is scattered
+        double Fragmentation() const
+        {
+            return Free() > 0 ? 1.0 - (double)LargestFree() / Free() : 0.0;
+        }
+    };
+
+    // where a mesh lives
+    typedef struct _mesh_t {
+        int page;     // -1 for handles not in use
+        size_t first; // vertex
+        size_t count;
+    } _mesh_t;
+
+    // a mesh moving within its page, from vertex `from' to `to'
+    typedef struct _mesh_move_t {
+        int handle;
+        size_t from;
+        size_t to;
+        size_t count;
+    } _mesh_move_t;
+
+    // whether the free space of a page is scattered enough, and large
+    // enough, for compacting it to pay off
+    inline bool NeedsCompaction(const RangeAllocator& ranges)
+    {
+        return ranges.Fragmentation() > MESH_BUFFER_FRAGMENTATION &&
+               ranges.Free() >= ranges.Capacity() * MESH_BUFFER_MIN_FREE;
+    }
+
+    // pack the meshes of `meshes' on page `page' at its start, in the order
+    // they are in now, leaving the free space of `ranges' in one piece.
+    // Updates the meshes and lists in `moves' what has to be copied where,
+    // in that order, from the old contents of the page to its new ones.
+    // Returns the vertices the meshes take
+    inline size_t PackPage(RangeAllocator& ranges, std::vector<_mesh_t>& meshes, int page,
+                           std::vector<_mesh_move_t>& moves)
+    {
+        moves.clear();
+        for(size_t m = 0; m < meshes.size(); m++)
+        {
+            if(meshes[m].page == page)
+            {
+                _mesh_move_t move = { (int)m, meshes[m].first, 0, meshes[m].count };
+                moves.push_back(move);
+            }
+        }
+        std::sort(moves.begin(), moves.end(), [](const _mesh_move_t& a, const _mesh_move_t& b) {
+            return a.from < b.from;
+        });
+
+        size_t head = 0;
+        for(size_t i = 0; i < moves.size(); i++)
+        {
+            moves[i].to = head;
+            meshes[moves[i].handle].first = head;
+            head += moves[i].count;
+        }
+
+        ranges.Reset(ranges.Capacity());
+        size_t offset;
+        if(head > 0) {
+            ranges.Allocate(head, offset);
+        }
+        return head;
+    }
+
+    typedef struct _mesh_buffer_stats_t {
+        _mesh_buffer_stats_t() : pages(0), meshes(0), capacity(0), used(0), free_ranges(0),
+                                 largest_free(0), fragmentation(0.0), defragmentations(0),
+                                 moved(0), pages_deleted(0) {}
+
+        size_t pages;
+        size_t meshes;
+        size_t capacity;         // vertices in all pages
+        size_t used;
+        size_t free_ranges;
+        size_t largest_free;     // in any page
+        double fragmentation;    // of all pages, weighted by their free space
+        size_t defragmentations; // so far
+        size_t moved;            // vertices copied by them
+        size_t pages_deleted;    // left empty by them, so far
+    } _mesh_buffer_stats_t;
+
+    class MeshBuffer
+    {
+    private:
+        struct Page
+        {
+            GLuint buffer;
+            GLuint vao;
+            RangeAllocator ranges;
+        };
+        std::vector<Page*> _pages;
+        std::vector<_mesh_t> _meshes;
+        std::vector<int> _free_handles;
+        stream_buffer::StreamBuffer* _stream;
+
+        // staging of the mesh being written
+        size_t _staging_offset;
+
+        size_t _defragmentations, _moved, _pages_deleted;
+        std::vector<_mesh_move_t> _moves;
+
+        static const size_t VERTEX_SIZE = 4 * sizeof(GLfloat);
+
+        void CreateBuffer(Page* page, size_t vertices)
+        {
+            glGenBuffers(1, &page->buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, page->buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, vertices * VERTEX_SIZE, NULL, GL_STATIC_DRAW);
+
+            glBindVertexArray(page->vao);
+            glBindBuffer(GL_ARRAY_BUFFER, page->buffer);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, VERTEX_SIZE, (GLvoid*)0);
+            glEnableVertexAttribArray(0);
+            glBindVertexArray(0);
+        }
+
+        int AddPage(size_t vertices)
+        {
+            Page* page = new Page();
+            glGenVertexArrays(1, &page->vao);
+            CreateBuffer(page, vertices);
+            page->ranges.Reset(vertices);
+            _pages.push_back(page);
+            return (int)_pages.size() - 1;
+        }
+
+        // copy the live meshes of page `p' to the start of a new buffer
+        void Compact(int p)
+        {
+            PROFILE_SCOPE("MeshBuffer::Compact");
+            Page* page = _pages[p];
+            size_t head = PackPage(page->ranges, _meshes, p, _moves);
+
+            GLuint old_buffer = page->buffer;
+            CreateBuffer(page, page->ranges.Capacity());
+            glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, page->buffer);
+            for(size_t i = 0; i < _moves.size(); i++)
+            {
+                const _mesh_move_t& move = _moves[i];
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                    move.from * VERTEX_SIZE, move.to * VERTEX_SIZE,
+                                    move.count * VERTEX_SIZE);
+            }
+            glDeleteBuffers(1, &old_buffer);
+            _defragmentations++;
+            _moved += head;
+        }
+
+        // move what meshes of page `p' fit into earlier pages there, best
+        // fit, so that later pages drain. Pages without meshes are left
+        // alone, to be deleted
+        void Evacuate(int p)
+        {
+            PROFILE_SCOPE("MeshBuffer::Evacuate");
+            Page* page = _pages[p];
+            glBindBuffer(GL_COPY_READ_BUFFER, page->buffer);
+            for(size_t m = 0; m < _meshes.size(); m++)
+            {
+                _mesh_t& mesh = _meshes[m];
+                if(mesh.page != p) {
+                    continue;
+                }
+                for(int q = 0; q < p; q++)
+                {
+                    size_t first;
+                    RangeAllocator& ranges = _pages[q]->ranges;
+                    if(ranges.Used() == 0 || !ranges.Allocate(mesh.count, first)) {
+                        continue;
+                    }
+                    glBindBuffer(GL_COPY_WRITE_BUFFER, _pages[q]->buffer);
+                    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                        mesh.first * VERTEX_SIZE, first * VERTEX_SIZE,
+                                        mesh.count * VERTEX_SIZE);
+                    page->ranges.Free(mesh.first, mesh.count);
+                    _moved += mesh.count;
+                    mesh.page = q;
+                    mesh.first = first;
+                    break;
+                }
+            }
+        }
+
+        // delete page `p', which holds no meshes, the pages after it move
+        // down by one
+        void DeletePage(int p)
+        {
+            glDeleteVertexArrays(1, &_pages[p]->vao);
+            glDeleteBuffers(1, &_pages[p]->buffer);
+            delete _pages[p];
+            _pages.erase(_pages.begin() + p);
+            for(size_t m = 0; m < _meshes.size(); m++) {
+                if(_meshes[m].page > p) {
+                    _meshes[m].page--;
+                }
+            }
+            _pages_deleted++;
+        }
+
+    public:
+        // needs a current OpenGL context. Uploads go through `stream'
+        MeshBuffer(stream_buffer::StreamBuffer* stream)
+            : _stream(stream), _staging_offset(0), _defragmentations(0), _moved(0),
+              _pages_deleted(0) {}
+
+        ~MeshBuffer()
+        {
+            for(size_t p = 0; p < _pages.size(); p++)
+            {
+                glDeleteVertexArrays(1, &_pages[p]->vao);
+                glDeleteBuffers(1, &_pages[p]->buffer);
+                delete _pages[p];
+            }
+        }
+
+        // a handle to room for `count' vertices
+        int Allocate(size_t count)
+        {
+            _mesh_t mesh = { -1, 0, count };
+            for(size_t p = 0; p < _pages.size() && mesh.page < 0; p++) {
+                if(_pages[p]->ranges.Allocate(count, mesh.first)) {
+                    mesh.page = (int)p;
+                }
+            }
+            if(mesh.page < 0)
+            {
+                mesh.page = AddPage(std::max((size_t)MESH_BUFFER_PAGE_VERTICES, count));
+                _pages[mesh.page]->ranges.Allocate(count, mesh.first);
+            }
+
+            if(_free_handles.empty())
+            {
+                _meshes.push_back(mesh);
+                return (int)_meshes.size() - 1;
+            }
+            int handle = _free_handles.back();
+            _free_handles.pop_back();
+            _meshes[handle] = mesh;
+            return handle;
+        }
+
+        void Free(int handle)
+        {
+            _mesh_t& mesh = _meshes[handle];
+            _pages[mesh.page]->ranges.Free(mesh.first, mesh.count);
+            mesh.page = -1;
+            _free_handles.push_back(handle);
+        }
+
+        const _mesh_t& Mesh(int handle) const
+        {
+            return _meshes[handle];
+        }
+
+        // room for the vertices of mesh `handle', valid until `Unmap'
+        GLfloat* Map(int handle)
+        {
+            return (GLfloat*)_stream->Map(_meshes[handle].count * VERTEX_SIZE, VERTEX_SIZE,
+                                          _staging_offset);
+        }
+
+        // copy what was written since `Map' into the mesh
+        void Unmap(int handle)
+        {
+            _stream->Unmap();
+            const _mesh_t& mesh = _meshes[handle];
+            glBindBuffer(GL_COPY_READ_BUFFER, _stream->Buffer());
+            glBindBuffer(GL_COPY_WRITE_BUFFER, _pages[mesh.page]->buffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, _staging_offset,
+                                mesh.first * VERTEX_SIZE, mesh.count * VERTEX_SIZE);
+        }
+
+        size_t Pages() const { return _pages.size(); }
+
+        // with the page's buffer as vertex attribute 0
+        GLuint PageVertexArray(int page) const
+        {
+            return _pages[page]->vao;
+        }
+
+        GLuint PageBuffer(int page) const
+        {
+            return _pages[page]->buffer;
+        }
+
+        // the positions in `handles' ordered by page, those of page p from
+        // `page_starts[p]' to `page_starts[p + 1]'. Both live in the frame arena
+        void GroupByPage(const int* handles, size_t count, frame_arena::Vector<size_t>& page_starts,
+                         frame_arena::Vector<size_t>& order) const
+        {
+            page_starts.assign(_pages.size() + 1, 0);
+            for(size_t i = 0; i < count; i++) {
+                page_starts[_meshes[handles[i]].page + 1]++;
+            }
+            for(size_t p = 0; p < _pages.size(); p++) {
+                page_starts[p + 1] += page_starts[p];
+            }
+
+            frame_arena::Vector<size_t> next(page_starts.begin(), page_starts.end() - 1);
+            order.resize(count);
+            for(size_t i = 0; i < count; i++) {
+                order[next[_meshes[handles[i]].page]++] = i;
+            }
+        }
+
+        // draw `count' meshes of `handles' as points, with one
+        // glMultiDrawArrays per page. Returns the number of draw calls
+        size_t Draw(const int* handles, size_t count)
+        {
+            frame_arena::Scope scope;
+            frame_arena::Vector<size_t> page_starts, order;
+            GroupByPage(handles, count, page_starts, order);
+
+            frame_arena::Vector<GLint> firsts(count);
+            frame_arena::Vector<GLsizei> counts(count);
+            for(size_t i = 0; i < count; i++)
+            {
+                const _mesh_t& mesh = _meshes[handles[order[i]]];
+                firsts[i] = (GLint)mesh.first;
+                counts[i] = (GLsizei)mesh.count;
+            }
+
+            size_t calls = 0;
+            for(size_t p = 0; p < _pages.size(); p++)
+            {
+                size_t start = page_starts[p], end = page_starts[p + 1];
+                if(start == end) {
+                    continue;
+                }
+                glBindVertexArray(_pages[p]->vao);
+                glMultiDrawArrays(GL_POINTS, &firsts[start], &counts[start], (GLsizei)(end - start));
+                calls++;
+            }
+            glBindVertexArray(0);
+            return calls;
+        }
+
+        // compact the pages whose free space is too scattered, see
+        // MESH_BUFFER_FRAGMENTATION: their meshes move into earlier pages
+        // where they fit, and the rest to the start of the page. Pages
+        // left empty are deleted, all but the first, while the others keep
+        // MESH_BUFFER_MIN_FREE of their room. Returns the number of pages
+        // compacted
+        int Defragment()
+        {
+            int compacted = 0;
+            for(size_t p = 0; p < _pages.size(); p++)
+            {
+                if(!NeedsCompaction(_pages[p]->ranges)) {
+                    continue;
+                }
+                if(p > 0) {
+                    Evacuate((int)p);
+                }
+                if(_pages[p]->ranges.Used() > 0) {
+                    Compact((int)p);
+                }
+                else {
+                    _defragmentations++;
+                }
+                compacted++;
+            }
+            // e.g. those of meshes too large for a page, once freed. Only
+            // while the other pages have room left, or the next mesh would
+            // make a new one straight away
+            size_t capacity = 0, free = 0;
+            for(size_t p = 0; p < _pages.size(); p++)
+            {
+                capacity += _pages[p]->ranges.Capacity();
+                free += _pages[p]->ranges.Free();
+            }
+            for(size_t p = _pages.size(); p-- > 1;)
+            {
+                const RangeAllocator& ranges = _pages[p]->ranges;
+                if(ranges.Used() == 0 &&
+                   free - ranges.Free() >= (capacity - ranges.Capacity()) * MESH_BUFFER_MIN_FREE)
+                {
+                    capacity -= ranges.Capacity();
+                    free -= ranges.Free();
+                    DeletePage((int)p);
+                }
+            }
+            return compacted;
+        }
+
+        _mesh_buffer_stats_t Stats() const
+        {
+            _mesh_buffer_stats_t stats;
+            stats.pages = _pages.size();
+            stats.meshes = _meshes.size() - _free_handles.size();
+            size_t free = 0;
+            double scattered = 0.0;
+            for(size_t p = 0; p < _pages.size(); p++)
+            {
+                const RangeAllocator& ranges = _pages[p]->ranges;
+                stats.capacity += ranges.Capacity();
+                stats.used += ranges.Used();
+                stats.free_ranges += ranges.FreeRanges();
+                stats.largest_free = std::max(stats.largest_free, ranges.LargestFree());
+                free += ranges.Free();
+                scattered += ranges.Fragmentation() * ranges.Free();
+            }
+            stats.fragmentation = free > 0 ? scattered / free : 0.0;
+            stats.defragmentations = _defragmentations;
+            stats.moved = _moved;
+            stats.pages_deleted = _pages_deleted;
+            return stats;
+        }
+    };
+
+} // namespace mesh_buffer
+
+#endif // MESH_BUFFER_HPP
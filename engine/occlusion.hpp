@@ -0,0 +1,386 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+// GLM
+#include <glm/glm.hpp>
+
+// STANDARD
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Occlusion culling against a software-rasterized depth buffer.
+//
+// Large occluders (boxes known to be completely solid) are rasterized on the
+// CPU into a small depth buffer. A hierarchical-Z pyramid is built from it,
+// every level holding the farthest depth of the 2x2 texels below. A bounding
+// box is hidden when its nearest point lies behind the farthest occluder
+// depth over the screen rectangle it covers, which takes at most 16 texel
+// reads at the right pyramid level.
+//
+// Results are conservative: boxes crossing the near plane, or not fully
+// covered by occluders, are always visible. Occluder triangles are clipped
+// against the near plane, so the ground the camera stands on still counts.
+//
+// Proper usage:
+//
+// occlusion::DepthRasterizer hiz;
+// while(gameisrunning) {
+//     hiz.Begin(projection * view);
+//     ... hiz.RasterizeBox(min, max) for every occluder ...
+//     hiz.BuildPyramid();
+//     ... if(hiz.TestBox(min, max) == occlusion::VISIBLE) draw it ...
+// }
+namespace occlusion
+{
+    // size of the depth buffer, the width must be a multiple of 4
+    #define OCCLUSION_WIDTH  256
+    #define OCCLUSION_HEIGHT 128
+
+    typedef enum {
+        VISIBLE,
+        OUTSIDE_FRUSTUM,
+        OCCLUDED
+    } _visibility_t;
+
+    // counters since the last `Begin'
+    typedef struct _raster_stats_t {
+        _raster_stats_t() : occluders(0), triangles(0), tested(0),
+                            frustum_culled(0), occluded(0) {}
+
+        size_t occluders;
+        size_t triangles;      // rasterized, after clipping and back-face culling
+        size_t tested;
+        size_t frustum_culled;
+        size_t occluded;
+    } _raster_stats_t;
+
+    class DepthRasterizer
+    {
+    private:
+        int _width, _height;
+        glm::mat4 _view_projection;
+
+        // level 0 is the depth buffer itself, depth 0 near, 1 far
+        std::vector<std::vector<float> > _levels;
+        std::vector<int> _level_width, _level_height;
+
+        _raster_stats_t _stats;
+
+        // triangle in screen space: x and y in pixels, z in [0, 1]
+        void RasterizeTriangle(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+        {
+            // counter-clockwise triangles face the camera
+            float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+            if(area <= 0.0f) {
+                return;
+            }
+
+            // pixels whose centres may be covered
+            float fx0 = std::min(a.x, std::min(b.x, c.x));
+            float fx1 = std::max(a.x, std::max(b.x, c.x));
+            float fy0 = std::min(a.y, std::min(b.y, c.y));
+            float fy1 = std::max(a.y, std::max(b.y, c.y));
+            if(fx1 < 0.0f || fy1 < 0.0f || fx0 > _width || fy0 > _height) {
+                return;
+            }
+            int x0 = std::max(0, (int)(fx0 - 0.5f));
+            int x1 = std::min(_width - 1, (int)(fx1 + 0.5f));
+            int y0 = std::max(0, (int)(fy0 - 0.5f));
+            int y1 = std::min(_height - 1, (int)(fy1 + 0.5f));
+            _stats.triangles++;
+
+            // edge functions, e_i >= 0 inside. Edge i is opposite vertex i
+            const glm::vec3* v[3] = { &a, &b, &c };
+            float ea[3], eb[3], ec[3];
+            for(int i = 0; i < 3; i++)
+            {
+                const glm::vec3& p = *v[(i + 1) % 3];
+                const glm::vec3& q = *v[(i + 2) % 3];
+                ea[i] = -(q.y - p.y);
+                eb[i] = q.x - p.x;
+                ec[i] = -(ea[i] * p.x + eb[i] * p.y);
+            }
+
+            // depth is linear in screen space: z = za * x + zb * y + zc
+            float za = (ea[0] * a.z + ea[1] * b.z + ea[2] * c.z) / area;
+            float zb = (eb[0] * a.z + eb[1] * b.z + eb[2] * c.z) / area;
+            float zc = (ec[0] * a.z + ec[1] * b.z + ec[2] * c.z) / area;
+
+            // whole groups of 4 pixels, the buffer width is a multiple of 4
+            x0 &= ~3;
+            std::vector<float>& depth = _levels[0];
+
+            for(int y = y0; y <= y1; y++)
+            {
+                float py = y + 0.5f;
+                float* row = &depth[(size_t)y * _width];
+#ifdef __SSE2__
+                __m128 offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+                __m128 zero = _mm_setzero_ps();
+                __m128 a0 = _mm_set1_ps(ea[0]), a1 = _mm_set1_ps(ea[1]), a2 = _mm_set1_ps(ea[2]);
+                __m128 za4 = _mm_set1_ps(za);
+                __m128 e0r = _mm_set1_ps(eb[0] * py + ec[0]);
+                __m128 e1r = _mm_set1_ps(eb[1] * py + ec[1]);
+                __m128 e2r = _mm_set1_ps(eb[2] * py + ec[2]);
+                __m128 zr = _mm_set1_ps(zb * py + zc);
+                for(int x = x0; x <= x1; x += 4)
+                {
+                    __m128 px = _mm_add_ps(_mm_set1_ps((float)x), offsets);
+                    __m128 e0 = _mm_add_ps(_mm_mul_ps(a0, px), e0r);
+                    __m128 e1 = _mm_add_ps(_mm_mul_ps(a1, px), e1r);
+                    __m128 e2 = _mm_add_ps(_mm_mul_ps(a2, px), e2r);
+                    __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                    _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+                    if(_mm_movemask_ps(inside) == 0) {
+                        continue;
+                    }
+                    __m128 z = _mm_add_ps(_mm_mul_ps(za4, px), zr);
+                    __m128 old = _mm_loadu_ps(row + x);
+                    __m128 nearer = _mm_min_ps(old, z);
+                    _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer),
+                                                    _mm_andnot_ps(inside, old)));
+                }
+#else
+                for(int x = x0; x <= x1; x++)
+                {
+                    float px = x + 0.5f;
+                    if(ea[0] * px + eb[0] * py + ec[0] < 0.0f ||
+                       ea[1] * px + eb[1] * py + ec[1] < 0.0f ||
+                       ea[2] * px + eb[2] * py + ec[2] < 0.0f) {
+                        continue;
+                    }
+                    float z = za * px + zb * py + zc;
+                    if(z < row[x]) {
+                        row[x] = z;
+                    }
+                }
+#endif
+            }
+        }
+
+        // clip against the near plane (z >= -w), then rasterize
+        void ClipAndRasterize(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c)
+        {
+            const glm::vec4* in[3] = { &a, &b, &c };
+            glm::vec4 out[4];
+            int count = 0;
+            for(int i = 0; i < 3; i++)
+            {
+                const glm::vec4& p = *in[i];
+                const glm::vec4& q = *in[(i + 1) % 3];
+                float dp = p.z + p.w;
+                float dq = q.z + q.w;
+                if(dp >= 0.0f) {
+                    out[count++] = p;
+                }
+                if((dp >= 0.0f) != (dq >= 0.0f)) {
+                    out[count++] = p + (q - p) * (dp / (dp - dq));
+                }
+            }
+            if(count < 3) {
+                return;
+            }
+
+            glm::vec3 screen[4];
+            for(int i = 0; i < count; i++)
+            {
+                // points on the near plane itself have w > 0, as near > 0
+                float w = out[i].w;
+                screen[i] = glm::vec3((out[i].x / w * 0.5f + 0.5f) * _width,
+                                      (out[i].y / w * 0.5f + 0.5f) * _height,
+                                      out[i].z / w * 0.5f + 0.5f);
+            }
+            RasterizeTriangle(screen[0], screen[1], screen[2]);
+            if(count == 4) {
+                RasterizeTriangle(screen[0], screen[2], screen[3]);
+            }
+        }
+
+    public:
+        DepthRasterizer(int width = OCCLUSION_WIDTH, int height = OCCLUSION_HEIGHT)
+            : _width((width + 3) & ~3), _height(height)
+        {
+            int w = _width, h = _height;
+            while(true)
+            {
+                _levels.push_back(std::vector<float>((size_t)w * h, 1.0f));
+                _level_width.push_back(w);
+                _level_height.push_back(h);
+                if(w == 1 && h == 1) {
+                    break;
+                }
+                w = std::max(1, (w + 1) / 2);
+                h = std::max(1, (h + 1) / 2);
+            }
+        }
+
+        // start a frame: clear the depth buffer to the far plane
+        void Begin(const glm::mat4& view_projection)
+        {
+            _view_projection = view_projection;
+            std::fill(_levels[0].begin(), _levels[0].end(), 1.0f);
+            _stats = _raster_stats_t();
+        }
+
+        // a completely solid axis-aligned box, in world coordinates
+        void RasterizeBox(const glm::vec3& min, const glm::vec3& max)
+        {
+            // corner i has x from bit 0, y from bit 1, z from bit 2
+            glm::vec4 clip[8];
+            for(int i = 0; i < 8; i++)
+            {
+                glm::vec4 corner((i & 1) ? max.x : min.x,
+                                 (i & 2) ? max.y : min.y,
+                                 (i & 4) ? max.z : min.z, 1.0f);
+                clip[i] = _view_projection * corner;
+            }
+
+            // two counter-clockwise triangles per face, seen from outside
+            static const int faces[6][4] = {
+                { 0, 4, 6, 2 }, // -x
+                { 1, 3, 7, 5 }, // +x
+                { 0, 1, 5, 4 }, // -y
+                { 2, 6, 7, 3 }, // +y
+                { 0, 2, 3, 1 }, // -z
+                { 4, 5, 7, 6 }  // +z
+            };
+            for(int f = 0; f < 6; f++)
+            {
+                const int* q = faces[f];
+                ClipAndRasterize(clip[q[0]], clip[q[1]], clip[q[2]]);
+                ClipAndRasterize(clip[q[0]], clip[q[2]], clip[q[3]]);
+            }
+            _stats.occluders++;
+        }
+
+        // every level keeps the farthest depth of the texels below
+        void BuildPyramid()
+        {
+            for(size_t l = 1; l < _levels.size(); l++)
+            {
+                const std::vector<float>& below = _levels[l - 1];
+                int bw = _level_width[l - 1], bh = _level_height[l - 1];
+                std::vector<float>& level = _levels[l];
+                for(int y = 0; y < _level_height[l]; y++)
+                {
+                    int y0 = 2 * y, y1 = std::min(2 * y + 1, bh - 1);
+                    for(int x = 0; x < _level_width[l]; x++)
+                    {
+                        int x0 = 2 * x, x1 = std::min(2 * x + 1, bw - 1);
+                        level[(size_t)y * _level_width[l] + x] = std::max(
+                            std::max(below[(size_t)y0 * bw + x0], below[(size_t)y0 * bw + x1]),
+                            std::max(below[(size_t)y1 * bw + x0], below[(size_t)y1 * bw + x1]));
+                    }
+                }
+            }
+        }
+
+        // screen rectangle (NDC) and nearest depth of a box. Return
+        // OUTSIDE_FRUSTUM, OCCLUDED if the rectangle is valid, or VISIBLE
+        // if the box crosses the near plane, where the projection is unbounded
+        _visibility_t Project(const glm::vec3& min, const glm::vec3& max,
+                              float& sx0, float& sx1, float& sy0, float& sy1,
+                              float& zmin) const
+        {
+            sx0 = 1e30f; sx1 = -1e30f; sy0 = 1e30f; sy1 = -1e30f; zmin = 1e30f;
+            int behind = 0;
+            for(int i = 0; i < 8; i++)
+            {
+                glm::vec4 corner((i & 1) ? max.x : min.x,
+                                 (i & 2) ? max.y : min.y,
+                                 (i & 4) ? max.z : min.z, 1.0f);
+                glm::vec4 clip = _view_projection * corner;
+                if(clip.z < -clip.w) {
+                    behind++;
+                    continue;
+                }
+                float x = clip.x / clip.w, y = clip.y / clip.w;
+                sx0 = std::min(sx0, x); sx1 = std::max(sx1, x);
+                sy0 = std::min(sy0, y); sy1 = std::max(sy1, y);
+                zmin = std::min(zmin, clip.z / clip.w * 0.5f + 0.5f);
+            }
+
+            if(behind == 8) {
+                return OUTSIDE_FRUSTUM;
+            }
+            if(behind > 0) {
+                return VISIBLE;
+            }
+            if(sx1 < -1.0f || sx0 > 1.0f || sy1 < -1.0f || sy0 > 1.0f || zmin > 1.0f) {
+                return OUTSIDE_FRUSTUM;
+            }
+            return OCCLUDED;
+        }
+
+        // test an axis-aligned box, in world coordinates, after `BuildPyramid'
+        _visibility_t TestBox(const glm::vec3& min, const glm::vec3& max)
+        {
+            _stats.tested++;
+
+            float sx0, sx1, sy0, sy1, zmin;
+            _visibility_t projected = Project(min, max, sx0, sx1, sy0, sy1, zmin);
+            if(projected == OUTSIDE_FRUSTUM) {
+                _stats.frustum_culled++;
+            }
+            if(projected != OCCLUDED) {
+                return projected;
+            }
+
+            // covered pixels, then the finest level at which they span at
+            // most 4x4 texels, coarser levels reach further past the box
+            int x0 = std::max(0, (int)((sx0 * 0.5f + 0.5f) * _width));
+            int x1 = std::min(_width - 1, (int)((sx1 * 0.5f + 0.5f) * _width));
+            int y0 = std::max(0, (int)((sy0 * 0.5f + 0.5f) * _height));
+            int y1 = std::min(_height - 1, (int)((sy1 * 0.5f + 0.5f) * _height));
+
+            size_t l = 0;
+            while(l + 1 < _levels.size() && ((x1 >> l) - (x0 >> l) > 3 || (y1 >> l) - (y0 >> l) > 3)) {
+                l++;
+            }
+
+            const std::vector<float>& level = _levels[l];
+            float farthest = 0.0f;
+            for(int y = y0 >> l; y <= (y1 >> l); y++) {
+                for(int x = x0 >> l; x <= (x1 >> l); x++) {
+                    farthest = std::max(farthest, level[(size_t)y * _level_width[l] + x]);
+                }
+            }
+
+            if(zmin > farthest)
+            {
+                _stats.occluded++;
+                return OCCLUDED;
+            }
+            return VISIBLE;
+        }
+
+        // frustum test only, needs no pyramid and counts nothing
+        bool InFrustum(const glm::vec3& min, const glm::vec3& max) const
+        {
+            float sx0, sx1, sy0, sy1, zmin;
+            return Project(min, max, sx0, sx1, sy0, sy1, zmin) != OUTSIDE_FRUSTUM;
+        }
+
+        const _raster_stats_t& Stats() const
+        {
+            return _stats;
+        }
+
+        int Width() const { return _width; }
+        int Height() const { return _height; }
+
+        // the depth buffer, row 0 at the bottom of the screen
+        const std::vector<float>& Depth() const
+        {
+            return _levels[0];
+        }
+    };
+
+} // namespace occlusion
+
+#endif // OCCLUSION_HPP
@@ -0,0 +1,309 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+// STANDARD
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+// Scoped CPU profiler.
+//
+// `PROFILE_SCOPE("name")' records when the enclosing scope starts and ends,
+// into a ring buffer owned by the calling thread, so recording never takes a
+// lock. The most recent events can be exported as a Chrome `trace_event'
+// JSON file (open it in chrome://tracing or https://ui.perfetto.dev).
+//
+// Everything compiles to nothing unless PROFILER_ENABLED is defined.
+// Names must be string literals, or otherwise outlive the profiler.
+//
+// Proper usage:
+//
+// PROFILE_THREAD("main");
+// while(gameisrunning) {
+//     {
+//         PROFILE_SCOPE("update");
+//         ... (update game logic) ...
+//     }
+// }
+// PROFILE_WRITE_TRACE("trace.json");
+
+// events kept per thread, older ones get overwritten
+#ifndef PROFILER_BUFFER_EVENTS
+#define PROFILER_BUFFER_EVENTS (1 << 16)
+#endif
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+
+#ifdef PROFILER_ENABLED
+    #define PROFILE_SCOPE(name) \
+        profiler::Scope PROFILER_CONCAT(_profile_scope_, __LINE__)(name)
+    #define PROFILE_THREAD(name) profiler::set_thread_name(name)
+    #define PROFILE_WRITE_TRACE(path) profiler::write_chrome_trace(path)
+    #define PROFILE_REPORT(stream) profiler::report(stream)
+#else
+    #define PROFILE_SCOPE(name)
+    #define PROFILE_THREAD(name)
+    #define PROFILE_WRITE_TRACE(path)
+    #define PROFILE_REPORT(stream)
+#endif
+
+namespace profiler
+{
+    typedef struct _event_t {
+        const char* name;
+        uint64_t start; // nanoseconds since the profiler started
+        uint64_t end;
+        uint32_t thread;
+    } _event_t;
+
+    // ring buffer of one thread. Buffers of finished threads are reused
+    // by new ones, the events they hold are kept
+    class ThreadBuffer
+    {
+    public:
+        std::vector<_event_t> events;
+        size_t head;  // next slot to write
+        size_t count; // valid events, at most the capacity
+        uint32_t thread;
+
+        ThreadBuffer() : head(0), count(0), thread(0)
+        {
+            events.resize(PROFILER_BUFFER_EVENTS);
+        }
+
+        void Push(const char* name, uint64_t start, uint64_t end)
+        {
+            _event_t& e = events[head];
+            e.name = name;
+            e.start = start;
+            e.end = end;
+            e.thread = thread;
+            head = (head + 1) % events.size();
+            if(count < events.size()) {
+                count++;
+            }
+        }
+    };
+
+    // shared state, only touched when a thread registers or on export
+    class Registry
+    {
+    public:
+        std::mutex mutex;
+        std::vector<ThreadBuffer*> buffers;
+        std::vector<ThreadBuffer*> idle;
+        std::map<uint32_t, std::string> thread_names;
+        uint32_t next_thread;
+        std::chrono::steady_clock::time_point epoch;
+
+        Registry() : next_thread(1), epoch(std::chrono::steady_clock::now()) {}
+
+        ~Registry()
+        {
+            for(size_t i = 0; i < buffers.size(); i++) {
+                delete buffers[i];
+            }
+        }
+    };
+
+    Registry& registry()
+    {
+        static Registry reg;
+        return reg;
+    }
+
+    inline uint64_t now_ns()
+    {
+        return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - registry().epoch).count();
+    }
+
+    // hands the calling thread its buffer, and gives it back on thread exit
+    class ThreadSlot
+    {
+    public:
+        ThreadBuffer* buffer;
+
+        ThreadSlot()
+        {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            if(!reg.idle.empty())
+            {
+                buffer = reg.idle.back();
+                reg.idle.pop_back();
+            }
+            else
+            {
+                buffer = new ThreadBuffer();
+                reg.buffers.push_back(buffer);
+            }
+            buffer->thread = reg.next_thread++;
+        }
+
+        ~ThreadSlot()
+        {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.idle.push_back(buffer);
+        }
+    };
+
+    inline ThreadBuffer* thread_buffer()
+    {
+        static thread_local ThreadSlot slot;
+        return slot.buffer;
+    }
+
+    // a buffer not tied to any thread, shown as its own track in the trace,
+    // e.g. for GPU timings. Only one thread may push to it
+    ThreadBuffer* create_track(const char* name)
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        ThreadBuffer* buffer = new ThreadBuffer();
+        buffer->thread = reg.next_thread++;
+        reg.buffers.push_back(buffer);
+        reg.thread_names[buffer->thread] = name;
+        return buffer;
+    }
+
+    void set_thread_name(const char* name)
+    {
+        uint32_t thread = thread_buffer()->thread;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.thread_names[thread] = name;
+    }
+
+    // records the lifetime of the enclosing scope
+    class Scope
+    {
+    private:
+        const char* name;
+        uint64_t start;
+    public:
+        Scope(const char* name) : name(name), start(now_ns()) {}
+        ~Scope()
+        {
+            thread_buffer()->Push(name, start, now_ns());
+        }
+    };
+
+    // all buffered events, oldest first per thread. Threads should be idle
+    // while this runs, events recorded meanwhile may be torn
+    std::vector<_event_t> collect_events()
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        std::vector<_event_t> all;
+        for(size_t b = 0; b < reg.buffers.size(); b++)
+        {
+            const ThreadBuffer* buf = reg.buffers[b];
+            size_t capacity = buf->events.size();
+            size_t first = (buf->head + capacity - buf->count) % capacity;
+            for(size_t i = 0; i < buf->count; i++) {
+                all.push_back(buf->events[(first + i) % capacity]);
+            }
+        }
+        return all;
+    }
+
+    std::string json_escape(const char* str)
+    {
+        std::string out;
+        for(const char* p = str; *p != '\0'; p++)
+        {
+            if(*p == '"' || *p == '\\') {
+                out += '\\';
+            }
+            out += *p;
+        }
+        return out;
+    }
+
+    // write the buffered events as Chrome trace_event JSON.
+    // Return false if the file could not be written
+    bool write_chrome_trace(const char* path)
+    {
+        std::ofstream file(path, std::ios::out);
+        if(!file.is_open())
+        {
+            std::cerr << "Could not write profiler trace '" << path << "'." << std::endl;
+            return false;
+        }
+
+        std::vector<_event_t> events = collect_events();
+        std::map<uint32_t, std::string> names;
+        {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            names = reg.thread_names;
+        }
+
+        file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        std::map<uint32_t, std::string>::const_iterator it;
+        for(it = names.begin(); it != names.end(); ++it)
+        {
+            file << (first ? "" : ",") << "\n"
+                 << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                 << it->first << ",\"args\":{\"name\":\""
+                 << json_escape(it->second.c_str()) << "\"}}";
+            first = false;
+        }
+
+        // timestamps are in microseconds, keep the nanoseconds as decimals
+        file << std::fixed << std::setprecision(3);
+        for(size_t i = 0; i < events.size(); i++)
+        {
+            const _event_t& e = events[i];
+            file << (first ? "" : ",") << "\n"
+                 << "{\"name\":\"" << json_escape(e.name)
+                 << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+                 << ",\"ts\":" << e.start / 1000.0
+                 << ",\"dur\":" << (e.end - e.start) / 1000.0 << "}";
+            first = false;
+        }
+        file << "\n]}\n";
+
+        return true;
+    }
+
+    // print count, total and mean duration of every scope name
+    void report(std::ostream& out)
+    {
+        struct Total { size_t count; uint64_t ns; };
+        std::map<std::string, Total> totals;
+
+        std::vector<_event_t> events = collect_events();
+        for(size_t i = 0; i < events.size(); i++)
+        {
+            Total& t = totals[events[i].name];
+            t.count++;
+            t.ns += events[i].end - events[i].start;
+        }
+
+        std::map<std::string, Total>::const_iterator it;
+        for(it = totals.begin(); it != totals.end(); ++it)
+        {
+            out << std::left << std::setw(24) << it->first
+                << std::right << std::setw(10) << it->second.count << " x "
+                << std::fixed << std::setprecision(4)
+                << (it->second.ns / 1e6 / it->second.count) << " ms" << std::endl;
+        }
+    }
+
+} // namespace profiler
+
+#endif // PROFILER_HPP
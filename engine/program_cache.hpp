@@ -0,0 +1,228 @@
+#ifndef PROGRAM_CACHE_HPP
+#define PROGRAM_CACHE_HPP
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// STANDARD
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+// CUSTOM
+#include "fileIO.hpp"
+
+// Linked shader programs kept on disk with glGetProgramBinary, so the next
+// launch loads them with glProgramBinary instead of compiling the sources.
+//
+// Each program has one file in the cache directory, named after its shader
+// directory. It starts with a key hashed from the shader sources and the
+// driver's vendor, renderer and version strings. A key that no longer
+// matches, because a shader or the driver changed, is a miss, and the file
+// is overwritten once the program has been compiled again. So is a binary
+// the driver refuses to link, which drivers may do for any reason.
+//
+// Needs OpenGL 4.1 or ARB_get_program_binary, and a driver that offers at
+// least one binary format. Without them every program is a miss and
+// nothing is written.
+//
+// Proper usage:
+//
+// uint64_t key = program_cache::Key(sources);
+// GLuint program = program_cache::Load("default_block_shader", key);
+// if(program == 0) {
+//     program = glCreateProgram();
+//     program_cache::PrepareProgram(program);
+//     ... (attach the shaders and link) ...
+//     program_cache::Store("default_block_shader", key, program);
+// }
+namespace program_cache
+{
+    // where the binaries go, relative to the working directory
+    #define PROGRAM_CACHE_DIR "shader_cache"
+
+    // starts every cache file, bumped when the layout changes
+    #define PROGRAM_CACHE_MAGIC "PRGBIN01"
+
+    typedef struct _program_cache_stats_t {
+        _program_cache_stats_t() : hits(0), misses(0), rejected(0), stored(0) {}
+
+        size_t hits;     // programs loaded from a binary
+        size_t misses;   // no file, or a different key
+        size_t rejected; // binaries the driver would not link
+        size_t stored;   // binaries written
+    } _program_cache_stats_t;
+
+    typedef struct _program_cache_header_t {
+        char magic[8];
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    } _program_cache_header_t;
+
+    static bool _enabled = true;
+    static _program_cache_stats_t _stats;
+
+    // turns the cache off (or on again), for comparing startup times
+    void SetEnabled(bool enabled) { _enabled = enabled; }
+    bool Enabled() { return _enabled; }
+
+    const _program_cache_stats_t& Stats() { return _stats; }
+
+    // whether the driver can hand out binaries at all, needs a current
+    // OpenGL context
+    bool Supported()
+    {
+        if(!_enabled || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)) {
+            return false;
+        }
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+
+    // FNV-1a, continuing from `hash'
+    uint64_t Hash(const char* data, size_t length, uint64_t hash = 14695981039346656037ULL)
+    {
+        for(size_t i = 0; i < length; i++)
+        {
+            hash ^= (unsigned char)data[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    // of the sources of a program and the driver that compiles them
+    uint64_t Key(const std::vector<std::string>& sources)
+    {
+        uint64_t key = Hash(PROGRAM_CACHE_MAGIC, 8);
+        for(size_t i = 0; i < sources.size(); i++) {
+            // the terminator too, so moving text between stages changes the key
+            key = Hash(sources[i].c_str(), sources[i].size() + 1, key);
+        }
+        const GLenum driver[3] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+        for(int i = 0; i < 3; i++)
+        {
+            const char* str = (const char*)glGetString(driver[i]);
+            if(str != NULL) {
+                key = Hash(str, strlen(str) + 1, key);
+            }
+        }
+        return key;
+    }
+
+    // cache file of the program called `name', e.g. "shaders|cull_sections"
+    std::string FilePath(const char* name)
+    {
+        std::string file;
+        for(const char* ptr = name; *ptr != '\0'; ptr++) {
+            file += (*ptr == '|' || *ptr == '/' || *ptr == '\\') ? '_' : *ptr;
+        }
+        return fileIO::getPlatformPath(PROGRAM_CACHE_DIR) + file + ".bin";
+    }
+
+    // the program built from the cached binary, or 0 when there is none
+    // for `key' or the driver rejects it
+    GLuint Load(const char* name, uint64_t key)
+    {
+        if(!Supported()) {
+            return 0;
+        }
+
+        std::string path = FilePath(name);
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        _program_cache_header_t header;
+        if(!file.is_open() || !file.read((char*)&header, sizeof(header)) ||
+           memcmp(header.magic, PROGRAM_CACHE_MAGIC, 8) != 0 || header.key != key)
+        {
+            _stats.misses++;
+            return 0;
+        }
+        std::vector<char> binary(header.length > 0 ? header.length : 1);
+        if(!file.read(&binary[0], header.length))
+        {
+            _stats.misses++;
+            return 0;
+        }
+        file.close();
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, header.format, &binary[0], header.length);
+        GLint result = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &result);
+        if(!result)
+        {
+            // useless from now on, compile and store again
+            std::cerr << "Cached shader program '" << path
+                      << "' was rejected by the driver" << std::endl;
+            glDeleteProgram(program);
+            remove(path.c_str());
+            _stats.rejected++;
+            return 0;
+        }
+
+        std::cout << "loaded shader program from " << path << std::endl;
+        _stats.hits++;
+        return program;
+    }
+
+    // to call before linking a program that will be stored
+    void PrepareProgram(GLuint program)
+    {
+        if(Supported()) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+    }
+
+    // write the binary of the linked `program' under `key'
+    bool Store(const char* name, uint64_t key, GLuint program)
+    {
+        if(!Supported()) {
+            return false;
+        }
+
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0) {
+            return false;
+        }
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+        std::string path = FilePath(name);
+        if(!fileIO::createDirectory(PROGRAM_CACHE_DIR))
+        {
+            std::cerr << "Could not create the shader cache directory '"
+                      << PROGRAM_CACHE_DIR << "'" << std::endl;
+            return false;
+        }
+        std::ofstream file(path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        _program_cache_header_t header;
+        memcpy(header.magic, PROGRAM_CACHE_MAGIC, 8);
+        header.key = key;
+        header.format = format;
+        header.length = (uint32_t)length;
+        if(!file.is_open() || !file.write((const char*)&header, sizeof(header)) ||
+           !file.write(&binary[0], length))
+        {
+            std::cerr << "Could not write shader cache file '" << path << "'" << std::endl;
+            file.close();
+            remove(path.c_str());
+            return false;
+        }
+
+        _stats.stored++;
+        return true;
+    }
+
+} // namespace program_cache
+
+#endif // PROGRAM_CACHE_HPP
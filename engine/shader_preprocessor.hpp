@@ -0,0 +1,195 @@
+#ifndef SHADER_PREPROCESSOR_HPP
+#define SHADER_PREPROCESSOR_HPP
+
+// STANDARD
+#include <map>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+// Expands shader files before they reach glShaderSource: `#include "file"'
+// lines are replaced by the file, looked up next to the including one, and
+// the defines of a variant are inserted after `#version'. A shader written
+// with `#ifdef' can so be compiled into several variants, each without the
+// branches it does not need, instead of deciding at run time per pixel.
+//
+// Everything else, including `#if' on the variant's defines, is left to
+// the GLSL compiler. Line numbers in compile errors count the expanded
+// source. Needs no OpenGL context.
+//
+// Proper usage:
+//
+// shader_preprocessor::_defines_t defines;
+// defines["TEXTURE_ARRAY"] = "";
+// std::string source, error;
+// if(!shader_preprocessor::Preprocess("shaders/x/fragment.shd", defines, source, error)) {
+//     std::cerr << error << std::endl;
+// }
+namespace shader_preprocessor
+{
+    // nested includes deeper than this are taken for a cycle
+    #define SHADER_INCLUDE_DEPTH 16
+
+    // name and value of each define, sorted so a variant has one name
+    typedef std::map<std::string, std::string> _defines_t;
+
+    // e.g. "FOG,LIGHTS=4", empty without defines
+    std::string VariantName(const _defines_t& defines)
+    {
+        std::string name;
+        for(_defines_t::const_iterator it = defines.begin(); it != defines.end(); ++it)
+        {
+            if(!name.empty()) {
+                name += ',';
+            }
+            name += it->first;
+            if(!it->second.empty()) {
+                name += '=' + it->second;
+            }
+        }
+        return name;
+    }
+
+    // the whole file, false if it cannot be read
+    bool ReadFile(const std::string& path, std::string& content)
+    {
+        std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+        if(!file.is_open()) {
+            return false;
+        }
+        std::ostringstream stream;
+        stream << file.rdbuf();
+        content = stream.str();
+        return true;
+    }
+
+    // the directory of `path', with its trailing separator
+    std::string Directory(const std::string& path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? "" : path.substr(0, separator + 1);
+    }
+
+    // the file name of an `#include "name"' line, false for other lines
+    bool IncludeName(const std::string& line, std::string& name, bool& malformed)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        if(start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+            return false;
+        }
+        size_t open = line.find('"', start + 8);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        malformed = close == std::string::npos || close == open + 1;
+        if(!malformed) {
+            name = line.substr(open + 1, close - open - 1);
+        }
+        return true;
+    }
+
+    // whether `line' is the `#version' directive
+    bool IsVersion(const std::string& line)
+    {
+        size_t start = line.find_first_not_of(" \t");
+        return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+    }
+
+    // append `source', read from `path', to `out' with its includes expanded
+    bool Expand(const std::string& source, const std::string& path, int depth,
+                std::string& out, std::string& error)
+    {
+        if(depth > SHADER_INCLUDE_DEPTH)
+        {
+            error = path + ": includes nested too deeply, or in a cycle";
+            return false;
+        }
+
+        std::istringstream lines(source);
+        std::string line;
+        for(int number = 1; std::getline(lines, line); number++)
+        {
+            std::string name;
+            bool malformed = false;
+            if(!IncludeName(line, name, malformed))
+            {
+                if(depth > 0 && IsVersion(line))
+                {
+                    std::ostringstream message;
+                    message << path << ":" << number << ": #version in an included file";
+                    error = message.str();
+                    return false;
+                }
+                out += line;
+                out += '\n';
+                continue;
+            }
+
+            std::ostringstream location;
+            location << path << ":" << number << ": ";
+            if(malformed)
+            {
+                error = location.str() + "expected #include \"file\"";
+                return false;
+            }
+            std::string included_path = Directory(path) + name;
+            std::string included;
+            if(!ReadFile(included_path, included))
+            {
+                error = location.str() + "could not read included file '" + included_path + "'";
+                return false;
+            }
+            if(!Expand(included, included_path, depth + 1, out, error)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // `source' as read from `path', with its includes expanded and the
+    // defines inserted after `#version', or first without one
+    bool PreprocessSource(const std::string& source, const std::string& path,
+                          const _defines_t& defines, std::string& out, std::string& error)
+    {
+        std::string expanded;
+        if(!Expand(source, path, 0, expanded, error)) {
+            return false;
+        }
+
+        std::string define_lines;
+        for(_defines_t::const_iterator it = defines.begin(); it != defines.end(); ++it) {
+            define_lines += "#define " + it->first + " " + it->second + "\n";
+        }
+
+        // comments and blank lines may come before `#version'
+        size_t insert = 0;
+        std::istringstream lines(expanded);
+        std::string line;
+        for(size_t offset = 0; std::getline(lines, line); offset += line.size() + 1)
+        {
+            if(IsVersion(line))
+            {
+                insert = offset + line.size() + 1;
+                break;
+            }
+        }
+        out = expanded.substr(0, insert) + define_lines + expanded.substr(insert);
+        return true;
+    }
+
+    // the shader file `path' with its includes expanded and the defines
+    // inserted
+    bool Preprocess(const std::string& path, const _defines_t& defines,
+                    std::string& out, std::string& error)
+    {
+        std::string source;
+        if(!ReadFile(path, source))
+        {
+            error = "could not read shader file '" + path + "'";
+            return false;
+        }
+        return PreprocessSource(source, path, defines, out, error);
+    }
+
+} // namespace shader_preprocessor
+
+#endif // SHADER_PREPROCESSOR_HPP
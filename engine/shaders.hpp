@@ -10,19 +10,18 @@
 #include <fstream>
 #include <iostream>
 #include <vector>
+#include <map>
 #include "fileIO.hpp"
+#include "program_cache.hpp"
+#include "shader_preprocessor.hpp"
 
 namespace shaders
 {
-    // load, compile, and return a shader of the specified `type`
-    GLuint loadShader(GLenum type, const char* path)
+    // start compiling a shader of the specified `type` from `source`,
+    // without waiting for the compiler
+    GLuint startShader(GLenum type, const std::string& source)
     {
-        // load shader file
-        std::string shader_str = fileIO::readFileContents(path);
-        const char* shader_src = shader_str.c_str();
-
-        // create shader
-        GLuint shader = glCreateShader(type);
+        const char* shader_src = source.c_str();
 
         // Compile vertex shader
         switch (type)
@@ -37,15 +36,25 @@ namespace shaders
             std::cout << "Compiling fragment shader" << std::endl;
             break;
         case GL_COMPUTE_SHADER:
+            std::cout << "Compiling compute shader" << std::endl;
+            break;
         case GL_TESS_CONTROL_SHADER:
         case GL_TESS_EVALUATION_SHADER:
         default:
             std::cout << "Error: Unrecognized shader type" << std::endl;
             return 0;
         }
+
+        // create shader
+        GLuint shader = glCreateShader(type);
         glShaderSource(shader, 1, &shader_src, NULL);
         glCompileShader(shader);
+        return shader;
+    }
 
+    // whether `shader' compiled, waiting for it if need be
+    bool checkShader(GLuint shader)
+    {
         // check if compilation was successful
         GLint result = GL_FALSE;
         glGetShaderiv(shader, GL_COMPILE_STATUS, &result);
@@ -60,91 +69,292 @@ namespace shaders
 
             std::cout << &shader_err[0] << std::endl;
         }
+        return result != GL_FALSE;
+    }
 
+    // compile and return a shader of the specified `type` from `source`
+    GLuint compileShader(GLenum type, const std::string& source)
+    {
+        GLuint shader = startShader(type, source);
+        if(shader != 0) {
+            checkShader(shader);
+        }
         return shader;
     }
 
-    // create shaders, link them together, return the linked program
-    GLuint loadShadersVGF(const char* path)
+    // load, compile, and return a shader of the specified `type`
+    GLuint loadShader(GLenum type, const char* path)
+    {
+        return compileShader(type, fileIO::readFileContents(path));
+    }
+
+    // a program on its way from the shader files to being linked
+    typedef struct _program_build_t {
+        _program_build_t() : key(0), program(0), done(true) {}
+
+        std::string name; // of its file in the program cache
+        uint64_t key;
+        std::vector<GLuint> stages;
+        GLuint program;   // 0 if it failed
+        bool done;        // linked and checked, or failed
+    } _program_build_t;
+
+    // whether programs are left to the driver's compiler threads, see
+    // `setParallelCompile'
+    static bool _parallel_compile = true;
+
+    // with GL_ARB_parallel_shader_compile the driver compiles and links on
+    // threads of its own, and tells whether it is done without waiting. The
+    // bundled GLEW does not know GL_KHR_parallel_shader_compile, so drivers
+    // with only that one compile the plain way. Turned off, or without the
+    // extension, submitted programs are built before `submitProgram' returns
+    void setParallelCompile(bool enabled) { _parallel_compile = enabled; }
+
+    bool parallelCompile()
+    {
+        return _parallel_compile && GLEW_ARB_parallel_shader_compile;
+    }
+
+    // start building the program of the shader files `files' in the
+    // directory `path', preprocessed with `defines'. Taken from the program
+    // cache when its sources did not change, otherwise compiled and linked
+    // without waiting for either; see `finishProgram'
+    void startProgram(const char* path, const GLenum* types, const char* const* files, int count,
+                      const shader_preprocessor::_defines_t& defines, _program_build_t& build)
     {
+        build = _program_build_t();
+
         std::string shader_dir = fileIO::getPlatformPath(path);
-        std::string vertex (shader_dir + "vertex.shd");
-        std::string geometry (shader_dir + "geometry.shd");
-        std::string fragment (shader_dir + "fragment.shd");
+        std::vector<std::string> sources(count);
+        for(int i = 0; i < count; i++)
+        {
+            std::string error;
+            if(!shader_preprocessor::Preprocess(shader_dir + files[i], defines, sources[i], error))
+            {
+                std::cerr << error << std::endl;
+                return;
+            }
+        }
+
+        // one cache file per variant
+        build.name = path;
+        std::string variant = shader_preprocessor::VariantName(defines);
+        if(!variant.empty()) {
+            build.name += "@" + variant;
+        }
+        build.key = program_cache::Key(sources);
+        build.program = program_cache::Load(build.name.c_str(), build.key);
+        if(build.program != 0) {
+            return;
+        }
 
         // retrieve all shaders
-        GLuint shd_vertex = loadShader(GL_VERTEX_SHADER, vertex.c_str());
-        GLuint shd_geometry = loadShader(GL_GEOMETRY_SHADER, geometry.c_str());
-        GLuint shd_fragment = loadShader(GL_FRAGMENT_SHADER, fragment.c_str());
+        build.stages.resize(count);
+        for(int i = 0; i < count; i++) {
+            build.stages[i] = startShader(types[i], sources[i]);
+        }
 
         // link the shaders together
         std::cout << "linking shader program" << std::endl;
-        GLuint program = glCreateProgram();
-        glAttachShader(program, shd_vertex);
-        glAttachShader(program, shd_geometry);
-        glAttachShader(program, shd_fragment);
-        glLinkProgram(program);
+        build.program = glCreateProgram();
+        program_cache::PrepareProgram(build.program);
+        for(int i = 0; i < count; i++) {
+            glAttachShader(build.program, build.stages[i]);
+        }
+        glLinkProgram(build.program);
+        build.done = false;
+    }
+
+    // whether the driver is done with `build', without waiting for it
+    bool programCompleted(const _program_build_t& build)
+    {
+        if(build.done || !parallelCompile()) {
+            return true;
+        }
+        GLint completed = GL_FALSE;
+        glGetProgramiv(build.program, GL_COMPLETION_STATUS_ARB, &completed);
+        return completed != GL_FALSE;
+    }
+
+    // wait for `build' to be linked, print what went wrong, and store the
+    // program in the cache
+    void finishProgram(_program_build_t& build)
+    {
+        if(build.done) {
+            return;
+        }
+        build.done = true;
 
         // check if linking was successful
         GLint result = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &result);
+        glGetProgramiv(build.program, GL_LINK_STATUS, &result);
 
         // if linking did not succeed, print the error message
         if(!result)
         {
+            for(size_t i = 0; i < build.stages.size(); i++) {
+                checkShader(build.stages[i]);
+            }
             int logLength;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+            glGetProgramiv(build.program, GL_INFO_LOG_LENGTH, &logLength);
             std::vector<GLchar> programError( (logLength > 1) ? logLength : 1 );
-            glGetProgramInfoLog(program, logLength, NULL, &programError[0]);
+            glGetProgramInfoLog(build.program, logLength, NULL, &programError[0]);
             std::cout << &programError[0] << std::endl;
+            glDeleteProgram(build.program);
+            build.program = 0;
+        }
+        else {
+            program_cache::Store(build.name.c_str(), build.key, build.program);
         }
 
         // perform cleanup
-        glDeleteShader(shd_vertex);
-        glDeleteShader(shd_geometry);
-        glDeleteShader(shd_fragment);
+        for(size_t i = 0; i < build.stages.size(); i++) {
+            glDeleteShader(build.stages[i]);
+        }
+        build.stages.clear();
+    }
+
+    // the program of the shader files `files' in the directory `path',
+    // preprocessed with `defines', taken from the program cache when its
+    // sources did not change, or compiled, linked and stored there. 0 if
+    // a file could not be preprocessed or linking failed
+    GLuint loadProgram(const char* path, const GLenum* types, const char* const* files, int count,
+                       const shader_preprocessor::_defines_t& defines = shader_preprocessor::_defines_t())
+    {
+        _program_build_t build;
+        startProgram(path, types, files, count, defines, build);
+        finishProgram(build);
+        return build.program;
+    }
 
-        return program;
+    // create shaders, link them together, return the linked program
+    GLuint loadShadersVGF(const char* path)
+    {
+        const GLenum types[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+        const char* files[3] = { "vertex.shd", "geometry.shd", "fragment.shd" };
+        return loadProgram(path, types, files, 3);
     }
 
     // attach a vertex and a fragment shader, and link them together in a program
     GLuint loadShadersVF(const char* path)
     {
-        // retrieve file paths
-        std::string shader_dir = fileIO::getPlatformPath(path);
-        std::string vertex (shader_dir + "vertex.shd");
-        std::string fragment (shader_dir + "fragment.shd");
+        const GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+        const char* files[2] = { "vertex.shd", "fragment.shd" };
+        return loadProgram(path, types, files, 2);
+    }
 
-        // retrieve all shaders
-        GLuint shd_vertex = loadShader(GL_VERTEX_SHADER, vertex.c_str());
-        GLuint shd_fragment = loadShader(GL_FRAGMENT_SHADER, fragment.c_str());
+    // compile a compute shader into a program of its own, needs OpenGL 4.3
+    GLuint loadShadersC(const char* path)
+    {
+        const GLenum types[1] = { GL_COMPUTE_SHADER };
+        const char* files[1] = { "compute.shd" };
+        return loadProgram(path, types, files, 1);
+    }
 
-        // link the shaders together
-        std::cout << "linking shader program" << std::endl;
-        GLuint program = glCreateProgram();
-        glAttachShader(program, shd_vertex);
-        glAttachShader(program, shd_fragment);
-        glLinkProgram(program);
+    // programs submitted to be built in the background, by handle
+    static std::vector<_program_build_t> _builds;
 
-        // check if linking was successful
-        GLint result = GL_FALSE;
-        glGetProgramiv(program, GL_LINK_STATUS, &result);
-
-        // if linking did not succeed, print the error message
-        if(!result)
+    // start building a program and return its handle for `readyProgram'.
+    // All programs should be submitted up front, so the driver can work on
+    // them at once while the rest of the game loads
+    int submitProgram(const char* path, const GLenum* types, const char* const* files, int count,
+                      const shader_preprocessor::_defines_t& defines = shader_preprocessor::_defines_t())
+    {
+        static bool threads_set = false;
+        if(parallelCompile() && !threads_set)
         {
-            int logLength;
-            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-            std::vector<GLchar> programError( (logLength > 1) ? logLength : 1 );
-            glGetProgramInfoLog(program, logLength, NULL, &programError[0]);
-            std::cout << &programError[0] << std::endl;
+            // as many as the driver likes
+            glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+            threads_set = true;
         }
 
-        // perform cleanup
-        glDeleteShader(shd_vertex);
-        glDeleteShader(shd_fragment);
+        _builds.push_back(_program_build_t());
+        startProgram(path, types, files, count, defines, _builds.back());
+        if(!parallelCompile()) {
+            finishProgram(_builds.back());
+        }
+        return (int)_builds.size() - 1;
+    }
+
+    // as `loadShadersVGF', in the background
+    int submitShadersVGF(const char* path,
+                         const shader_preprocessor::_defines_t& defines = shader_preprocessor::_defines_t())
+    {
+        const GLenum types[3] = { GL_VERTEX_SHADER, GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER };
+        const char* files[3] = { "vertex.shd", "geometry.shd", "fragment.shd" };
+        return submitProgram(path, types, files, 3, defines);
+    }
+
+    // as `loadShadersC', in the background
+    int submitShadersC(const char* path)
+    {
+        const GLenum types[1] = { GL_COMPUTE_SHADER };
+        const char* files[1] = { "compute.shd" };
+        return submitProgram(path, types, files, 1);
+    }
 
-        return program;
+    // whether the program of `handle' is built, or failed to, without
+    // waiting for the driver
+    bool programDone(int handle)
+    {
+        _program_build_t& build = _builds[handle];
+        if(!build.done && programCompleted(build)) {
+            finishProgram(build);
+        }
+        return build.done;
+    }
+
+    // the program of `handle', 0 while it is being built or if it failed
+    GLuint readyProgram(int handle)
+    {
+        return programDone(handle) ? _builds[handle].program : 0;
+    }
+
+    // the program of `handle', waiting for it to be built. 0 if it failed
+    GLuint waitProgram(int handle)
+    {
+        finishProgram(_builds[handle]);
+        return _builds[handle].program;
+    }
+
+    // handles of the programs of `submitVariantVGF', by directory and
+    // variant name
+    static std::map<std::string, int> _variants;
+
+    // as `submitShadersVGF', but each variant is submitted once and kept
+    // until `deleteVariants'
+    int submitVariantVGF(const char* path, const shader_preprocessor::_defines_t& defines)
+    {
+        std::string name = std::string(path) + "@" + shader_preprocessor::VariantName(defines);
+        std::map<std::string, int>::iterator it = _variants.find(name);
+        if(it != _variants.end()) {
+            return it->second;
+        }
+        int handle = submitShadersVGF(path, defines);
+        _variants[name] = handle;
+        return handle;
+    }
+
+    // the program of `loadShadersVGF' compiled with `defines', each variant
+    // built once and kept until `deleteVariants'
+    GLuint loadVariantVGF(const char* path, const shader_preprocessor::_defines_t& defines)
+    {
+        return waitProgram(submitVariantVGF(path, defines));
+    }
+
+    // delete every program of `submitVariantVGF'
+    void deleteVariants()
+    {
+        for(std::map<std::string, int>::iterator it = _variants.begin(); it != _variants.end(); ++it)
+        {
+            _program_build_t& build = _builds[it->second];
+            finishProgram(build);
+            if(build.program != 0) {
+                glDeleteProgram(build.program);
+                build.program = 0;
+            }
+        }
+        _variants.clear();
     }
 
     // get location for a uniform variable for a given shader program
@@ -0,0 +1,294 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+// STANDARD
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+// Objects of one size, handed out from slabs of SLAB_POOL_SLAB_SIZE bytes
+// that are mapped from the OS directly, so allocating and freeing the same
+// kind of buffer again and again leaves no holes in the heap.
+//
+// `Allocate' and `Free' take constant time: freed objects are linked
+// through their first bytes, and a slab is found from any of its objects by
+// rounding the address down, as slabs are aligned to their size. Objects
+// come from partly used slabs first, so that the others can run empty;
+// `Trim' gives empty slabs back to the OS. Asked to, the slabs are mapped
+// as huge pages where the OS supports that (Linux' transparent huge
+// pages), which saves TLB misses when the objects are scanned a lot.
+//
+// Not thread safe. Objects are not initialised.
+//
+// Proper usage:
+//
+// slab_pool::SlabPool pool(sizeof(_chunk_t), true);
+// _chunk_t* chunk = (_chunk_t*)pool.Allocate();
+// ...
+// pool.Free(chunk);
+// pool.Trim(1);
+namespace slab_pool
+{
+    // one huge page on x86-64, a power of two
+    #define SLAB_POOL_SLAB_SIZE (2 << 20)
+
+    // of every object
+    #define SLAB_POOL_ALIGNMENT 16
+
+    typedef struct _slab_pool_stats_t {
+        _slab_pool_stats_t() : object_size(0), objects_per_slab(0), slabs(0), empty_slabs(0),
+                               used(0), peak(0), released(0) {}
+
+        size_t object_size;      // rounded up to the alignment
+        size_t objects_per_slab;
+        size_t slabs;            // mapped right now
+        size_t empty_slabs;      // mapped, but without objects
+        size_t used;             // objects allocated
+        size_t peak;             // the most objects allocated at once
+        size_t released;         // slabs given back to the OS, in total
+
+        // share of the mapped objects in use, 0 - 1
+        double Occupancy() const
+        {
+            size_t capacity = slabs * objects_per_slab;
+            return capacity == 0 ? 0.0 : (double)used / capacity;
+        }
+
+        size_t MappedBytes() const
+        {
+            return slabs * (size_t)SLAB_POOL_SLAB_SIZE;
+        }
+    } _slab_pool_stats_t;
+
+    class SlabPool
+    {
+    private:
+        // at the start of every slab, the objects follow
+        struct Slab
+        {
+            Slab* prev;      // in the list of partly used or empty slabs
+            Slab* next;
+            void* free;      // freed objects, linked through their first bytes
+            size_t used;     // objects handed out
+            size_t untouched; // objects from here on were never handed out
+        };
+
+        size_t _offset; // of the first object in a slab
+        bool _huge_pages;
+
+        Slab* _partial; // some objects free, the ones to allocate from
+        Slab* _empty;   // no objects in use, for `Trim'
+        std::vector<Slab*> _slabs;
+
+        _slab_pool_stats_t _stats;
+
+        static size_t Align(size_t value)
+        {
+            return (value + SLAB_POOL_ALIGNMENT - 1) / SLAB_POOL_ALIGNMENT * SLAB_POOL_ALIGNMENT;
+        }
+
+        static void Link(Slab*& list, Slab* slab)
+        {
+            slab->prev = NULL;
+            slab->next = list;
+            if(list != NULL) {
+                list->prev = slab;
+            }
+            list = slab;
+        }
+
+        static void Unlink(Slab*& list, Slab* slab)
+        {
+            if(slab->prev != NULL) {
+                slab->prev->next = slab->next;
+            }
+            else {
+                list = slab->next;
+            }
+            if(slab->next != NULL) {
+                slab->next->prev = slab->prev;
+            }
+        }
+
+        // SLAB_POOL_SLAB_SIZE bytes aligned to their size, NULL on failure
+        void* Map()
+        {
+            size_t size = SLAB_POOL_SLAB_SIZE;
+        #if defined(_WIN32)
+            return _aligned_malloc(size, size);
+        #else
+            // twice the size, then cut off what is not aligned
+            void* mapping = mmap(NULL, 2 * size, PROT_READ | PROT_WRITE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(mapping == MAP_FAILED) {
+                return NULL;
+            }
+            uintptr_t start = (uintptr_t)mapping;
+            uintptr_t aligned = (start + size - 1) & ~(uintptr_t)(size - 1);
+            if(aligned > start) {
+                munmap(mapping, aligned - start);
+            }
+            if(aligned + size < start + 2 * size) {
+                munmap((void*)(aligned + size), start + 2 * size - aligned - size);
+            }
+        #ifdef MADV_HUGEPAGE
+            if(_huge_pages) {
+                madvise((void*)aligned, size, MADV_HUGEPAGE);
+            }
+        #endif
+            return (void*)aligned;
+        #endif
+        }
+
+        void Unmap(void* slab)
+        {
+        #if defined(_WIN32)
+            _aligned_free(slab);
+        #else
+            munmap(slab, SLAB_POOL_SLAB_SIZE);
+        #endif
+        }
+
+        Slab* AddSlab()
+        {
+            Slab* slab = (Slab*)Map();
+            if(slab == NULL)
+            {
+                std::cerr << "Could not map a slab of " << SLAB_POOL_SLAB_SIZE
+                          << " bytes" << std::endl;
+                return NULL;
+            }
+            slab->free = NULL;
+            slab->used = 0;
+            slab->untouched = 0;
+            Link(_empty, slab);
+            _slabs.push_back(slab);
+            _stats.slabs++;
+            _stats.empty_slabs++;
+            return slab;
+        }
+
+        SlabPool(const SlabPool&);
+        SlabPool& operator=(const SlabPool&);
+
+    public:
+        // for objects of `object_size' bytes, at most a slab minus its header
+        SlabPool(size_t object_size, bool huge_pages = false)
+            : _offset(Align(sizeof(Slab))), _huge_pages(huge_pages), _partial(NULL), _empty(NULL)
+        {
+            _stats.object_size = Align(std::max(object_size, sizeof(void*)));
+            if(_stats.object_size > SLAB_POOL_SLAB_SIZE - _offset)
+            {
+                std::cerr << "Objects of " << object_size << " bytes do not fit into a slab"
+                          << std::endl;
+                return;
+            }
+            _stats.objects_per_slab = (SLAB_POOL_SLAB_SIZE - _offset) / _stats.object_size;
+        }
+
+        ~SlabPool()
+        {
+            for(size_t i = 0; i < _slabs.size(); i++) {
+                Unmap(_slabs[i]);
+            }
+        }
+
+        // an object, NULL if no slab could be mapped
+        void* Allocate()
+        {
+            Slab* slab = _partial != NULL ? _partial : _empty;
+            if(slab == NULL && _stats.objects_per_slab > 0) {
+                slab = AddSlab();
+            }
+            if(slab == NULL) {
+                return NULL;
+            }
+
+            void* object;
+            if(slab->free != NULL)
+            {
+                object = slab->free;
+                slab->free = *(void**)object;
+            }
+            else {
+                object = (unsigned char*)slab + _offset + slab->untouched++ * _stats.object_size;
+            }
+
+            if(slab->used++ == 0)
+            {
+                Unlink(_empty, slab);
+                _stats.empty_slabs--;
+                if(_stats.objects_per_slab > 1) {
+                    Link(_partial, slab);
+                }
+            }
+            else if(slab->used == _stats.objects_per_slab) {
+                Unlink(_partial, slab);
+            }
+
+            _stats.used++;
+            _stats.peak = std::max(_stats.peak, _stats.used);
+            return object;
+        }
+
+        // give back an object of this pool, NULL is ignored
+        void Free(void* object)
+        {
+            if(object == NULL) {
+                return;
+            }
+            Slab* slab = (Slab*)((uintptr_t)object & ~(uintptr_t)(SLAB_POOL_SLAB_SIZE - 1));
+            *(void**)object = slab->free;
+            slab->free = object;
+
+            if(slab->used-- == _stats.objects_per_slab && _stats.objects_per_slab > 1) {
+                Link(_partial, slab);
+            }
+            if(slab->used == 0)
+            {
+                if(_stats.objects_per_slab > 1) {
+                    Unlink(_partial, slab);
+                }
+                Link(_empty, slab);
+                _stats.empty_slabs++;
+            }
+            _stats.used--;
+        }
+
+        // give empty slabs back to the OS, all but `keep' of them. Returns
+        // the number given back
+        size_t Trim(size_t keep = 0)
+        {
+            size_t released = 0;
+            while(_stats.empty_slabs > keep)
+            {
+                Slab* slab = _empty;
+                Unlink(_empty, slab);
+                _slabs.erase(std::find(_slabs.begin(), _slabs.end(), slab));
+                Unmap(slab);
+                _stats.slabs--;
+                _stats.empty_slabs--;
+                released++;
+            }
+            _stats.released += released;
+            return released;
+        }
+
+        const _slab_pool_stats_t& Stats() const
+        {
+            return _stats;
+        }
+    };
+
+} // namespace slab_pool
+
+#endif // SLAB_POOL_HPP
@@ -0,0 +1,340 @@
+#ifndef SPATIAL_HASH_HPP
+#define SPATIAL_HASH_HPP
+
+// GLM
+#include <glm/glm.hpp>
+
+// STANDARD
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// Uniform grid spatial hash for proximity queries between entities.
+//
+// Space is divided into cubic cells of `cell_size' world units, and every
+// cell is hashed into one of a fixed number of buckets. Items are identified
+// by a small integer id (e.g. `ecs::Entity::index'), and remember which
+// bucket and slot they occupy, so insert/move/remove are all O(1).
+//
+// Proper usage:
+//
+// spatial::SpatialHash grid(block_size * 4.0f);
+// grid.Insert(id, position);
+// grid.Move(id, new_position);
+// grid.QueryRadius(center, radius, results);
+//
+// or, once per tick for everything that moves:
+//
+// grid.Rebuild(&positions[0], positions.size());
+namespace spatial
+{
+    class SpatialHash
+    {
+    private:
+        struct Item
+        {
+            glm::vec3 pos;
+            glm::ivec3 cell;
+            uint32_t bucket;
+            uint32_t slot;
+            bool used;
+        };
+
+        float _cell_size;
+        float _inv_cell_size;
+        uint32_t _bucket_mask;
+
+        std::vector<std::vector<uint32_t> > _buckets;
+        std::vector<Item> _items;
+        size_t _count;
+
+        // item ids sorted by `Rebuild' into a list per hashing thread and
+        // bucket range, kept to reuse their storage
+        std::vector<std::vector<uint32_t> > _scattered;
+
+        glm::ivec3 CellOf(const glm::vec3& pos) const
+        {
+            return glm::ivec3((int)std::floor(pos.x * _inv_cell_size),
+                              (int)std::floor(pos.y * _inv_cell_size),
+                              (int)std::floor(pos.z * _inv_cell_size));
+        }
+
+        uint32_t BucketOf(const glm::ivec3& cell) const
+        {
+            // large primes from Teschner et al., "Optimized Spatial
+            // Hashing for Collision Detection of Deformable Objects"
+            uint32_t h = ((uint32_t)cell.x * 73856093u)
+                       ^ ((uint32_t)cell.y * 19349663u)
+                       ^ ((uint32_t)cell.z * 83492791u);
+            return h & _bucket_mask;
+        }
+
+        void Link(uint32_t id)
+        {
+            Item& item = _items[id];
+            std::vector<uint32_t>& bucket = _buckets[item.bucket];
+            item.slot = (uint32_t)bucket.size();
+            bucket.push_back(id);
+        }
+
+        void Unlink(uint32_t id)
+        {
+            Item& item = _items[id];
+            std::vector<uint32_t>& bucket = _buckets[item.bucket];
+            uint32_t last = bucket.back();
+            bucket[item.slot] = last;
+            _items[last].slot = item.slot;
+            bucket.pop_back();
+        }
+
+    public:
+        // `bucket_count' is rounded up to a power of two
+        SpatialHash(float cell_size, uint32_t bucket_count = 1 << 16)
+            : _cell_size(cell_size), _inv_cell_size(1.0f / cell_size), _count(0)
+        {
+            uint32_t n = 1;
+            while(n < bucket_count) {
+                n <<= 1;
+            }
+            _bucket_mask = n - 1;
+            _buckets.resize(n);
+        }
+
+        float CellSize() const { return _cell_size; }
+        size_t Count() const { return _count; }
+
+        bool Contains(uint32_t id) const
+        {
+            return id < _items.size() && _items[id].used;
+        }
+
+        // return false if the id is already present
+        bool Insert(uint32_t id, const glm::vec3& pos)
+        {
+            if(id >= _items.size())
+            {
+                Item empty = { glm::vec3(0.0f), glm::ivec3(0), 0, 0, false };
+                _items.resize(id + 1, empty);
+            }
+            if(_items[id].used) {
+                return false;
+            }
+
+            Item& item = _items[id];
+            item.pos = pos;
+            item.cell = CellOf(pos);
+            item.bucket = BucketOf(item.cell);
+            item.used = true;
+            Link(id);
+            _count++;
+            return true;
+        }
+
+        // return false if the id is not present
+        bool Move(uint32_t id, const glm::vec3& pos)
+        {
+            if(!Contains(id)) {
+                return false;
+            }
+
+            Item& item = _items[id];
+            item.pos = pos;
+            glm::ivec3 cell = CellOf(pos);
+            if(cell == item.cell) {
+                return true;
+            }
+
+            uint32_t bucket = BucketOf(cell);
+            item.cell = cell;
+            if(bucket != item.bucket)
+            {
+                Unlink(id);
+                _items[id].bucket = bucket;
+                Link(id);
+            }
+            return true;
+        }
+
+        // return false if the id is not present
+        bool Remove(uint32_t id)
+        {
+            if(!Contains(id)) {
+                return false;
+            }
+            Unlink(id);
+            _items[id].used = false;
+            _count--;
+            return true;
+        }
+
+        void Clear()
+        {
+            for(size_t i = 0; i < _buckets.size(); i++) {
+                _buckets[i].clear();
+            }
+            _items.clear();
+            _count = 0;
+        }
+
+        // replace the whole contents with `positions', where the id of each
+        // item is its index. Cell hashing and bucket filling are split over
+        // `threads' threads (0 picks the hardware concurrency)
+        void Rebuild(const glm::vec3* positions, size_t n, unsigned int threads = 0)
+        {
+            if(threads == 0) {
+                threads = std::max(1u, std::thread::hardware_concurrency());
+            }
+            // not worth spawning threads for small sets
+            if(n < 4096) {
+                threads = 1;
+            }
+
+            _items.resize(n);
+            _count = n;
+
+            // 1) every thread computes cell and bucket of a contiguous range
+            //    of items, and sorts their ids into a list per range of
+            //    buckets
+            //
+            // 2) every thread owns a contiguous range of buckets, and links
+            //    the ids all threads sorted into its range, in item order -
+            //    no two threads ever write to the same bucket, and every
+            //    item is touched once
+            size_t bucket_count = _buckets.size();
+            _scattered.resize((size_t)threads * threads);
+            std::vector<std::thread> workers;
+            for(unsigned int t = 0; t < threads; t++)
+            {
+                size_t begin = n * t / threads;
+                size_t end = n * (t + 1) / threads;
+                workers.push_back(std::thread([this, positions, begin, end, t, threads,
+                                               bucket_count]() {
+                    std::vector<uint32_t>* lists = &_scattered[(size_t)t * threads];
+                    for(unsigned int r = 0; r < threads; r++) {
+                        lists[r].clear();
+                    }
+                    for(size_t i = begin; i < end; i++)
+                    {
+                        Item& item = _items[i];
+                        item.pos = positions[i];
+                        item.cell = CellOf(item.pos);
+                        item.bucket = BucketOf(item.cell);
+                        item.used = true;
+                        if(threads > 1)
+                        {
+                            // the range r with bucket_count * r / threads <= bucket
+                            size_t r = ((uint64_t)(item.bucket + 1) * threads - 1) / bucket_count;
+                            lists[r].push_back((uint32_t)i);
+                        }
+                    }
+                }));
+            }
+            for(size_t t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+            workers.clear();
+
+            for(unsigned int r = 0; r < threads; r++)
+            {
+                uint32_t lo = (uint32_t)(bucket_count * r / threads);
+                uint32_t hi = (uint32_t)(bucket_count * (r + 1) / threads);
+                workers.push_back(std::thread([this, n, lo, hi, r, threads]() {
+                    for(uint32_t b = lo; b < hi; b++) {
+                        _buckets[b].clear();
+                    }
+                    // a single range takes every item, nothing was sorted
+                    if(threads == 1)
+                    {
+                        for(size_t i = 0; i < n; i++) {
+                            Link((uint32_t)i);
+                        }
+                        return;
+                    }
+                    for(unsigned int t = 0; t < threads; t++)
+                    {
+                        const std::vector<uint32_t>& ids = _scattered[(size_t)t * threads + r];
+                        for(size_t i = 0; i < ids.size(); i++) {
+                            Link(ids[i]);
+                        }
+                    }
+                }));
+            }
+            for(size_t t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+        }
+
+        // call `func(uint32_t id, const glm::vec3& pos)' for every item
+        // inside the box [min, max]
+        template<typename Func>
+        void ForEachInAABB(const glm::vec3& min, const glm::vec3& max, Func func) const
+        {
+            glm::ivec3 lo = CellOf(min);
+            glm::ivec3 hi = CellOf(max);
+
+            for(int z = lo.z; z <= hi.z; z++)
+            {
+                for(int y = lo.y; y <= hi.y; y++)
+                {
+                    for(int x = lo.x; x <= hi.x; x++)
+                    {
+                        glm::ivec3 cell(x, y, z);
+                        const std::vector<uint32_t>& bucket = _buckets[BucketOf(cell)];
+                        for(size_t i = 0; i < bucket.size(); i++)
+                        {
+                            const Item& item = _items[bucket[i]];
+                            // other cells may share the bucket, and
+                            // must not be reported twice
+                            if(item.cell != cell) {
+                                continue;
+                            }
+                            if(item.pos.x >= min.x && item.pos.x <= max.x &&
+                               item.pos.y >= min.y && item.pos.y <= max.y &&
+                               item.pos.z >= min.z && item.pos.z <= max.z)
+                            {
+                                func(bucket[i], item.pos);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        // call `func(uint32_t id, const glm::vec3& pos)' for every item
+        // within `radius' of `center'
+        template<typename Func>
+        void ForEachInRadius(const glm::vec3& center, float radius, Func func) const
+        {
+            float r2 = radius * radius;
+            glm::vec3 ext(radius);
+            ForEachInAABB(center - ext, center + ext,
+                [&](uint32_t id, const glm::vec3& pos) {
+                    glm::vec3 d = pos - center;
+                    if(glm::dot(d, d) <= r2) {
+                        func(id, pos);
+                    }
+                });
+        }
+
+        void QueryAABB(const glm::vec3& min, const glm::vec3& max,
+                       std::vector<uint32_t>& out) const
+        {
+            ForEachInAABB(min, max, [&out](uint32_t id, const glm::vec3&) {
+                out.push_back(id);
+            });
+        }
+
+        void QueryRadius(const glm::vec3& center, float radius,
+                         std::vector<uint32_t>& out) const
+        {
+            ForEachInRadius(center, radius, [&out](uint32_t id, const glm::vec3&) {
+                out.push_back(id);
+            });
+        }
+    };
+
+} // namespace spatial
+
+#endif // SPATIAL_HASH_HPP
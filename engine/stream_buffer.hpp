@@ -0,0 +1,314 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+// GLEW
+#ifndef GLEW_STATIC
+#define GLEW_STATIC
+#endif
+#include <GL/glew.h>
+
+// STANDARD
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// CUSTOM
+#include "profiler.hpp"
+
+// One large buffer object that data is streamed into every frame, instead
+// of calling glBufferData and having the driver reallocate (or wait).
+//
+// The buffer is used as a ring: every `Map' takes the bytes following the
+// previous one and wraps around at the end. `EndFrame' puts a fence behind
+// everything written since the last one, and writing over bytes of an
+// earlier frame first waits for its fence, so the GPU is never handed data
+// that changed under its feet. Waits only happen when the GPU is more than
+// a whole buffer behind, and are counted in the stats.
+//
+// With ARB_buffer_storage (core in 4.4) the buffer is mapped once,
+// persistently and coherently. The 3.3 core context that
+// `window::set_window_hints' asks for may not have it; then every `Map'
+// maps its range unsynchronized, and the buffer is orphaned with
+// glBufferData whenever the ring wraps, which needs no fences at all.
+//
+// Proper usage:
+//
+// stream_buffer::StreamBuffer stream(4 << 20);
+// while(gameisrunning) {
+//     size_t offset;
+//     GLfloat* vertices = (GLfloat*)stream.Map(bytes, 3 * sizeof(GLfloat), offset);
+//     ... (write the vertices) ...
+//     stream.Unmap();
+//     ... (draw from stream.Buffer() at `offset') ...
+//     stream.EndFrame();
+// }
+namespace stream_buffer
+{
+    // how long a fence wait may take before it is reported, in nanoseconds
+    #define STREAM_BUFFER_WAIT_NS 1000000000
+
+    // traffic of one frame, or of all of them
+    typedef struct _stream_stats_t {
+        _stream_stats_t() : bytes(0), uploads(0), waits(0), wait_ms(0.0), orphans(0) {}
+
+        size_t bytes;    // written, without alignment padding
+        size_t uploads;  // calls to `Map'
+        size_t waits;    // fences that had not been reached yet
+        double wait_ms;  // time spent waiting for them
+        size_t orphans;  // buffers orphaned by the fallback
+    } _stream_stats_t;
+
+    class StreamBuffer
+    {
+    private:
+        GLuint _buffer;
+        GLenum _target;
+        size_t _capacity;
+        bool _persistent;
+        unsigned char* _mapped;       // the whole buffer, when persistent
+        unsigned char* _mapped_range; // returned by the last `Map'
+
+        // bytes handed out so far, counting every wrap, so ranges of
+        // different frames compare without thinking about the wrap
+        uint64_t _head;
+        uint64_t _frame_start;
+        uint64_t _lap; // of the current orphan, without persistent mapping
+
+        struct Segment
+        {
+            GLsync fence;
+            uint64_t start, end;
+        };
+        // a ring of the fenced segments, oldest at `_segments_first', so
+        // fencing frame after frame allocates nothing once it is big enough
+        std::vector<Segment> _segments;
+        size_t _segments_first, _segments_count;
+
+        void PushSegment(const Segment& s)
+        {
+            if(_segments_count == _segments.size())
+            {
+                // full, unroll into one twice the size
+                std::vector<Segment> grown(std::max((size_t)16, 2 * _segments.size()));
+                for(size_t i = 0; i < _segments_count; i++) {
+                    grown[i] = _segments[(_segments_first + i) % _segments.size()];
+                }
+                _segments.swap(grown);
+                _segments_first = 0;
+            }
+            _segments[(_segments_first + _segments_count) % _segments.size()] = s;
+            _segments_count++;
+        }
+
+        Segment PopSegment()
+        {
+            Segment s = _segments[_segments_first];
+            _segments_first = (_segments_first + 1) % _segments.size();
+            _segments_count--;
+            return s;
+        }
+
+        _stream_stats_t _frame, _last_frame, _total;
+
+        void Allocate()
+        {
+            glGenBuffers(1, &_buffer);
+            glBindBuffer(_target, _buffer);
+            if(_persistent)
+            {
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(_target, _capacity, NULL, flags);
+                _mapped = (unsigned char*)glMapBufferRange(_target, 0, _capacity, flags);
+                if(_mapped == NULL)
+                {
+                    std::cerr << "Could not map the stream buffer persistently, "
+                              << "falling back to orphaning" << std::endl;
+                    glDeleteBuffers(1, &_buffer);
+                    _persistent = false;
+                    Allocate();
+                }
+            }
+            else {
+                glBufferData(_target, _capacity, NULL, GL_STREAM_DRAW);
+            }
+        }
+
+        // put a fence behind everything written since the last one
+        void CloseSegment()
+        {
+            if(_head == _frame_start) {
+                return;
+            }
+            Segment s = { glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), _frame_start, _head };
+            PushSegment(s);
+            _frame_start = _head;
+        }
+
+        // wait until the GPU is done with everything written before `position'
+        void WaitUntil(uint64_t position)
+        {
+            // the frame being written may be the one in the way
+            if(_frame_start < position) {
+                CloseSegment();
+            }
+
+            while(_segments_count > 0 && _segments[_segments_first].start < position)
+            {
+                Segment s = PopSegment();
+
+                GLenum status = glClientWaitSync(s.fence, 0, 0);
+                if(status == GL_TIMEOUT_EXPIRED)
+                {
+                    PROFILE_SCOPE("stream buffer wait");
+                    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                    status = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                              STREAM_BUFFER_WAIT_NS);
+                    std::chrono::duration<double, std::milli> d =
+                        std::chrono::steady_clock::now() - start;
+                    _frame.waits++;
+                    _frame.wait_ms += d.count();
+                }
+                if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+                    std::cerr << "Stream buffer fence was not reached" << std::endl;
+                }
+                glDeleteSync(s.fence);
+            }
+        }
+
+    public:
+        // needs a current OpenGL context. `persistent' false forces the
+        // orphaning fallback, e.g. to compare both
+        StreamBuffer(size_t capacity, GLenum target = GL_ARRAY_BUFFER, bool persistent = true)
+            : _buffer(0), _target(target), _capacity(capacity), _mapped(NULL),
+              _mapped_range(NULL), _head(0), _frame_start(0), _lap(0), _segments_first(0),
+              _segments_count(0)
+        {
+            _persistent = persistent && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+            Allocate();
+        }
+
+        ~StreamBuffer()
+        {
+            while(_segments_count > 0) {
+                glDeleteSync(PopSegment().fence);
+            }
+            if(_persistent)
+            {
+                glBindBuffer(_target, _buffer);
+                glUnmapBuffer(_target);
+            }
+            glDeleteBuffers(1, &_buffer);
+        }
+
+        GLuint Buffer() const { return _buffer; }
+        size_t Capacity() const { return _capacity; }
+        bool Persistent() const { return _persistent; }
+
+        // room for `bytes', starting at a multiple of `alignment' bytes
+        // into the buffer, which ends up in `offset'. The pointer is valid
+        // until `Unmap'. Returns NULL if `bytes' is larger than the buffer
+        void* Map(size_t bytes, size_t alignment, size_t& offset)
+        {
+            if(bytes > _capacity)
+            {
+                std::cerr << "Stream buffer upload of " << bytes << " bytes does not fit into "
+                          << _capacity << std::endl;
+                return NULL;
+            }
+
+            // aligned within the buffer, which need not be a multiple of it
+            uint64_t lap_start = _head - _head % _capacity;
+            uint64_t start = lap_start + (_head % _capacity + alignment - 1) / alignment * alignment;
+            if(start - lap_start + bytes > _capacity) {
+                start = lap_start + _capacity; // wrap around
+            }
+            offset = (size_t)(start % _capacity);
+
+            glBindBuffer(_target, _buffer);
+            if(_persistent)
+            {
+                // the bytes overwritten were written one lap earlier
+                if(start + bytes > _capacity) {
+                    WaitUntil(start + bytes - _capacity);
+                }
+                _head = start + bytes;
+                _mapped_range = _mapped + offset;
+            }
+            else
+            {
+                // a new lap starts on a fresh buffer, the old one lives on
+                // until the GPU is done with it
+                if(start / _capacity != _lap)
+                {
+                    glBufferData(_target, _capacity, NULL, GL_STREAM_DRAW);
+                    _lap = start / _capacity;
+                    _frame.orphans++;
+                }
+                _head = start + bytes;
+                _mapped_range = (unsigned char*)glMapBufferRange(_target, offset, bytes,
+                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            }
+
+            _frame.bytes += bytes;
+            _frame.uploads++;
+            return _mapped_range;
+        }
+
+        // done writing what `Map' returned
+        void Unmap()
+        {
+            if(!_persistent && _mapped_range != NULL)
+            {
+                glBindBuffer(_target, _buffer);
+                glUnmapBuffer(_target);
+            }
+            _mapped_range = NULL;
+        }
+
+        // copy `bytes' from `data' into the ring, return where they went
+        size_t Upload(const void* data, size_t bytes, size_t alignment = 4)
+        {
+            size_t offset = 0;
+            void* dst = Map(bytes, alignment, offset);
+            if(dst != NULL) {
+                memcpy(dst, data, bytes);
+            }
+            Unmap();
+            return offset;
+        }
+
+        // call after the draw calls using this frame's data were issued
+        void EndFrame()
+        {
+            if(_persistent)
+            {
+                CloseSegment();
+
+                // segments the GPU is done with need no fence any more, which
+                // keeps the ring as short as the frames in flight
+                while(_segments_count > 0 &&
+                      glClientWaitSync(_segments[_segments_first].fence, 0, 0) != GL_TIMEOUT_EXPIRED) {
+                    glDeleteSync(PopSegment().fence);
+                }
+            }
+            _last_frame = _frame;
+            _total.bytes += _frame.bytes;
+            _total.uploads += _frame.uploads;
+            _total.waits += _frame.waits;
+            _total.wait_ms += _frame.wait_ms;
+            _total.orphans += _frame.orphans;
+            _frame = _stream_stats_t();
+        }
+
+        // stats of the frame before the last `EndFrame', and of all frames
+        const _stream_stats_t& LastFrame() const { return _last_frame; }
+        const _stream_stats_t& Total() const { return _total; }
+    };
+
+} // namespace stream_buffer
+
+#endif // STREAM_BUFFER_HPP
@@ -1,11 +1,19 @@
 //
 // System file.
 //
-// Retrieving information about platform
+// Retrieving information about platform and memory usage
 // (later also about memory limit, processor, GPU type, etc.)
 
 #pragma once
 
+#include <stddef.h>
+#include <stdio.h>
+
+#if defined(__linux__) || defined(linux) || defined(__linux)
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
 namespace System
 {
     // platform type of the system
@@ -41,5 +49,39 @@ namespace System
         #error "OS not supported!"
     #endif
 
+    // resident memory of this process in bytes, 0 where unsupported
+    size_t resident_memory()
+    {
+    #if defined(__linux__) || defined(linux) || defined(__linux)
+        FILE* file = fopen("/proc/self/statm", "r");
+        if(file == NULL) {
+            return 0;
+        }
+        long pages = 0, resident = 0;
+        int read = fscanf(file, "%ld %ld", &pages, &resident);
+        fclose(file);
+        if(read != 2) {
+            return 0;
+        }
+        return (size_t)resident * (size_t)sysconf(_SC_PAGESIZE);
+    #else
+        return 0;
+    #endif
+    }
+
+    // highest resident memory of this process so far in bytes,
+    // 0 where unsupported
+    size_t peak_memory()
+    {
+    #if defined(__linux__) || defined(linux) || defined(__linux)
+        struct rusage usage;
+        if(getrusage(RUSAGE_SELF, &usage) != 0) {
+            return 0;
+        }
+        return (size_t)usage.ru_maxrss * 1024; // reported in kilobytes
+    #else
+        return 0;
+    #endif
+    }
 
 } // namespace system
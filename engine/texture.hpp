@@ -22,6 +22,47 @@
 
 #define HAS_FLAG(mask, flag) (mask & flag)
 
+// apply the options of bit mask `mask' to the texture bound to `target'
+void set_texture_options(GLenum target, unsigned long mask)
+{
+    if(HAS_FLAG(mask, TEX_GENERATE_MIPMAP)) {
+        glGenerateMipmap(target);
+    }
+
+    if(HAS_FLAG(mask, TEX_REPEAT)) {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+    else if(HAS_FLAG(mask, TEX_MIRRORED_REPEAT)) {
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
+    }
+    else if(HAS_FLAG(mask, TEX_CLAMP_TO_BORDER)) {
+        // WARNING
+        // for some reason, this functionality is currently broken
+        glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        GLfloat borderColor[] = { 1.0f, 0.0f, 0.0f, 1.0f };
+        glTexParameterfv(target, GL_TEXTURE_BORDER_COLOR, borderColor);
+    }
+
+    if(HAS_FLAG(mask, TEX_NEAREST_FILTER)) {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+    else if(HAS_FLAG(mask, TEX_LINEAR_FILTER)) {
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    else if(HAS_FLAG(mask, TEX_MIXED_FILTER)) {
+        // will use nearest neighbor filtering when scaled down
+        // (more pixelated look), and use linear filtering when scaling
+        // up (more realistic/blurry look)
+        glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+}
+
 class Texture
 {
 private:
@@ -67,42 +108,7 @@ public:
         }
 
         // set options
-        if(HAS_FLAG(mask, TEX_GENERATE_MIPMAP)) {
-            glGenerateMipmap(GL_TEXTURE_2D);
-        }
-
-        if(HAS_FLAG(mask, TEX_REPEAT)) {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        }
-        else if(HAS_FLAG(mask, TEX_MIRRORED_REPEAT)) {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_MIRRORED_REPEAT);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_MIRRORED_REPEAT);
-        }
-        else if(HAS_FLAG(mask, TEX_CLAMP_TO_BORDER)) {
-            // WARNING
-            // for some reason, this functionality is currently broken
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-            GLfloat borderColor[] = { 1.0f, 0.0f, 0.0f, 1.0f };
-            glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-        }
-
-        if(HAS_FLAG(mask, TEX_NEAREST_FILTER)) {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        }
-        else if(HAS_FLAG(mask, TEX_LINEAR_FILTER)) {
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        }
-        else if(HAS_FLAG(mask, TEX_MIXED_FILTER)) {
-            // will use nearest neighbor filtering when scaled down
-            // (more pixelated look), and use linear filtering when scaling
-            // up (more realistic/blurry look)
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        }
+        set_texture_options(GL_TEXTURE_2D, mask);
 
         // cleanup
         SOIL_free_image_data(image);
@@ -118,5 +124,76 @@ public:
     }
 };
 
+// layers of equally sized images in one GL_TEXTURE_2D_ARRAY, so a shader
+// picks the image by a layer index instead of by branching between samplers
+//
+// Proper usage:
+//
+// const char* paths[2] = { "assets|a.png", "assets|b.png" };
+// TextureArray textures(paths, 2, TEX_GENERATE_MIPMAP);
+// glBindTexture(GL_TEXTURE_2D_ARRAY, textures.GetTexture());
+class TextureArray
+{
+private:
+    GLuint texture;
+    int width, height, layers;
+public:
+    // same bit mask as for `Texture', images are loaded as RGBA
+    TextureArray(const char* const* paths, int count, unsigned long mask)
+        : width(0), height(0), layers(count)
+    {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+
+        for(int layer = 0; layer < count; layer++)
+        {
+            std::string fullpath = fileIO::getPlatformFilePath(paths[layer]);
+            int w = 0, h = 0;
+            unsigned char* image = SOIL_load_image(fullpath.c_str(), &w, &h, 0, SOIL_LOAD_RGBA);
+            if(image == NULL)
+            {
+                std::cerr << "Could not read image '" << fullpath << "'" << std::endl;
+                continue;
+            }
+
+            // the first image decides the size of all of them
+            if(layer == 0)
+            {
+                width = w;
+                height = h;
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, count, 0,
+                             GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+            }
+            if(w != width || h != height) {
+                std::cerr << "Image '" << fullpath << "' is " << w << "x" << h
+                          << ", not " << width << "x" << height << " as the others" << std::endl;
+            }
+            else {
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1,
+                                GL_RGBA, GL_UNSIGNED_BYTE, image);
+            }
+            SOIL_free_image_data(image);
+        }
+
+        set_texture_options(GL_TEXTURE_2D_ARRAY, mask);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
+
+    ~TextureArray()
+    {
+        glDeleteTextures(1, &texture);
+    }
+
+    GLuint GetTexture()
+    {
+        return texture;
+    }
+
+    int Layers()
+    {
+        return layers;
+    }
+};
+
 
 #endif // TEXTURE_HPP
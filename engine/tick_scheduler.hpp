@@ -0,0 +1,181 @@
+#ifndef TICK_SCHEDULER_HPP
+#define TICK_SCHEDULER_HPP
+
+// STANDARD
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <unordered_set>
+#include <map>
+
+// Time-ordered queue of pending updates at block positions.
+//
+// An update is due a number of ticks after it was scheduled. Every call to
+// `Process' advances the clock by one tick and runs the due updates, oldest
+// first, but never more than the per-tick budget - whatever does not fit is
+// carried over to the next tick. A position can only be pending once.
+//
+// Proper usage:
+//
+// ticks::TickScheduler scheduler;
+// scheduler.Schedule(x, y, z, 2);
+//
+// while(gameisrunning) {
+//     scheduler.Process([&](int x, int y, int z) {
+//         ... (update the block at x, y, z) ...
+//     });
+// }
+namespace ticks
+{
+    // counters for the most recent tick
+    typedef struct _tick_stats_t {
+        _tick_stats_t() : scheduled(0), executed(0), carried_over(0),
+                          random_ticks(0), neighbour_updates(0) {}
+
+        size_t scheduled;         // updates added to the queue
+        size_t executed;          // scheduled updates that ran
+        size_t carried_over;      // due updates left for the next tick
+        size_t random_ticks;      // random ticks sampled by the world
+        size_t neighbour_updates; // neighbours notified of a change
+    } _tick_stats_t;
+
+    class TickScheduler
+    {
+    private:
+        struct Pending
+        {
+            int x, y, z;
+        };
+
+        // one FIFO bucket per due tick. Map nodes never move, so buckets
+        // stay valid while updates schedule new ones
+        std::map<uint64_t, std::vector<Pending> > _buckets;
+        // entries of the first bucket that have already run
+        size_t _cursor;
+        size_t _pending;
+        std::unordered_set<uint64_t> _pending_keys;
+
+        uint64_t _now;
+        size_t _budget;
+        uint32_t _random_state;
+
+        _tick_stats_t _stats;
+
+        // 21 bits per coordinate
+        static uint64_t Key(int x, int y, int z)
+        {
+            return ((uint64_t)(x & 0x1FFFFF) << 42)
+                 | ((uint64_t)(y & 0x1FFFFF) << 21)
+                 |  (uint64_t)(z & 0x1FFFFF);
+        }
+
+    public:
+        // at most `budget' scheduled updates run per tick
+        TickScheduler(size_t budget = 65536)
+            : _cursor(0), _pending(0), _now(0), _budget(budget),
+              _random_state(0x9E3779B9u) {}
+
+        uint64_t Now() const { return _now; }
+        size_t PendingCount() const { return _pending; }
+        size_t Budget() const { return _budget; }
+        void SetBudget(size_t budget) { _budget = budget; }
+
+        _tick_stats_t& Stats() { return _stats; }
+
+        // return false if an update is already pending at the position.
+        // A delay of 0 is treated as 1, updates never run in the tick that
+        // scheduled them
+        bool Schedule(int x, int y, int z, unsigned int delay)
+        {
+            if(!_pending_keys.insert(Key(x, y, z)).second) {
+                return false;
+            }
+
+            Pending p = { x, y, z };
+            _buckets[_now + (delay > 0 ? delay : 1)].push_back(p);
+            _pending++;
+
+            _stats.scheduled++;
+            return true;
+        }
+
+        bool IsPending(int x, int y, int z) const
+        {
+            return _pending_keys.count(Key(x, y, z)) > 0;
+        }
+
+        // reserve room for `n' pending positions
+        void Reserve(size_t n)
+        {
+            _pending_keys.reserve(n);
+        }
+
+        // start a new tick: advance the clock and reset the counters
+        void BeginTick()
+        {
+            _now++;
+            _stats = _tick_stats_t();
+        }
+
+        // run the updates that are due, calling `func(x, y, z)' for each,
+        // and return how many ran. `func' may schedule new updates
+        template<typename Func>
+        size_t RunDue(Func func)
+        {
+            size_t executed = 0;
+            while(!_buckets.empty() && _buckets.begin()->first <= _now)
+            {
+                std::vector<Pending>& bucket = _buckets.begin()->second;
+                while(_cursor < bucket.size() && executed < _budget)
+                {
+                    Pending p = bucket[_cursor++];
+                    _pending_keys.erase(Key(p.x, p.y, p.z));
+                    _pending--;
+
+                    func(p.x, p.y, p.z);
+                    executed++;
+                }
+                if(_cursor < bucket.size()) {
+                    break; // out of budget
+                }
+
+                _buckets.erase(_buckets.begin());
+                _cursor = 0;
+            }
+
+            // whatever is still due waits for the next tick
+            std::map<uint64_t, std::vector<Pending> >::iterator it = _buckets.begin();
+            for(; it != _buckets.end() && it->first <= _now; ++it) {
+                _stats.carried_over += it->second.size();
+            }
+            if(!_buckets.empty() && _buckets.begin()->first <= _now) {
+                _stats.carried_over -= _cursor;
+            }
+
+            _stats.executed += executed;
+            return executed;
+        }
+
+        // a whole tick: BeginTick followed by RunDue
+        template<typename Func>
+        size_t Process(Func func)
+        {
+            BeginTick();
+            return RunDue(func);
+        }
+
+        // xorshift32, for sampling random ticks reproducibly
+        uint32_t NextRandom()
+        {
+            uint32_t x = _random_state;
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            _random_state = x;
+            return x;
+        }
+    };
+
+} // namespace ticks
+
+#endif // TICK_SCHEDULER_HPP
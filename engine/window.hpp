@@ -133,10 +133,14 @@ namespace window
         glfwWindowHint(GLFW_SAMPLES, 4);
     }
 
-    WindowedWindow* create_window(std::string title, int width, as_ratio_t aspect)
+    // an invisible window still gets a full OpenGL context and default
+    // framebuffer, which is all headless benchmark runs need
+    WindowedWindow* create_window(std::string title, int width, as_ratio_t aspect,
+                                  bool visible = true)
     {
         init_GLFW();
         set_window_hints();
+        glfwWindowHint(GLFW_VISIBLE, visible ? GL_TRUE : GL_FALSE);
 
         // height according to specified aspect ratio
         int height = get_aspect_ratio_height(width, aspect);
@@ -0,0 +1,340 @@
+#ifndef FLUID_SIMULATION_HPP
+#define FLUID_SIMULATION_HPP
+
+// STANDARD
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+// CUSTOM
+#include "block.hpp"
+#include "engine/profiler.hpp"
+
+// level lost per block of sideways flow
+#define WATER_DROP 1
+#define LAVA_DROP  2
+
+// lava only flows every LAVA_RATE steps
+#define LAVA_RATE 3
+
+// below this many active cells a step runs on the calling thread
+#define FLUID_PARALLEL_THRESHOLD 4096
+
+// counters for the most recent step
+typedef struct _fluid_stats_t {
+    _fluid_stats_t() : active(0), cells_updated(0), cells_changed(0) {}
+
+    size_t active;        // cells in the active set
+    size_t cells_updated; // cells evaluated
+    size_t cells_changed; // cells whose type or level changed
+} _fluid_stats_t;
+
+// Cellular-automaton flow of water and lava.
+//
+// Only cells in the active set are evaluated. A cell is active when it,
+// or one of its neighbours, changed during the previous step - so once the
+// fluid has settled the active set runs dry and the simulation sleeps
+// until something activates it again.
+//
+// Every cell pulls its new level from its neighbours, and writes nothing
+// but its own result, so a step evaluates the active set in parallel: it
+// is sorted and split into contiguous slabs of the world, one per thread.
+// The changes are applied afterwards on the calling thread.
+//
+// `World' must provide:
+//
+// bool InBounds(int x, int y, int z)
+// const _block_t& BlockAt(int x, int y, int z)
+// void SetBlock(int x, int y, int z, const _block_t& block)
+class FluidSimulation
+{
+private:
+    struct Change
+    {
+        int x, y, z;
+        _block_t block;
+    };
+
+    int _width, _height, _depth;
+
+    // step a cell was last queued for, so it is only queued once
+    std::vector<uint32_t> _queued;
+    uint32_t _step;
+
+    std::vector<uint32_t> _active;
+    std::vector<uint32_t> _next_active;
+
+    unsigned int _threads;
+    _fluid_stats_t _stats;
+
+    inline uint32_t Index(int x, int y, int z) const
+    {
+        return (uint32_t)(((z * _height) + y) * _width + x);
+    }
+
+    template<typename World>
+    static bool Supported(World& world, int x, int y, int z)
+    {
+        // the bottom of the world holds fluids, too
+        if(y == 0) {
+            return true;
+        }
+        const _block_t& below = world.BlockAt(x, y - 1, z);
+        return is_solid(below.type) || below.level == FLUID_SOURCE;
+    }
+
+    // level a cell gets from its neighbours holding fluid `type'
+    template<typename World>
+    static int PullLevel(World& world, int x, int y, int z, _block_type_t type)
+    {
+        static const int sides[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+        // falling fluid stays (almost) full
+        if(world.InBounds(x, y + 1, z) && world.BlockAt(x, y + 1, z).type == type) {
+            return FLUID_SOURCE - 1;
+        }
+
+        int drop = (type == BLOCK_TYPE_LAVA) ? LAVA_DROP : WATER_DROP;
+        int level = 0;
+        for(int i = 0; i < 4; i++)
+        {
+            int nx = x + sides[i][0];
+            int nz = z + sides[i][1];
+            if(!world.InBounds(nx, y, nz)) {
+                continue;
+            }
+            const _block_t& n = world.BlockAt(nx, y, nz);
+            // fluid only spreads sideways once it cannot fall any further
+            if(n.type == type && Supported(world, nx, y, nz)) {
+                level = std::max(level, (int)n.level - drop);
+            }
+        }
+        return level;
+    }
+
+    template<typename World>
+    static bool Touches(World& world, int x, int y, int z, _block_type_t type)
+    {
+        static const int offsets[6][3] = {
+            { 1, 0, 0 }, { -1, 0, 0 },
+            { 0, 1, 0 }, { 0, -1, 0 },
+            { 0, 0, 1 }, { 0, 0, -1 }
+        };
+        for(int i = 0; i < 6; i++)
+        {
+            int nx = x + offsets[i][0];
+            int ny = y + offsets[i][1];
+            int nz = z + offsets[i][2];
+            if(world.InBounds(nx, ny, nz) && world.BlockAt(nx, ny, nz).type == type) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // compute the next state of a cell. Return true if it changes, false
+    // if it stays as is. `postpone' is set for lava waiting for its turn
+    template<typename World>
+    bool Evaluate(World& world, int x, int y, int z, Change& change, bool& postpone) const
+    {
+        postpone = false;
+        const _block_t& cell = world.BlockAt(x, y, z);
+        if(is_solid(cell.type)) {
+            return false;
+        }
+
+        _block_t next;
+        if(cell.level == FLUID_SOURCE)
+        {
+            next = cell;
+        }
+        else
+        {
+            int water = PullLevel(world, x, y, z, BLOCK_TYPE_WATER);
+            int lava = (water > 0) ? 0 : PullLevel(world, x, y, z, BLOCK_TYPE_LAVA);
+            if(water > 0)
+            {
+                next = _block_t(BLOCK_TYPE_WATER, 10);
+                next.level = (unsigned char)water;
+            }
+            else if(lava > 0)
+            {
+                next = _block_t(BLOCK_TYPE_LAVA, 10);
+                next.level = (unsigned char)lava;
+            }
+        }
+
+        if(cell.type == BLOCK_TYPE_LAVA || next.type == BLOCK_TYPE_LAVA)
+        {
+            if(_step % LAVA_RATE != 0)
+            {
+                postpone = true;
+                return false;
+            }
+            // lava meeting water hardens
+            if(next.type == BLOCK_TYPE_LAVA && Touches(world, x, y, z, BLOCK_TYPE_WATER)) {
+                next = _block_t(BLOCK_TYPE_STONE);
+            }
+        }
+
+        if(next.type == cell.type && next.level == cell.level) {
+            return false;
+        }
+
+        change.x = x;
+        change.y = y;
+        change.z = z;
+        change.block = next;
+        return true;
+    }
+
+    template<typename World>
+    void EvaluateRange(World& world, size_t begin, size_t end,
+                       std::vector<Change>& changes,
+                       std::vector<uint32_t>& postponed) const
+    {
+        PROFILE_SCOPE("fluid slab");
+        int layer = _width * _height;
+        for(size_t i = begin; i < end; i++)
+        {
+            uint32_t index = _active[i];
+            int z = index / layer;
+            int y = (index % layer) / _width;
+            int x = index % _width;
+
+            Change change;
+            bool postpone;
+            if(Evaluate(world, x, y, z, change, postpone)) {
+                changes.push_back(change);
+            }
+            else if(postpone) {
+                postponed.push_back(index);
+            }
+        }
+    }
+
+public:
+    // `threads' of 0 picks the hardware concurrency
+    FluidSimulation(int width, int height, int depth, unsigned int threads = 0)
+        : _width(width), _height(height), _depth(depth), _step(0), _threads(threads)
+    {
+        _queued.resize((size_t)width * height * depth, 0);
+        if(_threads == 0) {
+            _threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+
+    // queue a cell for the next step
+    void Activate(int x, int y, int z)
+    {
+        uint32_t index = Index(x, y, z);
+        if(_queued[index] != _step + 1)
+        {
+            _queued[index] = _step + 1;
+            _next_active.push_back(index);
+        }
+    }
+
+    // queue a cell and its six neighbours
+    void ActivateAround(int x, int y, int z)
+    {
+        Activate(x, y, z);
+        if(x > 0)           Activate(x - 1, y, z);
+        if(x + 1 < _width)  Activate(x + 1, y, z);
+        if(y > 0)           Activate(x, y - 1, z);
+        if(y + 1 < _height) Activate(x, y + 1, z);
+        if(z > 0)           Activate(x, y, z - 1);
+        if(z + 1 < _depth)  Activate(x, y, z + 1);
+    }
+
+    bool Asleep() const
+    {
+        return _next_active.empty();
+    }
+
+    void SetThreads(unsigned int threads)
+    {
+        _threads = std::max(1u, threads);
+    }
+
+    const _fluid_stats_t& Stats() const
+    {
+        return _stats;
+    }
+
+    // advance the simulation by one step, return the number of changed cells
+    template<typename World>
+    size_t Step(World& world)
+    {
+        _step++;
+        _active.swap(_next_active);
+        _next_active.clear();
+
+        _stats = _fluid_stats_t();
+        _stats.active = _active.size();
+        if(_active.empty()) {
+            return 0;
+        }
+
+        unsigned int threads = _threads;
+        if(_active.size() < FLUID_PARALLEL_THRESHOLD) {
+            threads = 1;
+        }
+
+        // sorted, every thread gets a contiguous slab of the world
+        std::sort(_active.begin(), _active.end());
+
+        std::vector<std::vector<Change> > changes(threads);
+        std::vector<std::vector<uint32_t> > postponed(threads);
+        if(threads == 1)
+        {
+            EvaluateRange(world, 0, _active.size(), changes[0], postponed[0]);
+        }
+        else
+        {
+            std::vector<std::thread> workers;
+            for(unsigned int t = 0; t < threads; t++)
+            {
+                size_t begin = _active.size() * t / threads;
+                size_t end = _active.size() * (t + 1) / threads;
+                workers.push_back(std::thread(
+                    &FluidSimulation::EvaluateRange<World>, this, std::ref(world),
+                    begin, end, std::ref(changes[t]), std::ref(postponed[t])));
+            }
+            for(size_t t = 0; t < workers.size(); t++) {
+                workers[t].join();
+            }
+        }
+
+        // apply, and wake up whatever the changes might affect
+        size_t changed = 0;
+        for(unsigned int t = 0; t < threads; t++)
+        {
+            for(size_t i = 0; i < changes[t].size(); i++)
+            {
+                const Change& c = changes[t][i];
+                world.SetBlock(c.x, c.y, c.z, c.block);
+                ActivateAround(c.x, c.y, c.z);
+            }
+            changed += changes[t].size();
+
+            for(size_t i = 0; i < postponed[t].size(); i++)
+            {
+                uint32_t index = postponed[t][i];
+                if(_queued[index] != _step + 1)
+                {
+                    _queued[index] = _step + 1;
+                    _next_active.push_back(index);
+                }
+            }
+        }
+
+        _stats.cells_updated = _active.size();
+        _stats.cells_changed = changed;
+        return changed;
+    }
+};
+
+#endif // FLUID_SIMULATION_HPP
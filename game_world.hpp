@@ -1,3 +1,6 @@
+#ifndef GAME_WORLD_HPP
+#define GAME_WORLD_HPP
+
 // GLEW
 #ifndef GLEW_STATIC
 #define GLEW_STATIC
@@ -15,29 +18,347 @@
 
 // STANDARD
 #include <iostream> // std::cerr
+#include <string.h>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <functional>
+#include <utility>
 
+// CUSTOM
+#include "engine/tick_scheduler.hpp"
+#include "engine/profiler.hpp"
+#include "engine/stream_buffer.hpp"
+#include "engine/mesh_buffer.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/gpu_culling.hpp"
+#include "engine/slab_pool.hpp"
+#include "engine/block_layout.hpp"
+#include "engine/bits.hpp"
+#include "block.hpp"
+#include "fluid_simulation.hpp"
+#include "edit_journal.hpp"
 
-typedef enum {
-    BLOCK_TYPE_EARTH,
-    BLOCK_TYPE_GRASS,
-    BLOCK_TYPE_STONE,
-
-    // a block that does not exist, should not be used
-    // for collision detection or AI routines, and
-    // definitely not should be drawn.
-    BLOCK_TYPE_NONE
-} _block_type_t;
-
-typedef struct _block_t {
-    // default health of a block is 10. When health
-    // reaches < 0 it should be destroyed.
-    _block_t() : type(BLOCK_TYPE_NONE), health(0) {}
-    _block_t(_block_type_t type) : type(type), health(10) {}
-    _block_t(_block_type_t type, int health) : type(type), health(health) {}
 
+// side length of the cubic sections used for random ticks
+#define SECTION_SIZE 16
+
+// blocks stored per section, in the order of BLOCK_LAYOUT
+#define SECTION_BLOCKS (SECTION_SIZE * SECTION_SIZE * SECTION_SIZE)
+
+#if SECTION_SIZE != BLOCK_LAYOUT_SIDE
+#error "block_layout.hpp indexes cubes of another size than SECTION_SIZE"
+#endif
+
+// empty slabs of block storage kept mapped, so that a section emptied and
+// filled again does not map and unmap a slab every time
+#define SPARE_STORAGE_SLABS 1
+
+// random ticks sampled per section every tick
+#define RANDOM_TICK_SPEED 3
+
+// ticks it takes a block to start falling once unsupported
+#define FALL_DELAY 2
+
+// the geometry shader turns every block into up to 6 faces of 2 triangles
+#define TRIANGLES_PER_BLOCK 12
+
+// ring buffer the block positions are streamed through every frame, in
+// bytes. Enough for about 700k drawn blocks without waiting on the GPU
+#define STREAM_BUFFER_SIZE (8 << 20)
+
+// levels of detail besides full detail, merging 2, 4 and 8 blocks per axis
+#define LOD_LEVELS 3
+
+// section meshes rebuilt after edits per `RebuildDirty', 0 for no limit
+#ifndef DIRTY_REBUILD_BUDGET
+#define DIRTY_REBUILD_BUDGET 32
+#endif
+
+// counters for the most recent `DrawBlocks'
+typedef struct _draw_stats_t {
+    _draw_stats_t() : draw_calls(0), blocks(0), lod_cells(0), triangles(0) {}
+
+    size_t draw_calls;
+    size_t blocks;    // drawn at full detail, with at least one face
+    size_t lod_cells; // merged blocks drawn for distant sections
+    size_t triangles;
+} _draw_stats_t;
+
+// counters from one `Tick' to the next
+typedef struct _dirty_stats_t {
+    _dirty_stats_t() : edits(0), dirtied(0), rebuilds(0), pending(0) {}
+
+    size_t edits;    // blocks changed
+    size_t dirtied;  // sections whose mesh went out of date
+    size_t rebuilds; // section meshes built
+    size_t pending;  // dirty sections still waiting at the end
+} _dirty_stats_t;
+
+// a cube of merged blocks standing in for them at a distance
+typedef struct _lod_cell_t {
+    short x, y, z; // the block at its lowest corner
     _block_type_t type;
-    int health;
-} _block_t;
+    unsigned char faces; // a bit per `_face_t' not hidden by another cube
+} _lod_cell_t;
+
+// faces of a section
+typedef enum {
+    FACE_NEG_X, FACE_POS_X,
+    FACE_NEG_Y, FACE_POS_Y,
+    FACE_NEG_Z, FACE_POS_Z
+} _face_t;
+
+#define ALL_FACES 0x3F
+
+// what culling needs to know about a section, see `GameWorld::Section'
+typedef struct _section_t {
+    _section_t() : blocks(0), solid_layers(0), stale(false)
+    {
+        min[0] = min[1] = min[2] = 0;
+        max[0] = max[1] = max[2] = -1;
+        for(int f = 0; f < 6; f++) {
+            connected[f] = ALL_FACES;
+        }
+    }
+
+    int blocks;         // non-empty blocks
+    int min[3], max[3]; // bounds of the non-empty blocks, inclusive
+    int solid_layers;   // completely solid layers, from the bottom up
+
+    // for every face, a mask of the faces (1 << _face_t) reachable from it
+    // through non-solid blocks of the section
+    unsigned char connected[6];
+
+    bool stale;         // the above need recomputing
+} _section_t;
+
+#if SECTION_SIZE > 16
+#error "occupancy columns hold 16 blocks"
+#endif
+
+// which blocks of a section are not air, a bit per block, in columns along
+// each axis so that the faces of a whole column are found with a few bit
+// operations. Bit i of a column is the block i along its axis; columns of
+// `x' are rows at (y, z) = (a, b), of `y' at (x, z), of `z' at (x, y),
+// stored at a * SECTION_SIZE + b
+typedef struct _occupancy_t {
+    uint16_t x[SECTION_SIZE * SECTION_SIZE];
+    uint16_t y[SECTION_SIZE * SECTION_SIZE];
+    uint16_t z[SECTION_SIZE * SECTION_SIZE];
+} _occupancy_t;
+
+// the blocks of a section, shared by the world and its snapshots. Whoever
+// holds a reference may read the blocks; the world writes them only while
+// its reference is the only one, and copies the region otherwise
+typedef struct _region_t {
+    _region_t() : refs(1), version(0) {}
+
+    mutable std::atomic<int> refs;
+    unsigned version;               // of the world when the blocks last changed
+    _block_t blocks[SECTION_BLOCKS]; // in the order of BLOCK_LAYOUT
+} _region_t;
+
+// copy-on-write counters of the block storage
+typedef struct _region_stats_t {
+    _region_stats_t() : copies(0), retired(0) {}
+
+    size_t copies;  // regions copied because a snapshot held them, in total
+    size_t retired; // regions the world let go of, still held by snapshots
+} _region_stats_t;
+
+// The blocks of a GameWorld at one moment, for other threads to read
+// while the world goes on changing: every section's region is referenced,
+// not copied, and stays as it was while the world writes to copies of the
+// ones it changes. Reading takes no locks. Taking a snapshot costs a
+// reference count per section and must happen on the thread changing the
+// world; copying and releasing one may happen on any. Snapshots have to be
+// released before their world is destroyed.
+//
+// Proper usage:
+//
+// WorldSnapshot snapshot = world.Snapshot();
+// std::thread worker([snapshot]() {
+//     ... snapshot.GetBlockType(x, y, z) ...
+// });
+// world.InsertBlock(x, y, z, BLOCK_TYPE_STONE); // not seen by the worker
+class WorldSnapshot
+{
+private:
+    int _width, _height, _depth;
+    int _sections_x, _sections_y;
+    unsigned _version;
+    std::vector<const _region_t*> _regions;
+
+    void Retain()
+    {
+        for(size_t s = 0; s < _regions.size(); s++) {
+            _regions[s]->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // the world frees what no one holds any more, seeing every read from
+    // here done before
+    void Release()
+    {
+        for(size_t s = 0; s < _regions.size(); s++) {
+            _regions[s]->refs.fetch_sub(1, std::memory_order_release);
+        }
+        _regions.clear();
+    }
+
+public:
+    // of no world at all
+    WorldSnapshot() : _width(0), _height(0), _depth(0), _sections_x(0), _sections_y(0),
+                      _version(0) {}
+
+    // see `GameWorld::Snapshot'
+    WorldSnapshot(int width, int height, int depth, int sections_x, int sections_y,
+                  const std::vector<_region_t*>& regions, unsigned version)
+        : _width(width), _height(height), _depth(depth), _sections_x(sections_x),
+          _sections_y(sections_y), _version(version), _regions(regions.begin(), regions.end())
+    {
+        Retain();
+    }
+
+    WorldSnapshot(const WorldSnapshot& other)
+        : _width(other._width), _height(other._height), _depth(other._depth),
+          _sections_x(other._sections_x), _sections_y(other._sections_y),
+          _version(other._version), _regions(other._regions)
+    {
+        Retain();
+    }
+
+    WorldSnapshot(WorldSnapshot&& other)
+        : _width(other._width), _height(other._height), _depth(other._depth),
+          _sections_x(other._sections_x), _sections_y(other._sections_y),
+          _version(other._version), _regions(std::move(other._regions))
+    {
+        other._regions.clear();
+    }
+
+    WorldSnapshot& operator=(WorldSnapshot other)
+    {
+        std::swap(_width, other._width);
+        std::swap(_height, other._height);
+        std::swap(_depth, other._depth);
+        std::swap(_sections_x, other._sections_x);
+        std::swap(_sections_y, other._sections_y);
+        std::swap(_version, other._version);
+        _regions.swap(other._regions);
+        return *this;
+    }
+
+    ~WorldSnapshot()
+    {
+        Release();
+    }
+
+    // counts the changes of the world, so a snapshot with the same version
+    // as an earlier one holds the same blocks
+    unsigned Version() const
+    {
+        return _version;
+    }
+
+    // version of the world when the blocks of a section last changed
+    unsigned SectionVersion(int section) const
+    {
+        return _regions[section]->version;
+    }
+
+    int SectionCount() const
+    {
+        return (int)_regions.size();
+    }
+
+    // blocks of a section in the order of BLOCK_LAYOUT, SECTION_BLOCKS of them
+    const _block_t* SectionBlocks(int section) const
+    {
+        return _regions[section]->blocks;
+    }
+
+    bool InBounds(int x, int y, int z) const
+    {
+        return x >= 0 && x < _width && y >= 0 && y < _height && z >= 0 && z < _depth;
+    }
+
+    // the block at a position, which must be in bounds
+    const _block_t& BlockAt(int x, int y, int z) const
+    {
+        unsigned section = (((unsigned)z / SECTION_SIZE) * _sections_y + (unsigned)y / SECTION_SIZE)
+                           * _sections_x + (unsigned)x / SECTION_SIZE;
+        return _regions[section]->blocks[block_layout::Index(x, y, z)];
+    }
+
+    _block_type_t GetBlockType(int x, int y, int z) const
+    {
+        return BlockAt(x, y, z).type;
+    }
+};
+
+// blocks copied out of a world with `GameWorld::CopyBox', to be pasted
+// elsewhere. Stored x fastest, then y, then z
+class Clipboard
+{
+private:
+    int _width, _height, _depth;
+    std::vector<_block_t> _blocks;
+
+public:
+    Clipboard() : _width(0), _height(0), _depth(0) {}
+
+    // of air blocks
+    Clipboard(int width, int height, int depth)
+        : _width(width), _height(height), _depth(depth),
+          _blocks((size_t)width * height * depth) {}
+
+    int Width() const { return _width; }
+    int Height() const { return _height; }
+    int Depth() const { return _depth; }
+    bool Empty() const { return _blocks.empty(); }
+
+    _block_t& At(int x, int y, int z)
+    {
+        return _blocks[((size_t)z * _height + y) * _width + x];
+    }
+
+    const _block_t& At(int x, int y, int z) const
+    {
+        return _blocks[((size_t)z * _height + y) * _width + x];
+    }
+
+    // turned about the y axis by `quarter_turns', each taking the +x
+    // direction to +z. Negative turns go the other way
+    Clipboard Rotated(int quarter_turns) const
+    {
+        int turns = (quarter_turns % 4 + 4) % 4;
+        if(turns == 0) {
+            return *this;
+        }
+        Clipboard rotated = (turns % 2 == 1) ? Clipboard(_depth, _height, _width)
+                                             : Clipboard(_width, _height, _depth);
+        for(int z = 0; z < _depth; z++)
+            for(int y = 0; y < _height; y++)
+                for(int x = 0; x < _width; x++)
+                {
+                    int rx, rz;
+                    if(turns == 1)      { rx = _depth - 1 - z; rz = x; }
+                    else if(turns == 2) { rx = _width - 1 - x; rz = _depth - 1 - z; }
+                    else                { rx = z;              rz = _width - 1 - x; }
+                    rotated.At(rx, y, rz) = At(x, y, z);
+                }
+        return rotated;
+    }
+};
+
+// blocks of a world that changed, as an inclusive box around them, see
+// `GameWorld::AddChangeListener'
+typedef struct _world_change_t {
+    int min[3], max[3];
+} _world_change_t;
 
 
 class GameWorld
@@ -47,142 +368,1825 @@ class GameWorld
     int _height;
     int _depth;
 
-    _block_t* _blocks;
+    // blocks of every section, a region each from `_storage', or `_air'
+    // for a section of nothing but air, so reading needs no check. Storage
+    // is freed again as soon as a section runs empty. Sections on the far
+    // edges are padded to full size.
+    // Regions held by a snapshot are copied before they are changed; the
+    // ones the world let go of wait in `_retired' until the snapshots
+    // release them. `_version' counts the changes
+    std::vector<_region_t*> _regions;
+    slab_pool::SlabPool _storage;
+    _region_t* _air;
+    std::vector<_region_t*> _retired;
+    unsigned _version;
+    _region_stats_t _region_stats;
+
+    // pending block updates (falling sand etc.)
+    ticks::TickScheduler _scheduler;
+
+    // flowing water and lava
+    FluidSimulation _fluids;
+
+    _draw_stats_t _draw_stats;
+
+    // number of sections along each axis, and the number of blocks
+    // receiving random ticks per section, so empty sections are skipped
+    int _sections_x, _sections_y, _sections_z;
+    std::vector<int> _section_random_blocks;
+
+    // per section block counts and bounds, for drawing and culling
+    std::vector<_section_t> _sections;
+
+    // told about every change of blocks, with the id they were added as
+    std::vector<std::pair<int, std::function<void(const _world_change_t&)> > > _listeners;
+    int _next_listener;
+
+    // history of the changes made between `BeginEdit' and `EndEdit'
+    EditJournal _journal;
+    _journal_transaction_t _journal_transaction;
+    EditJournal::Runs _box_before; // of the bulk edit being made
+
+    // per section occupancy columns, kept up to date by `SetBlock'. With
+    // `_face_culling' only the faces of blocks that are not hidden behind
+    // a neighbour are drawn; `_faces' takes the masks of a section
+    std::vector<_occupancy_t> _occupancy;
+    bool _face_culling;
+    std::vector<unsigned char> _faces;
 
-    // default vertex buffer data to satisfy OpenGL, for now..
-    GLuint _VBO, _VAO;
+    // merged blocks of every section for each level of detail, built when
+    // first drawn. `_lod_built' holds a bit per level
+    std::vector<std::vector<_lod_cell_t> > _lods[LOD_LEVELS];
+    std::vector<unsigned char> _lod_built;
 
-    GLfloat _vertices[3] = {
-        // Positions
-        0.0f, 0.0f, 0.0f
-    };
+    // distance in blocks from which sections are drawn at lower detail,
+    // doubling for every further level. 0 draws everything in full detail
+    int _lod_distance;
+
+    // block positions of every drawn section, one point each, in block
+    // units and with the mask of faces to draw, packed into a few large
+    // buffers. Changed meshes are uploaded through the stream buffer.
+    // Created on the first draw, so worlds can exist without a GL context
+    stream_buffer::StreamBuffer* _stream;
+    mesh_buffer::MeshBuffer* _meshes;
+    bool _persistent_stream;
+
+    // frustum culling in a compute shader and indirect draws, used when
+    // enabled, supported and `DrawBlocks' gets the view projection
+    gpu_culling::GpuCulling* _gpu_culling;
+    bool _use_gpu_culling;
+
+    // mesh handle of every section, -1 for none, with the level of detail
+    // it was built for and the faces it draws. `_mesh_built' is cleared
+    // when the section, or a block next to it, changes
+    std::vector<int> _section_meshes;
+    std::vector<unsigned char> _mesh_levels;
+    std::vector<size_t> _mesh_faces;
+    std::vector<bool> _mesh_built;
+
+    // sections whose meshes went out of date through edits, listed once
+    // however often they change. Until `RebuildDirty' lets them be rebuilt,
+    // nearest to the camera first and `_rebuild_budget' at a time, their
+    // old meshes are drawn. A section rebuilt anyway stays listed until
+    // `RebuildDirty' drops it, `_dirty_listed' keeps it from being listed
+    // twice if it changes again meanwhile
+    std::vector<int> _dirty;
+    std::vector<bool> _dirty_flags;
+    std::vector<bool> _dirty_listed;
+    size_t _dirty_count;
+    int _rebuild_budget;
+    _dirty_stats_t _dirty_stats;      // since the current tick began
+    _dirty_stats_t _tick_dirty_stats; // of the last tick
 
     void BufferVertexData()
     {
-        glGenVertexArrays(1, &_VAO);
-        glGenBuffers(1, &_VBO);
+        _stream = new stream_buffer::StreamBuffer(STREAM_BUFFER_SIZE, GL_ARRAY_BUFFER,
+                                                  _persistent_stream);
+        _meshes = new mesh_buffer::MeshBuffer(_stream);
+        if(_use_gpu_culling) {
+            _gpu_culling = new gpu_culling::GpuCulling(_stream);
+        }
+    }
 
-        // bind the VAO first, then bind and set vertex buffer(s)
-        // and attribute pointer(s)
-        glBindVertexArray(_VAO);
+    // the mesh of a section at `level', (re)built if needed. -1 if there
+    // is nothing to draw
+    int SectionMesh(int s, int level)
+    {
+        if(_mesh_built[s] && _mesh_levels[s] == level) {
+            return _section_meshes[s];
+        }
+        if(_dirty_flags[s])
+        {
+            _dirty_flags[s] = false;
+            _dirty_count--;
+        }
+        _dirty_stats.rebuilds++;
 
-        // vertices
-        glBindBuffer(GL_ARRAY_BUFFER, _VBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(_vertices), _vertices, GL_STATIC_DRAW);
+        // points to draw, and the faces they make
+        size_t count, faces;
+        if(level > 0)
+        {
+            const std::vector<_lod_cell_t>& cells = SectionLod(s, level);
+            count = cells.size();
+            faces = 0;
+            for(size_t c = 0; c < count; c++) {
+                faces += (size_t)bits::PopCount(cells[c].faces);
+            }
+        }
+        else if(_face_culling)
+        {
+            faces = SectionFaces(s, &_faces[0]);
+            count = SECTION_BLOCKS - std::count(_faces.begin(), _faces.end(), 0);
+        }
+        else
+        {
+            count = Section(s).blocks;
+            faces = 6 * count;
+        }
+        _mesh_faces[s] = faces;
 
-        // position attribute
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-        glEnableVertexAttribArray(0);
+        // keep the old room if the size did not change
+        int mesh = _section_meshes[s];
+        if(mesh >= 0 && (count == 0 || _meshes->Mesh(mesh).count != count))
+        {
+            _meshes->Free(mesh);
+            mesh = -1;
+        }
+        if(mesh < 0 && count > 0) {
+            mesh = _meshes->Allocate(count);
+        }
+        _section_meshes[s] = mesh;
+        _mesh_levels[s] = (unsigned char)level;
+        _mesh_built[s] = true;
+        if(mesh < 0) {
+            return mesh;
+        }
 
-        // good practice to unbind the VAO to prevent strange bugs
-        // do NOT unbind the EBO, keep it bound to this VAO
-        glBindVertexArray(0);
+        GLfloat* points = _meshes->Map(mesh);
+        if(points == NULL)
+        {
+            _mesh_built[s] = false;
+            return -1;
+        }
+        if(level > 0)
+        {
+            // a merged cube is centred between the blocks it covers
+            const std::vector<_lod_cell_t>& cells = SectionLod(s, level);
+            float offset = ((1 << level) - 1) / 2.0f;
+            for(size_t c = 0; c < cells.size(); c++)
+            {
+                *points++ = cells[c].x + offset;
+                *points++ = cells[c].y + offset;
+                *points++ = cells[c].z + offset;
+                *points++ = cells[c].faces;
+            }
+        }
+        else
+        {
+            const _section_t& section = Section(s);
+            const _block_t* blocks = _regions[s]->blocks;
+            for(int k = section.min[2]; k <= section.max[2]; k++)
+            {
+                for(int j = section.min[1]; j <= section.max[1]; j++)
+                {
+                    for(int i = section.min[0]; i <= section.max[0]; i++)
+                    {
+                        unsigned char mask;
+                        if(_face_culling) {
+                            mask = _faces[local_position(i, j, k)];
+                        }
+                        else {
+                            mask = blocks[get_array_position(i, j, k)].type != BLOCK_TYPE_NONE
+                                   ? ALL_FACES : 0;
+                        }
+                        if(mask != 0)
+                        {
+                            *points++ = (GLfloat)i;
+                            *points++ = (GLfloat)j;
+                            *points++ = (GLfloat)k;
+                            *points++ = (GLfloat)mask;
+                        }
+                    }
+                }
+            }
+        }
+        _meshes->Unmap(mesh);
+        return mesh;
     }
 
+    // position of a block within the storage of its section
     inline int get_array_position(int x, int y, int z)
     {
-        return (z * _height * _width) + (y * _height) + x;
+        return (int)block_layout::Index(x, y, z);
     }
 
+    // position of a block within its section, x fastest, then y, then z,
+    // whatever BLOCK_LAYOUT is
+    inline int local_position(int x, int y, int z)
+    {
+        return (int)block_layout::Index<block_layout::LAYOUT_XYZ>(x, y, z);
+    }
 
-public:
-    GameWorld(int width, int height, int depth)
-        : _width(width), _height(height), _depth(depth)
+    // positions are never negative, unsigned lets the compiler use shifts
+    inline int get_section(int x, int y, int z)
     {
-        // after this initialization, all blocks will have 10 health
-        // and marked as `BLOCK_TYPE_NONE'.
-        _blocks = new _block_t[_height * _width * _depth];
+        return (int)((((unsigned)z / SECTION_SIZE) * _sections_y + (unsigned)y / SECTION_SIZE)
+                     * _sections_x + (unsigned)x / SECTION_SIZE);
+    }
 
-        BufferVertexData();
+    // the block at a position, which must be in bounds
+    inline const _block_t& block_at(int x, int y, int z)
+    {
+        return _regions[get_section(x, y, z)]->blocks[get_array_position(x, y, z)];
     }
 
-    ~GameWorld()
+    // set or clear the bits of a block in the occupancy columns of its
+    // section. Faces of the neighbouring section may show or hide now too
+    void SetOccupied(int section, int x, int y, int z, bool occupied)
     {
-        delete _blocks;
-        glDeleteVertexArrays(1, &_VAO);
-        glDeleteBuffers(1, &_VBO);
+        _occupancy_t& o = _occupancy[section];
+        int lx = x % SECTION_SIZE, ly = y % SECTION_SIZE, lz = z % SECTION_SIZE;
+        if(occupied)
+        {
+            o.x[ly * SECTION_SIZE + lz] |= (uint16_t)(1 << lx);
+            o.y[lx * SECTION_SIZE + lz] |= (uint16_t)(1 << ly);
+            o.z[lx * SECTION_SIZE + ly] |= (uint16_t)(1 << lz);
+        }
+        else
+        {
+            o.x[ly * SECTION_SIZE + lz] &= (uint16_t)~(1 << lx);
+            o.y[lx * SECTION_SIZE + lz] &= (uint16_t)~(1 << ly);
+            o.z[lx * SECTION_SIZE + ly] &= (uint16_t)~(1 << lz);
+        }
+
+        const int last = SECTION_SIZE - 1;
+        if(lx == 0 && x > 0)                 MarkDirty(section - 1);
+        if(lx == last && x + 1 < _width)     MarkDirty(section + 1);
+        if(ly == 0 && y > 0)                 MarkDirty(section - _sections_x);
+        if(ly == last && y + 1 < _height)    MarkDirty(section + _sections_x);
+        if(lz == 0 && z > 0)                 MarkDirty(section - _sections_x * _sections_y);
+        if(lz == last && z + 1 < _depth)     MarkDirty(section + _sections_x * _sections_y);
     }
 
-    // return false if there is already a block at the desired entry
-    //
-    // TODO: block health might be set automatically within this method
-    // according to block type
-    bool InsertBlock(int x, int y, int z, _block_type_t type, int health = 10)
+    // the mesh of a section is out of date, to be rebuilt once
+    void MarkDirty(int section)
     {
-        if(health < 1)
+        if(!_dirty_flags[section])
         {
-            std::cerr << "Inserting block with health < 1" << std::endl;
-            health = 10;
+            _dirty_flags[section] = true;
+            _dirty_count++;
+            _dirty_stats.dirtied++;
+            if(!_dirty_listed[section])
+            {
+                _dirty_listed[section] = true;
+                _dirty.push_back(section);
+            }
         }
+    }
 
-        int index = get_array_position(x, y, z);
-        if(_blocks[index].type != BLOCK_TYPE_NONE)
+    // flag the blocks whose bits are set in `mask' as showing `face', the
+    // blocks of the column being `stride' apart. Returns their number
+    static size_t MarkFaces(uint32_t mask, _face_t face, unsigned char* column, int stride)
+    {
+        size_t count = (size_t)bits::PopCount(mask);
+        while(mask != 0)
         {
-            return false;
+            column[bits::CountTrailingZeros(mask) * stride] |= (unsigned char)(1 << face);
+            mask &= mask - 1;
         }
+        return count;
+    }
 
-        _blocks[index] = _block_t(type, health);
-        return true;
+    // COPY-ON-WRITE
+    // a region of air blocks, NULL if the storage ran out
+    _region_t* NewRegion()
+    {
+        void* memory = _storage.Allocate();
+        if(memory == NULL)
+        {
+            std::cerr << "Could not allocate the blocks of a section" << std::endl;
+            return NULL;
+        }
+        return new(memory) _region_t();
     }
 
-    bool DeleteBlock(int x, int y, int z)
+    void FreeRegion(_region_t* region)
     {
-        int index = get_array_position(x, y, z);
-        if(_blocks[index].type != BLOCK_TYPE_NONE)
+        region->~_region_t();
+        _storage.Free(region);
+    }
+
+    // drop the world's reference to a region, it is freed once no
+    // snapshot holds it either
+    void ReleaseRegion(_region_t* region)
+    {
+        if(region == _air) {
+            return;
+        }
+        if(region->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            FreeRegion(region);
+        }
+        else
         {
-            return false;
+            _retired.push_back(region);
+            _region_stats.retired++;
         }
+    }
 
-        // more explicit, could use constructor with empty argument list as well
-        _blocks[index] = _block_t(BLOCK_TYPE_NONE, 0);
-        return true;
+    // free the retired regions snapshots are done with
+    void ReclaimRegions()
+    {
+        for(size_t i = 0; i < _retired.size(); )
+        {
+            if(_retired[i]->refs.load(std::memory_order_acquire) == 0)
+            {
+                FreeRegion(_retired[i]);
+                _retired[i] = _retired.back();
+                _retired.pop_back();
+                _region_stats.retired--;
+            }
+            else {
+                i++;
+            }
+        }
     }
 
-    // TODO: return something player can add to inventory..
-    void DecreaseBlockHealth(int x, int y, int z, int health_decrease)
+    // the blocks of a section to change, in a region no snapshot holds:
+    // new for a section of air, copied if shared. NULL if the storage ran
+    // out. The acquire sees the reads of released snapshots done
+    _block_t* WritableBlocks(int section)
     {
-        if(health_decrease < 0)
+        _region_t* region = _regions[section];
+        if(region == _air || region->refs.load(std::memory_order_acquire) > 1)
         {
-            std::cerr << "Decreasing block health with a negative amount!"
-                      << std::endl;
-            health_decrease = 0;
+            _region_t* copy = NewRegion();
+            if(copy == NULL) {
+                return NULL;
+            }
+            if(region != _air)
+            {
+                std::copy(region->blocks, region->blocks + SECTION_BLOCKS, copy->blocks);
+                _region_stats.copies++;
+            }
+            ReleaseRegion(region);
+            _regions[section] = copy;
+            region = copy;
         }
-        int index = get_array_position(x, y, z);
-        _blocks[index].health -= health_decrease;
+        region->version = ++_version;
+        return region->blocks;
+    }
+
+    void NotifyChange(int x0, int y0, int z0, int x1, int y1, int z1)
+    {
+        if(_listeners.empty()) {
+            return;
+        }
+        _world_change_t change;
+        change.min[0] = x0; change.min[1] = y0; change.min[2] = z0;
+        change.max[0] = x1; change.max[1] = y1; change.max[2] = z1;
+        for(size_t l = 0; l < _listeners.size(); l++) {
+            _listeners[l].second(change);
+        }
+    }
+
+    // BULK EDITS
+    // clamp an inclusive box to the world, false if nothing is left
+    bool ClampBox(int& x0, int& y0, int& z0, int& x1, int& y1, int& z1) const
+    {
+        x0 = std::max(x0, 0); x1 = std::min(x1, _width - 1);
+        y0 = std::max(y0, 0); y1 = std::min(y1, _height - 1);
+        z0 = std::max(z0, 0); z1 = std::min(z1, _depth - 1);
+        return x0 <= x1 && y0 <= y1 && z0 <= z1;
+    }
 
-        if(_blocks[index].health < 0)
+    // call `func(row, count, x)' for the blocks x0 to x1 of row (y, z) of a
+    // section, all at once where the layout keeps rows along x together
+    template<typename Block, typename Func>
+    void ForEachRow(Block* blocks, int x0, int x1, int y, int z, Func func)
+    {
+        const bool rows = block_layout::BLOCK_LAYOUT == block_layout::LAYOUT_XYZ ||
+                          block_layout::BLOCK_LAYOUT == block_layout::LAYOUT_XZY;
+        if(rows) {
+            func(&blocks[get_array_position(x0, y, z)], x1 - x0 + 1, x0);
+        }
+        else
         {
-            _blocks[index].type = BLOCK_TYPE_NONE;
+            for(int x = x0; x <= x1; x++) {
+                func(&blocks[get_array_position(x, y, z)], 1, x);
+            }
         }
     }
 
-    // VERY naive approach, but good enough for simple demonstration
-    void DrawBlocks(GLuint shader, int size)
+    // call `func(row, count, x, y, z)' for the rows of a clamped box in
+    // box order, x fastest, to read them
+    template<typename Func>
+    void ReadBox(int x0, int y0, int z0, int x1, int y1, int z1, Func func)
     {
-        glBindVertexArray(_VAO);
-        GLint model_loc = glGetUniformLocation(shader, "model");
+        for(int z = z0; z <= z1; z++)
+        {
+            for(int y = y0; y <= y1; y++)
+            {
+                // a section at a time along the row
+                for(int x = x0; x <= x1; x = (x / SECTION_SIZE + 1) * SECTION_SIZE)
+                {
+                    const _block_t* blocks = _regions[get_section(x, y, z)]->blocks;
+                    int end = std::min(x1, (x / SECTION_SIZE + 1) * SECTION_SIZE - 1);
+                    ForEachRow(blocks, x, end, y, z, [&](const _block_t* row, int count, int rx) {
+                        func(row, count, rx, y, z);
+                    });
+                }
+            }
+        }
+    }
 
-        for(int i = 0; i < _width; i++)
+    // call `func(row, count, x, y, z)' for the rows of a clamped box, a
+    // section at a time, on blocks no snapshot holds. Sections of air are
+    // skipped unless `allocate'. Every section is recounted afterwards
+    template<typename Func>
+    void EditBox(int x0, int y0, int z0, int x1, int y1, int z1, bool allocate, Func func)
+    {
+        for(int sz = z0 / SECTION_SIZE; sz <= z1 / SECTION_SIZE; sz++)
         {
-            for(int j = 0; j < _height; j++)
+            for(int sy = y0 / SECTION_SIZE; sy <= y1 / SECTION_SIZE; sy++)
             {
-                for(int k = 0; k < _width; k++)
+                for(int sx = x0 / SECTION_SIZE; sx <= x1 / SECTION_SIZE; sx++)
                 {
-                    if(_blocks[get_array_position(i, j, k)].type != BLOCK_TYPE_NONE)
+                    int section = (sz * _sections_y + sy) * _sections_x + sx;
+                    if(_regions[section] == _air && !allocate) {
+                        continue;
+                    }
+                    _block_t* blocks = WritableBlocks(section);
+                    if(blocks == NULL) {
+                        continue;
+                    }
+                    int bx0 = std::max(x0, sx * SECTION_SIZE);
+                    int by0 = std::max(y0, sy * SECTION_SIZE);
+                    int bz0 = std::max(z0, sz * SECTION_SIZE);
+                    int bx1 = std::min(x1, sx * SECTION_SIZE + SECTION_SIZE - 1);
+                    int by1 = std::min(y1, sy * SECTION_SIZE + SECTION_SIZE - 1);
+                    int bz1 = std::min(z1, sz * SECTION_SIZE + SECTION_SIZE - 1);
+                    for(int z = bz0; z <= bz1; z++)
                     {
-                        glm::mat4 model;
-                        model = glm::translate(model, glm::vec3(i*size,
-                                                                j*size,
-                                                                k*size));
-                        glUniformMatrix4fv(model_loc, 1, GL_FALSE, glm::value_ptr(model));
+                        for(int y = by0; y <= by1; y++)
+                        {
+                            ForEachRow(blocks, bx0, bx1, y, z, [&](_block_t* row, int count, int x) {
+                                func(row, count, x, y, z);
+                            });
+                            _dirty_stats.edits += bx1 - bx0 + 1;
+                        }
+                    }
+                    // borders of the section the edit reached
+                    const int last = SECTION_SIZE - 1;
+                    int borders = (bx0 % SECTION_SIZE == 0)    << FACE_NEG_X |
+                                  (bx1 % SECTION_SIZE == last) << FACE_POS_X |
+                                  (by0 % SECTION_SIZE == 0)    << FACE_NEG_Y |
+                                  (by1 % SECTION_SIZE == last) << FACE_POS_Y |
+                                  (bz0 % SECTION_SIZE == 0)    << FACE_NEG_Z |
+                                  (bz1 % SECTION_SIZE == last) << FACE_POS_Z;
+                    RecountSection(section, borders);
+                }
+            }
+        }
+    }
 
-                        glDrawArrays(GL_POINTS, 0, 1);
+    // after a bulk edit of a section: recount its blocks, random ticks and
+    // occupancy, and drop what was derived from it, and the meshes of the
+    // neighbours on the `borders' (a bit per `_face_t') the edit reached.
+    // Gives its storage back if only air is left
+    void RecountSection(int section, int borders)
+    {
+        const _block_t* blocks = _regions[section]->blocks;
+        _occupancy_t& o = _occupancy[section];
+        memset(&o, 0, sizeof(o));
+        int count = 0, random = 0;
+        for(int z = 0; z < SECTION_SIZE; z++)
+        {
+            for(int y = 0; y < SECTION_SIZE; y++)
+            {
+                for(int x = 0; x < SECTION_SIZE; x++)
+                {
+                    _block_type_t type = blocks[get_array_position(x, y, z)].type;
+                    random += receives_random_ticks(type);
+                    if(type != BLOCK_TYPE_NONE)
+                    {
+                        count++;
+                        o.x[y * SECTION_SIZE + z] |= (uint16_t)(1 << x);
+                        o.y[x * SECTION_SIZE + z] |= (uint16_t)(1 << y);
+                        o.z[x * SECTION_SIZE + y] |= (uint16_t)(1 << z);
                     }
+                }
+            }
+        }
+        _sections[section].blocks = count;
+        _section_random_blocks[section] = random;
+        if(count == 0)
+        {
+            ReleaseRegion(_regions[section]);
+            _regions[section] = _air;
+        }
+
+        _sections[section].stale = true;
+        _lod_built[section] = 0;
+        MarkDirty(section);
+        int sx = section % _sections_x;
+        int sy = (section / _sections_x) % _sections_y;
+        int sz = section / (_sections_x * _sections_y);
+        int layer = _sections_x * _sections_y;
+        if((borders & 1 << FACE_NEG_X) && sx > 0)                MarkDirty(section - 1);
+        if((borders & 1 << FACE_POS_X) && sx + 1 < _sections_x)  MarkDirty(section + 1);
+        if((borders & 1 << FACE_NEG_Y) && sy > 0)                MarkDirty(section - _sections_x);
+        if((borders & 1 << FACE_POS_Y) && sy + 1 < _sections_y)  MarkDirty(section + _sections_x);
+        if((borders & 1 << FACE_NEG_Z) && sz > 0)                MarkDirty(section - layer);
+        if((borders & 1 << FACE_POS_Z) && sz + 1 < _sections_z)  MarkDirty(section + layer);
+    }
 
+    // let the blocks on the surface of an edited box and right outside it
+    // react. Inside, with `inside', only falling blocks and fluids can
+    // react to what changed around them; without, the box is uniform
+    void NotifyBox(int x0, int y0, int z0, int x1, int y1, int z1, bool inside)
+    {
+        int ex0 = std::max(x0 - 1, 0), ex1 = std::min(x1 + 1, _width - 1);
+        int ey0 = std::max(y0 - 1, 0), ey1 = std::min(y1 + 1, _height - 1);
+        int ez0 = std::max(z0 - 1, 0), ez1 = std::min(z1 + 1, _depth - 1);
+        for(int z = ez0; z <= ez1; z++)
+        {
+            for(int y = ey0; y <= ey1; y++)
+            {
+                bool surface = z <= z0 || z >= z1 || y <= y0 || y >= y1;
+                for(int x = ex0; x <= ex1; x++)
+                {
+                    if(!surface && x > x0 && x < x1)
+                    {
+                        x = x1 - 1;
+                        continue;
+                    }
+                    OnNeighbourChanged(x, y, z);
                 }
             }
         }
+        if(!inside || x1 - x0 < 2 || y1 - y0 < 2 || z1 - z0 < 2) {
+            return;
+        }
+        ReadBox(x0 + 1, y0 + 1, z0 + 1, x1 - 1, y1 - 1, z1 - 1,
+                [&](const _block_t* row, int count, int x, int y, int z) {
+            for(int i = 0; i < count; i++)
+            {
+                if(is_fluid(row[i].type) || affected_by_gravity(row[i].type)) {
+                    OnNeighbourChanged(x + i, y, z);
+                }
+            }
+        });
+    }
 
-        glBindVertexArray(0);
+    // JOURNAL
+    unsigned Position(int x, int y, int z) const
+    {
+        return (unsigned)((z * _height + y) * _width + x);
+    }
+
+    // the blocks of a clamped box as runs, for the journal
+    void RecordRuns(int x0, int y0, int z0, int x1, int y1, int z1, EditJournal::Runs& runs)
+    {
+        ReadBox(x0, y0, z0, x1, y1, z1, [&](const _block_t* row, int count, int, int, int) {
+            runs.Add(row, count);
+        });
+    }
+
+    // record the blocks of a box before and after a bulk edit, while a
+    // transaction is open
+    void BeginBoxRecord(int x0, int y0, int z0, int x1, int y1, int z1)
+    {
+        if(_journal.Recording())
+        {
+            _box_before = EditJournal::Runs();
+            RecordRuns(x0, y0, z0, x1, y1, z1, _box_before);
+        }
+    }
+
+    void EndBoxRecord(int x0, int y0, int z0, int x1, int y1, int z1)
+    {
+        if(_journal.Recording())
+        {
+            EditJournal::Runs after;
+            RecordRuns(x0, y0, z0, x1, y1, z1, after);
+            int min[3] = { x0, y0, z0 }, max[3] = { x1, y1, z1 };
+            _journal.RecordBox(min, max, _box_before, after);
+        }
+    }
+
+    // set a box of a journal record to its runs of blocks
+    void ApplyRuns(const _journal_record_t& record, size_t first, size_t count)
+    {
+        const _journal_run_t* runs = &_journal_transaction.runs[first];
+        int width = record.max[0] - record.min[0] + 1;
+        int height = record.max[1] - record.min[1] + 1;
+        EditBox(record.min[0], record.min[1], record.min[2], record.max[0], record.max[1],
+                record.max[2], true, [&](_block_t* row, int n, int x, int y, int z) {
+            size_t start = ((size_t)(z - record.min[2]) * height + (y - record.min[1])) * width +
+                           (x - record.min[0]);
+            // the run holding the first block, then on along the row
+            size_t r = std::upper_bound(runs, runs + count, start,
+                                        [](size_t s, const _journal_run_t& run) {
+                                            return s < run.start;
+                                        }) - runs - 1;
+            for(size_t i = 0; i < (size_t)n; r++)
+            {
+                size_t end = r + 1 < count ? std::min((size_t)n, runs[r + 1].start - start) : n;
+                std::fill(row + i, row + end, runs[r].block);
+                i = end;
+            }
+        });
+        NotifyBox(record.min[0], record.min[1], record.min[2], record.max[0], record.max[1],
+                  record.max[2], true);
+        NotifyChange(record.min[0], record.min[1], record.min[2], record.max[0], record.max[1],
+                     record.max[2]);
+    }
+
+    void ApplyRecord(const _journal_record_t& record, bool undo)
+    {
+        if(record.kind == JOURNAL_BLOCK)
+        {
+            int x = (int)(record.position % _width);
+            int y = (int)(record.position / _width % _height);
+            int z = (int)(record.position / _width / _height);
+            SetBlock(x, y, z, undo ? record.before : record.after);
+        }
+        else if(undo) {
+            ApplyRuns(record, record.before_runs, record.run_count[0]);
+        }
+        else {
+            ApplyRuns(record, record.after_runs, record.run_count[1]);
+        }
+    }
+
+    void NotifyNeighbours(int x, int y, int z)
+    {
+        static const int offsets[6][3] = {
+            { 1, 0, 0 }, { -1, 0, 0 },
+            { 0, 1, 0 }, { 0, -1, 0 },
+            { 0, 0, 1 }, { 0, 0, -1 }
+        };
+        for(int i = 0; i < 6; i++)
+        {
+            int nx = x + offsets[i][0];
+            int ny = y + offsets[i][1];
+            int nz = z + offsets[i][2];
+            if(InBounds(nx, ny, nz))
+            {
+                _scheduler.Stats().neighbour_updates++;
+                OnNeighbourChanged(nx, ny, nz);
+            }
+        }
+    }
+
+    // a block itself or one next to it changed
+    void OnNeighbourChanged(int x, int y, int z)
+    {
+        _block_type_t type = block_at(x, y, z).type;
+
+        // fluids may flow into, or out of, the position
+        if(type == BLOCK_TYPE_NONE || is_fluid(type)) {
+            _fluids.Activate(x, y, z);
+        }
+
+        if(affected_by_gravity(type) && y > 0 && block_at(x, y - 1, z).type == BLOCK_TYPE_NONE)
+        {
+            _scheduler.Schedule(x, y, z, FALL_DELAY);
+        }
+    }
+
+    // a scheduled update became due
+    void OnScheduledTick(int x, int y, int z)
+    {
+        _block_t block = block_at(x, y, z);
+        if(affected_by_gravity(block.type) && y > 0 &&
+           block_at(x, y - 1, z).type == BLOCK_TYPE_NONE)
+        {
+            // moving the block notifies both positions, which keeps
+            // a falling column going
+            SetBlock(x, y, z, _block_t(BLOCK_TYPE_NONE, 0));
+            SetBlock(x, y - 1, z, block);
+        }
+    }
+
+    // the block was picked by random sampling of its section
+    void OnRandomTick(int x, int y, int z)
+    {
+        const _block_t& block = block_at(x, y, z);
+        if(block.type != BLOCK_TYPE_GRASS) {
+            return;
+        }
+
+        // grass dies when covered
+        if(y + 1 < _height && block_at(x, y + 1, z).type != BLOCK_TYPE_NONE)
+        {
+            SetBlock(x, y, z, _block_t(BLOCK_TYPE_EARTH, block.health));
+            return;
+        }
+
+        // and grows onto uncovered earth nearby
+        uint32_t r = _scheduler.NextRandom();
+        int nx = x + (int)(r % 3) - 1;
+        int ny = y + (int)((r >> 8) % 3) - 1;
+        int nz = z + (int)((r >> 16) % 3) - 1;
+        if(!InBounds(nx, ny, nz)) {
+            return;
+        }
+        const _block_t& neighbour = block_at(nx, ny, nz);
+        if(neighbour.type == BLOCK_TYPE_EARTH &&
+           (ny + 1 >= _height || block_at(nx, ny + 1, nz).type == BLOCK_TYPE_NONE))
+        {
+            SetBlock(nx, ny, nz, _block_t(BLOCK_TYPE_GRASS, neighbour.health));
+        }
+    }
+
+    // rescan the bounds, solid layers and connectivity of a section
+    // after changes
+    void UpdateSection(int section)
+    {
+        _section_t& s = _sections[section];
+        s.stale = false;
+        s.min[0] = s.min[1] = s.min[2] = 0;
+        s.max[0] = s.max[1] = s.max[2] = -1;
+        s.solid_layers = 0;
+        for(int f = 0; f < 6; f++) {
+            s.connected[f] = ALL_FACES;
+        }
+        if(s.blocks == 0) {
+            return;
+        }
+
+        const _block_t* blocks = _regions[section]->blocks;
+        int x0, y0, z0, x1, y1, z1;
+        SectionBlocks(section, x0, y0, z0, x1, y1, z1);
+        s.min[0] = x1; s.min[1] = y1; s.min[2] = z1;
+
+        bool solid_so_far = true;
+        for(int y = y0; y <= y1; y++)
+        {
+            bool layer_solid = true;
+            for(int z = z0; z <= z1; z++)
+            {
+                for(int x = x0; x <= x1; x++)
+                {
+                    _block_type_t type = blocks[get_array_position(x, y, z)].type;
+                    if(!is_solid(type)) {
+                        layer_solid = false;
+                    }
+                    if(type != BLOCK_TYPE_NONE)
+                    {
+                        s.min[0] = std::min(s.min[0], x); s.max[0] = std::max(s.max[0], x);
+                        s.min[1] = std::min(s.min[1], y); s.max[1] = std::max(s.max[1], y);
+                        s.min[2] = std::min(s.min[2], z); s.max[2] = std::max(s.max[2], z);
+                    }
+                }
+            }
+            solid_so_far = solid_so_far && layer_solid;
+            if(solid_so_far) {
+                s.solid_layers++;
+            }
+        }
+
+        UpdateConnectivity(section);
+    }
+
+    // flood fill the non-solid blocks of a section; the faces touched by
+    // one open area are connected to each other
+    void UpdateConnectivity(int section)
+    {
+        _section_t& s = _sections[section];
+        const _block_t* blocks = _regions[section]->blocks;
+        int x0, y0, z0, x1, y1, z1;
+        SectionBlocks(section, x0, y0, z0, x1, y1, z1);
+        int w = x1 - x0 + 1, h = y1 - y0 + 1, d = z1 - z0 + 1;
+
+        for(int f = 0; f < 6; f++) {
+            s.connected[f] = 0;
+        }
+
+        std::vector<bool> visited((size_t)w * h * d, false);
+        std::vector<int> stack;
+        for(int start = 0; start < w * h * d; start++)
+        {
+            if(visited[start] ||
+               is_solid(blocks[get_array_position(x0 + start % w, y0 + (start / w) % h,
+                                                  z0 + start / (w * h))].type)) {
+                continue;
+            }
+
+            unsigned char faces = 0;
+            visited[start] = true;
+            stack.push_back(start);
+            while(!stack.empty())
+            {
+                int cell = stack.back();
+                stack.pop_back();
+                int x = cell % w, y = (cell / w) % h, z = cell / (w * h);
+
+                if(x == 0)     faces |= 1 << FACE_NEG_X;
+                if(x == w - 1) faces |= 1 << FACE_POS_X;
+                if(y == 0)     faces |= 1 << FACE_NEG_Y;
+                if(y == h - 1) faces |= 1 << FACE_POS_Y;
+                if(z == 0)     faces |= 1 << FACE_NEG_Z;
+                if(z == d - 1) faces |= 1 << FACE_POS_Z;
+
+                static const int offsets[6][3] = {
+                    { -1, 0, 0 }, { 1, 0, 0 },
+                    { 0, -1, 0 }, { 0, 1, 0 },
+                    { 0, 0, -1 }, { 0, 0, 1 }
+                };
+                for(int i = 0; i < 6; i++)
+                {
+                    int nx = x + offsets[i][0];
+                    int ny = y + offsets[i][1];
+                    int nz = z + offsets[i][2];
+                    if(nx < 0 || nx >= w || ny < 0 || ny >= h || nz < 0 || nz >= d) {
+                        continue;
+                    }
+                    int n = (nz * h + ny) * w + nx;
+                    if(!visited[n] &&
+                       !is_solid(blocks[get_array_position(x0 + nx, y0 + ny, z0 + nz)].type))
+                    {
+                        visited[n] = true;
+                        stack.push_back(n);
+                    }
+                }
+            }
+
+            for(int f = 0; f < 6; f++) {
+                if(faces & (1 << f)) {
+                    s.connected[f] |= faces;
+                }
+            }
+        }
+    }
+
+    // merge the blocks of a section into cubes of 2^level blocks per axis.
+    // A cube takes the most common type of its blocks, and stays empty if
+    // most of them are. Cubes on the border of the section are filled as
+    // soon as any of their blocks is, so that next to a section of higher
+    // detail they overlap rather than leave cracks. Like blocks, cubes only
+    // show the faces not covered by another cube of the section, and cubes
+    // with none are left out
+    void BuildLod(int section, int level)
+    {
+        std::vector<_lod_cell_t>& cells = _lods[level - 1][section];
+        cells.clear();
+        _lod_built[section] |= 1 << (level - 1);
+        const _block_t* blocks = _regions[section]->blocks;
+
+        int x0, y0, z0, x1, y1, z1;
+        SectionBlocks(section, x0, y0, z0, x1, y1, z1);
+        int step = 1 << level;
+
+        for(int cz = z0; cz <= z1; cz += step)
+        {
+            for(int cy = y0; cy <= y1; cy += step)
+            {
+                for(int cx = x0; cx <= x1; cx += step)
+                {
+                    int counts[BLOCK_TYPE_NONE + 1] = { 0 };
+                    int total = 0;
+                    for(int z = cz; z < cz + step && z <= z1; z++) {
+                        for(int y = cy; y < cy + step && y <= y1; y++) {
+                            for(int x = cx; x < cx + step && x <= x1; x++)
+                            {
+                                counts[blocks[get_array_position(x, y, z)].type]++;
+                                total++;
+                            }
+                        }
+                    }
+
+                    int filled = total - counts[BLOCK_TYPE_NONE];
+                    bool border = cx == x0 || cy == y0 || cz == z0 ||
+                                  cx + step > x1 || cy + step > y1 || cz + step > z1;
+                    if(filled == 0 || (!border && 2 * filled < total)) {
+                        continue;
+                    }
+
+                    _lod_cell_t cell;
+                    cell.x = (short)cx;
+                    cell.y = (short)cy;
+                    cell.z = (short)cz;
+                    cell.type = BLOCK_TYPE_EARTH;
+                    int best = 0;
+                    for(int t = 0; t < BLOCK_TYPE_NONE; t++)
+                    {
+                        if(counts[t] > best)
+                        {
+                            best = counts[t];
+                            cell.type = (_block_type_t)t;
+                        }
+                    }
+                    cell.faces = ALL_FACES;
+                    cells.push_back(cell);
+                }
+            }
+        }
+
+        // the cube at every position of the section, -1 where it is empty
+        const int side = SECTION_SIZE / 2; // cubes per axis at level 1
+        int grid[side * side * side];
+        std::fill(grid, grid + side * side * side, -1);
+        for(size_t c = 0; c < cells.size(); c++)
+        {
+            int gx = (cells[c].x - x0) / step, gy = (cells[c].y - y0) / step;
+            int gz = (cells[c].z - z0) / step;
+            grid[(gz * side + gy) * side + gx] = (int)c;
+        }
+        int last[3] = { (x1 - x0) / step, (y1 - y0) / step, (z1 - z0) / step };
+        size_t kept = 0;
+        for(size_t c = 0; c < cells.size(); c++)
+        {
+            _lod_cell_t cell = cells[c];
+            int g[3] = { (cell.x - x0) / step, (cell.y - y0) / step, (cell.z - z0) / step };
+            for(int axis = 0; axis < 3; axis++)
+            {
+                // faces on the border of the section always show
+                for(int dir = -1; dir <= 1; dir += 2)
+                {
+                    int n[3] = { g[0], g[1], g[2] };
+                    n[axis] += dir;
+                    if(n[axis] < 0 || n[axis] > last[axis]) {
+                        continue;
+                    }
+                    if(grid[(n[2] * side + n[1]) * side + n[0]] >= 0) {
+                        cell.faces &= ~(1 << (2 * axis + (dir > 0)));
+                    }
+                }
+            }
+            if(cell.faces != 0) {
+                cells[kept++] = cell;
+            }
+        }
+        cells.resize(kept);
+    }
+
+    void RandomTicks()
+    {
+        for(int sz = 0; sz < _sections_z; sz++)
+        {
+            for(int sy = 0; sy < _sections_y; sy++)
+            {
+                for(int sx = 0; sx < _sections_x; sx++)
+                {
+                    int section = (sz * _sections_y + sy) * _sections_x + sx;
+                    if(_section_random_blocks[section] == 0) {
+                        continue;
+                    }
+
+                    for(int i = 0; i < RANDOM_TICK_SPEED; i++)
+                    {
+                        uint32_t r = _scheduler.NextRandom();
+                        int x = sx * SECTION_SIZE + (int)(r % SECTION_SIZE);
+                        int y = sy * SECTION_SIZE + (int)((r >> 8) % SECTION_SIZE);
+                        int z = sz * SECTION_SIZE + (int)((r >> 16) % SECTION_SIZE);
+                        if(InBounds(x, y, z))
+                        {
+                            _scheduler.Stats().random_ticks++;
+                            OnRandomTick(x, y, z);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+
+public:
+    GameWorld(int width, int height, int depth)
+        : _width(width), _height(height), _depth(depth),
+          _storage(sizeof(_region_t), true), _air(new _region_t()), _version(0),
+          _fluids(width, height, depth),
+          _next_listener(0), _face_culling(true), _lod_distance(0), _stream(NULL),
+          _meshes(NULL), _persistent_stream(true), _gpu_culling(NULL),
+          _use_gpu_culling(true), _dirty_count(0), _rebuild_budget(DIRTY_REBUILD_BUDGET)
+    {
+        // all blocks start out as `BLOCK_TYPE_NONE', without storage
+        _sections_x = (_width + SECTION_SIZE - 1) / SECTION_SIZE;
+        _sections_y = (_height + SECTION_SIZE - 1) / SECTION_SIZE;
+        _sections_z = (_depth + SECTION_SIZE - 1) / SECTION_SIZE;
+        _section_random_blocks.resize(_sections_x * _sections_y * _sections_z, 0);
+        _sections.resize(_sections_x * _sections_y * _sections_z);
+        _occupancy.resize(_sections.size());
+        _faces.resize(SECTION_BLOCKS);
+        _regions.resize(_sections.size(), _air);
+        for(int l = 0; l < LOD_LEVELS; l++) {
+            _lods[l].resize(_sections.size());
+        }
+        _lod_built.resize(_sections.size(), 0);
+        _section_meshes.resize(_sections.size(), -1);
+        _mesh_levels.resize(_sections.size(), 0);
+        _mesh_faces.resize(_sections.size(), 0);
+        _mesh_built.resize(_sections.size(), false);
+        _dirty_flags.resize(_sections.size(), false);
+        _dirty_listed.resize(_sections.size(), false);
+    }
+
+    ~GameWorld()
+    {
+        if(_meshes != NULL)
+        {
+            delete _gpu_culling;
+            delete _meshes;
+            delete _stream;
+        }
+        // snapshots would read unmapped storage
+        ReclaimRegions();
+        bool snapshots = !_retired.empty() || _air->refs.load() > 1;
+        for(size_t s = 0; s < _regions.size(); s++) {
+            snapshots = snapshots || _regions[s]->refs.load() > 1;
+        }
+        if(snapshots) {
+            std::cerr << "GameWorld destroyed while snapshots of it are alive" << std::endl;
+        }
+        delete _air;
+    }
+
+    // return false if there is already a block at the desired entry
+    //
+    // TODO: block health might be set automatically within this method
+    // according to block type
+    bool InsertBlock(int x, int y, int z, _block_type_t type, int health = 10)
+    {
+        if(health < 1)
+        {
+            std::cerr << "Inserting block with health < 1" << std::endl;
+            health = 10;
+        }
+
+        if(block_at(x, y, z).type != BLOCK_TYPE_NONE)
+        {
+            return false;
+        }
+
+        _block_t block(type, health);
+        if(is_fluid(type)) {
+            block.level = FLUID_SOURCE;
+        }
+        SetBlock(x, y, z, block);
+        return true;
+    }
+
+    // return false if there is no block at the desired entry
+    bool DeleteBlock(int x, int y, int z)
+    {
+        if(block_at(x, y, z).type == BLOCK_TYPE_NONE)
+        {
+            return false;
+        }
+
+        // more explicit, could use constructor with empty argument list as well
+        SetBlock(x, y, z, _block_t(BLOCK_TYPE_NONE, 0));
+        return true;
+    }
+
+    // TODO: return something player can add to inventory..
+    void DecreaseBlockHealth(int x, int y, int z, int health_decrease)
+    {
+        if(health_decrease < 0)
+        {
+            std::cerr << "Decreasing block health with a negative amount!"
+                      << std::endl;
+            health_decrease = 0;
+        }
+        // nothing to damage in a section of air or at an empty position, and
+        // no damage changes nothing: neither copies the section's region
+        int section = get_section(x, y, z);
+        int index = get_array_position(x, y, z);
+        if(health_decrease == 0 || _regions[section] == _air ||
+           _regions[section]->blocks[index].type == BLOCK_TYPE_NONE) {
+            return;
+        }
+        _block_t* blocks = WritableBlocks(section);
+        if(blocks == NULL) {
+            return;
+        }
+        _block_t& block = blocks[index];
+        if(block.health - health_decrease < 0)
+        {
+            SetBlock(x, y, z, _block_t(BLOCK_TYPE_NONE, 0));
+            return;
+        }
+        if(_journal.Recording())
+        {
+            _block_t damaged = block;
+            damaged.health -= health_decrease;
+            _journal.RecordBlock(Position(x, y, z), block, damaged);
+        }
+        block.health -= health_decrease;
+        _dirty_stats.edits++;
+        NotifyChange(x, y, z, x, y, z);
+    }
+
+    // every block change goes through here, so the section counters stay
+    // in sync and the neighbours get to react. Unlike `InsertBlock' this
+    // overwrites whatever is at the position
+    void SetBlock(int x, int y, int z, const _block_t& block)
+    {
+        int section = get_section(x, y, z);
+        int index = get_array_position(x, y, z);
+        _block_t old = _regions[section]->blocks[index];
+        // air on air, or the same block again, changes nothing and copies
+        // no region
+        if((_regions[section] == _air && block.type == BLOCK_TYPE_NONE) ||
+           (old.type == block.type && old.health == block.health && old.level == block.level)) {
+            return;
+        }
+        _block_t* blocks = WritableBlocks(section);
+        if(blocks == NULL) {
+            return;
+        }
+        blocks[index] = block;
+        _dirty_stats.edits++;
+        if(_journal.Recording()) {
+            _journal.RecordBlock(Position(x, y, z), old, block);
+        }
+
+        if(old.type != block.type || old.level != block.level)
+        {
+            _block_type_t old_type = old.type;
+            if(receives_random_ticks(old_type)) {
+                _section_random_blocks[section]--;
+            }
+            if(receives_random_ticks(block.type)) {
+                _section_random_blocks[section]++;
+            }
+            if(old_type == BLOCK_TYPE_NONE) {
+                _sections[section].blocks++;
+            }
+            if((old_type == BLOCK_TYPE_NONE) != (block.type == BLOCK_TYPE_NONE)) {
+                SetOccupied(section, x, y, z, block.type != BLOCK_TYPE_NONE);
+            }
+            if(block.type == BLOCK_TYPE_NONE && --_sections[section].blocks == 0)
+            {
+                // only air left
+                ReleaseRegion(_regions[section]);
+                _regions[section] = _air;
+            }
+            if(old_type != block.type)
+            {
+                _sections[section].stale = true;
+                _lod_built[section] = 0;
+                MarkDirty(section);
+            }
+
+            OnNeighbourChanged(x, y, z);
+            NotifyNeighbours(x, y, z);
+        }
+        NotifyChange(x, y, z, x, y, z);
+    }
+
+    bool InBounds(int x, int y, int z) const
+    {
+        return x >= 0 && x < _width && y >= 0 && y < _height && z >= 0 && z < _depth;
+    }
+
+    _block_type_t GetBlockType(int x, int y, int z)
+    {
+        return block_at(x, y, z).type;
+    }
+
+    const _block_t& BlockAt(int x, int y, int z)
+    {
+        return block_at(x, y, z);
+    }
+
+    // advance the world by one game tick: run the due block updates (at
+    // most the scheduler's budget), then the random ticks of every section
+    // holding blocks that care about them, then let the fluids flow
+    void Tick()
+    {
+        _tick_dirty_stats = _dirty_stats;
+        _tick_dirty_stats.pending = _dirty_count;
+        _dirty_stats = _dirty_stats_t();
+
+        _scheduler.BeginTick();
+        {
+            PROFILE_SCOPE("scheduled ticks");
+            _scheduler.RunDue([this](int x, int y, int z) {
+                OnScheduledTick(x, y, z);
+            });
+        }
+        {
+            PROFILE_SCOPE("random ticks");
+            RandomTicks();
+        }
+        {
+            PROFILE_SCOPE("fluids");
+            _fluids.Step(*this);
+        }
+
+        // regions snapshots let go of, and slabs left empty by sections
+        // that ran out of blocks
+        ReclaimRegions();
+        _storage.Trim(SPARE_STORAGE_SLABS);
+    }
+
+    // counters of the most recent tick
+    const ticks::_tick_stats_t& TickStats()
+    {
+        return _scheduler.Stats();
+    }
+
+    ticks::TickScheduler& Scheduler()
+    {
+        return _scheduler;
+    }
+
+    // counters of the most recent fluid step
+    const _fluid_stats_t& FluidStats()
+    {
+        return _fluids.Stats();
+    }
+
+    // counters of the most recent `DrawBlocks'
+    const _draw_stats_t& DrawStats()
+    {
+        return _draw_stats;
+    }
+
+    // slabs and sections of the block storage
+    const slab_pool::_slab_pool_stats_t& StorageStats() const
+    {
+        return _storage.Stats();
+    }
+
+    // BULK EDITS
+    // Boxes of blocks, inclusive and clamped to the world, edited a section
+    // at a time: rows are filled and copied with plain loops the compiler
+    // vectorises, every section touched is recounted once, and listeners
+    // hear of one change for the whole box. Only the blocks on the surface
+    // of the box and next to it are told about the edit, plus falling
+    // blocks and fluids inside it
+
+    // set every block of a box
+    void FillBox(int x0, int y0, int z0, int x1, int y1, int z1, const _block_t& block)
+    {
+        if(!ClampBox(x0, y0, z0, x1, y1, z1)) {
+            return;
+        }
+        BeginBoxRecord(x0, y0, z0, x1, y1, z1);
+        EditBox(x0, y0, z0, x1, y1, z1, block.type != BLOCK_TYPE_NONE,
+                [&](_block_t* row, int count, int, int, int) {
+            std::fill(row, row + count, block);
+        });
+        EndBoxRecord(x0, y0, z0, x1, y1, z1);
+        NotifyBox(x0, y0, z0, x1, y1, z1, false);
+        NotifyChange(x0, y0, z0, x1, y1, z1);
+    }
+
+    // set the blocks of type `from' within a box to `to'
+    void ReplaceInBox(int x0, int y0, int z0, int x1, int y1, int z1, _block_type_t from,
+                      const _block_t& to)
+    {
+        if(!ClampBox(x0, y0, z0, x1, y1, z1) || from == to.type) {
+            return;
+        }
+        BeginBoxRecord(x0, y0, z0, x1, y1, z1);
+        EditBox(x0, y0, z0, x1, y1, z1, from == BLOCK_TYPE_NONE,
+                [&](_block_t* row, int count, int, int, int) {
+            for(int i = 0; i < count; i++) {
+                row[i] = row[i].type == from ? to : row[i];
+            }
+        });
+        EndBoxRecord(x0, y0, z0, x1, y1, z1);
+        NotifyBox(x0, y0, z0, x1, y1, z1, true);
+        NotifyChange(x0, y0, z0, x1, y1, z1);
+    }
+
+    // the blocks of a box, clamped to the world, into `clipboard'
+    void CopyBox(int x0, int y0, int z0, int x1, int y1, int z1, Clipboard& clipboard)
+    {
+        if(!ClampBox(x0, y0, z0, x1, y1, z1))
+        {
+            clipboard = Clipboard();
+            return;
+        }
+        clipboard = Clipboard(x1 - x0 + 1, y1 - y0 + 1, z1 - z0 + 1);
+        ReadBox(x0, y0, z0, x1, y1, z1, [&](const _block_t* row, int count, int x, int y, int z) {
+            std::copy(row, row + count, &clipboard.At(x - x0, y - y0, z - z0));
+        });
+    }
+
+    // a clipboard with its lowest corner at (x, y, z), turned about the y
+    // axis by `quarter_turns' first (see `Clipboard::Rotated'). Whatever
+    // falls outside the world is left out; so is air with `skip_air'
+    void Paste(const Clipboard& clipboard, int x, int y, int z, int quarter_turns = 0,
+               bool skip_air = false)
+    {
+        if(quarter_turns % 4 != 0)
+        {
+            Paste(clipboard.Rotated(quarter_turns), x, y, z, 0, skip_air);
+            return;
+        }
+        int x0 = x, y0 = y, z0 = z;
+        int x1 = x + clipboard.Width() - 1;
+        int y1 = y + clipboard.Height() - 1;
+        int z1 = z + clipboard.Depth() - 1;
+        if(clipboard.Empty() || !ClampBox(x0, y0, z0, x1, y1, z1)) {
+            return;
+        }
+        BeginBoxRecord(x0, y0, z0, x1, y1, z1);
+        EditBox(x0, y0, z0, x1, y1, z1, true,
+                [&](_block_t* row, int count, int rx, int ry, int rz) {
+            const _block_t* source = &clipboard.At(rx - x, ry - y, rz - z);
+            if(skip_air)
+            {
+                for(int i = 0; i < count; i++) {
+                    row[i] = source[i].type != BLOCK_TYPE_NONE ? source[i] : row[i];
+                }
+            }
+            else {
+                std::copy(source, source + count, row);
+            }
+        });
+        EndBoxRecord(x0, y0, z0, x1, y1, z1);
+        NotifyBox(x0, y0, z0, x1, y1, z1, true);
+        NotifyChange(x0, y0, z0, x1, y1, z1);
+    }
+
+    // UNDO AND REDO
+    // The changes made between `BeginEdit' and `EndEdit' are recorded in
+    // the journal as one transaction, blocks changed in bulk as boxes.
+    // Changes outside of an edit, like generating the world or the
+    // simulation running between edits, are not recorded, so undoing
+    // only restores the blocks an edit changed
+    void BeginEdit()
+    {
+        _journal.Begin();
+    }
+
+    void EndEdit()
+    {
+        _journal.End();
+    }
+
+    // restore the blocks before the most recent edit, false if there is
+    // none or an edit is open
+    bool Undo()
+    {
+        if(!_journal.Undo(_journal_transaction)) {
+            return false;
+        }
+        for(size_t r = _journal_transaction.records.size(); r-- > 0; ) {
+            ApplyRecord(_journal_transaction.records[r], true);
+        }
+        return true;
+    }
+
+    // make the most recently undone edit again
+    bool Redo()
+    {
+        if(!_journal.Redo(_journal_transaction)) {
+            return false;
+        }
+        for(size_t r = 0; r < _journal_transaction.records.size(); r++) {
+            ApplyRecord(_journal_transaction.records[r], false);
+        }
+        return true;
+    }
+
+    // for its memory cap, spill file and stats
+    EditJournal& Journal()
+    {
+        return _journal;
+    }
+
+    // CHANGE NOTIFICATIONS
+    // `listener' is called with the box of blocks that changed, after
+    // every block `SetBlock' or `DecreaseBlockHealth' changed and once per
+    // bulk edit. Returns an id for `RemoveChangeListener'
+    int AddChangeListener(const std::function<void(const _world_change_t&)>& listener)
+    {
+        _listeners.push_back(std::make_pair(_next_listener, listener));
+        return _next_listener++;
+    }
+
+    void RemoveChangeListener(int id)
+    {
+        for(size_t l = 0; l < _listeners.size(); l++)
+        {
+            if(_listeners[l].first == id)
+            {
+                _listeners.erase(_listeners.begin() + l);
+                return;
+            }
+        }
+    }
+
+    // SNAPSHOTS
+    // the blocks as they are now, to be read on other threads while this
+    // one goes on changing them, see WorldSnapshot. Call on the thread
+    // that changes the world
+    WorldSnapshot Snapshot()
+    {
+        ReclaimRegions();
+        return WorldSnapshot(_width, _height, _depth, _sections_x, _sections_y, _regions,
+                             _version);
+    }
+
+    // counts the changes of blocks so far
+    unsigned Version() const
+    {
+        return _version;
+    }
+
+    // regions copied for snapshots, and waiting for them to be released
+    const _region_stats_t& RegionStats()
+    {
+        ReclaimRegions();
+        return _region_stats;
+    }
+
+    // SECTIONS
+    // sections are cubes of SECTION_SIZE blocks, numbered x fastest
+    int SectionCount() const
+    {
+        return (int)_sections.size();
+    }
+
+    // block count, bounds, solid layers and connectivity of a section
+    const _section_t& Section(int section)
+    {
+        if(_sections[section].stale) {
+            UpdateSection(section);
+        }
+        return _sections[section];
+    }
+
+    int SectionsX() const { return _sections_x; }
+    int SectionsY() const { return _sections_y; }
+    int SectionsZ() const { return _sections_z; }
+
+    // section holding a block, -1 outside the world
+    int SectionAt(int x, int y, int z)
+    {
+        return InBounds(x, y, z) ? get_section(x, y, z) : -1;
+    }
+
+    // inclusive range of blocks a section spans, clamped to the world
+    void SectionBlocks(int section, int& x0, int& y0, int& z0, int& x1, int& y1, int& z1) const
+    {
+        int sx = section % _sections_x;
+        int sy = (section / _sections_x) % _sections_y;
+        int sz = section / (_sections_x * _sections_y);
+        x0 = sx * SECTION_SIZE; x1 = std::min(x0 + SECTION_SIZE, _width) - 1;
+        y0 = sy * SECTION_SIZE; y1 = std::min(y0 + SECTION_SIZE, _height) - 1;
+        z0 = sz * SECTION_SIZE; z1 = std::min(z0 + SECTION_SIZE, _depth) - 1;
+    }
+
+    // FACE CULLING
+    // visible faces of every block of a section, a column at a time from
+    // the occupancy bits: a face shows where the next block along its
+    // axis is air, in this section or the neighbouring one, or outside the
+    // world. `faces' receives SECTION_BLOCKS masks of (1 << _face_t), x
+    // fastest, then y, then z. Returns the number of visible faces
+    size_t SectionFaces(int section, unsigned char* faces) const
+    {
+        memset(faces, 0, SECTION_BLOCKS);
+        int sx = section % _sections_x;
+        int sy = (section / _sections_x) % _sections_y;
+        int sz = section / (_sections_x * _sections_y);
+        int layer = _sections_x * _sections_y;
+        const _occupancy_t& o = _occupancy[section];
+        const _occupancy_t* neg_x = sx > 0 ? &_occupancy[section - 1] : NULL;
+        const _occupancy_t* pos_x = sx + 1 < _sections_x ? &_occupancy[section + 1] : NULL;
+        const _occupancy_t* neg_y = sy > 0 ? &_occupancy[section - _sections_x] : NULL;
+        const _occupancy_t* pos_y = sy + 1 < _sections_y ? &_occupancy[section + _sections_x] : NULL;
+        const _occupancy_t* neg_z = sz > 0 ? &_occupancy[section - layer] : NULL;
+        const _occupancy_t* pos_z = sz + 1 < _sections_z ? &_occupancy[section + layer] : NULL;
+
+        // a block is hidden towards -axis if the bit below it is set, i.e.
+        // in the column shifted up by one, with the last block of the
+        // neighbour shifted in; towards +axis likewise
+        const int S = SECTION_SIZE, last = SECTION_SIZE - 1;
+        size_t visible = 0;
+        for(int a = 0; a < S; a++)
+        {
+            for(int b = 0; b < S; b++)
+            {
+                int c = a * S + b;
+                uint32_t column = o.x[c];
+                if(column != 0)
+                {
+                    uint32_t below = neg_x != NULL ? (uint32_t)neg_x->x[c] >> last : 0;
+                    uint32_t above = pos_x != NULL ? ((uint32_t)pos_x->x[c] & 1) << last : 0;
+                    unsigned char* row = faces + (b * S + a) * S;
+                    visible += MarkFaces(column & ~(column << 1 | below), FACE_NEG_X, row, 1);
+                    visible += MarkFaces(column & ~(column >> 1 | above), FACE_POS_X, row, 1);
+                }
+                column = o.y[c];
+                if(column != 0)
+                {
+                    uint32_t below = neg_y != NULL ? (uint32_t)neg_y->y[c] >> last : 0;
+                    uint32_t above = pos_y != NULL ? ((uint32_t)pos_y->y[c] & 1) << last : 0;
+                    unsigned char* row = faces + b * S * S + a;
+                    visible += MarkFaces(column & ~(column << 1 | below), FACE_NEG_Y, row, S);
+                    visible += MarkFaces(column & ~(column >> 1 | above), FACE_POS_Y, row, S);
+                }
+                column = o.z[c];
+                if(column != 0)
+                {
+                    uint32_t below = neg_z != NULL ? (uint32_t)neg_z->z[c] >> last : 0;
+                    uint32_t above = pos_z != NULL ? ((uint32_t)pos_z->z[c] & 1) << last : 0;
+                    unsigned char* row = faces + b * S + a;
+                    visible += MarkFaces(column & ~(column << 1 | below), FACE_NEG_Z, row, S * S);
+                    visible += MarkFaces(column & ~(column >> 1 | above), FACE_POS_Z, row, S * S);
+                }
+            }
+        }
+        return visible;
+    }
+
+    // draw only the faces not hidden behind a neighbour (the default), or
+    // all faces of every block, e.g. to compare both
+    void SetFaceCulling(bool enabled)
+    {
+        if(enabled != _face_culling) {
+            std::fill(_mesh_built.begin(), _mesh_built.end(), false);
+        }
+        _face_culling = enabled;
+    }
+
+    bool FaceCulling() const
+    {
+        return _face_culling;
+    }
+
+    // LEVELS OF DETAIL
+    // sections at least `blocks' away are drawn with merged blocks, 0 turns
+    // this off. Every further level starts at twice the distance
+    void SetLodDistance(int blocks)
+    {
+        _lod_distance = blocks;
+    }
+
+    int LodDistance() const
+    {
+        return _lod_distance;
+    }
+
+    // merged blocks of a section at `level' (1 to LOD_LEVELS)
+    const std::vector<_lod_cell_t>& SectionLod(int section, int level)
+    {
+        if(!(_lod_built[section] & (1 << (level - 1)))) {
+            BuildLod(section, level);
+        }
+        return _lods[level - 1][section];
+    }
+
+    // level of detail of every section for a camera at `camera', in world
+    // units with blocks `size' apart
+    void SelectLods(const glm::vec3& camera, float size, std::vector<unsigned char>& levels)
+    {
+        levels.assign(_sections.size(), 0);
+        if(_lod_distance <= 0) {
+            return;
+        }
+        glm::vec3 eye = camera / size;
+        for(int s = 0; s < SectionCount(); s++)
+        {
+            float distance = SectionDistance(s, eye);
+
+            int level = 0;
+            float next = (float)_lod_distance;
+            while(level < LOD_LEVELS && distance >= next)
+            {
+                level++;
+                next *= 2.0f;
+            }
+            levels[s] = (unsigned char)level;
+        }
+    }
+
+    // DIRTY SECTIONS
+    // let the dirty sections nearest to `camera' (in world units, with
+    // blocks `size' units wide) be rebuilt when they are drawn next, at
+    // most the rebuild budget of them. Call once a frame before `DrawBlocks'
+    void RebuildDirty(const glm::vec3& camera, float size)
+    {
+        // drop sections rebuilt anyway, e.g. at another level of detail
+        size_t kept = 0;
+        for(size_t d = 0; d < _dirty.size(); d++)
+        {
+            if(_dirty_flags[_dirty[d]]) {
+                _dirty[kept++] = _dirty[d];
+            }
+            else {
+                _dirty_listed[_dirty[d]] = false;
+            }
+        }
+        _dirty.resize(kept);
+
+        size_t count = _dirty.size();
+        if(_rebuild_budget > 0 && (size_t)_rebuild_budget < count)
+        {
+            // the nearest sections first, by the distance to their boxes
+            glm::vec3 eye = camera / size;
+            std::nth_element(_dirty.begin(), _dirty.begin() + _rebuild_budget, _dirty.end(),
+                             [&](int a, int b) {
+                                 return SectionDistance(a, eye) < SectionDistance(b, eye);
+                             });
+            count = _rebuild_budget;
+        }
+        for(size_t d = 0; d < count; d++)
+        {
+            _dirty_flags[_dirty[d]] = false;
+            _dirty_listed[_dirty[d]] = false;
+            _mesh_built[_dirty[d]] = false;
+        }
+        _dirty.erase(_dirty.begin(), _dirty.begin() + count);
+        _dirty_count = _dirty.size();
+    }
+
+    // distance in blocks from `eye', in blocks too, to a section's box
+    float SectionDistance(int section, const glm::vec3& eye) const
+    {
+        int x0, y0, z0, x1, y1, z1;
+        SectionBlocks(section, x0, y0, z0, x1, y1, z1);
+        glm::vec3 min = glm::vec3(x0, y0, z0) - 0.5f;
+        glm::vec3 max = glm::vec3(x1, y1, z1) + 0.5f;
+        return glm::length(glm::clamp(eye, min, max) - eye);
+    }
+
+    // sections rebuilt per `RebuildDirty', 0 for all of them
+    void SetRebuildBudget(int sections)
+    {
+        _rebuild_budget = std::max(sections, 0);
+    }
+
+    int RebuildBudget() const
+    {
+        return _rebuild_budget;
+    }
+
+    // sections drawn with out of date meshes
+    size_t DirtyCount() const
+    {
+        return _dirty_count;
+    }
+
+    bool SectionDirty(int section) const
+    {
+        return _dirty_flags[section];
+    }
+
+    // edits, sections they made dirty and meshes built during the last tick,
+    // from one `Tick' to the next
+    const _dirty_stats_t& DirtyStats() const
+    {
+        return _tick_dirty_stats;
+    }
+
+    // map the stream buffer persistently where supported (the default),
+    // or orphan it. Only takes effect before the first `DrawBlocks'
+    void SetPersistentStream(bool persistent)
+    {
+        _persistent_stream = persistent;
+    }
+
+    // whether the stream buffer really is mapped persistently
+    bool PersistentStream() const
+    {
+        return _stream != NULL ? _stream->Persistent() : _persistent_stream;
+    }
+
+    // uploads of the most recent `DrawBlocks', NULL before the first
+    const stream_buffer::_stream_stats_t* StreamStats() const
+    {
+        return _stream != NULL ? &_stream->LastFrame() : NULL;
+    }
+
+    // cull and draw on the GPU where OpenGL 4.3 is available (the
+    // default). Only takes effect before the first `DrawBlocks'
+    void SetGpuCulling(bool enabled)
+    {
+        _use_gpu_culling = enabled;
+    }
+
+    // whether `DrawBlocks' given a view projection culls on the GPU, once
+    // the culling shader is built
+    bool GpuCullingActive() const
+    {
+        return _gpu_culling != NULL && _gpu_culling->Supported();
+    }
+
+    // create the buffers for drawing, and submit the culling shader to be
+    // built in the background, ahead of the first `DrawBlocks'
+    void PrepareDrawing()
+    {
+        if(_meshes == NULL) {
+            BufferVertexData();
+        }
+    }
+
+    // wait until the culling shader is built, false if there is none
+    bool WaitForGpuCulling()
+    {
+        PrepareDrawing();
+        return _gpu_culling != NULL && _gpu_culling->Wait();
+    }
+
+    // packing of the section meshes, NULL before the first `DrawBlocks'
+    const mesh_buffer::MeshBuffer* Meshes() const
+    {
+        return _meshes;
+    }
+
+    // Every drawn section keeps a mesh of its block positions, leaving out
+    // blocks without visible faces, rebuilt after it changed (once
+    // `RebuildDirty' got to it), and all meshes of a level of detail are
+    // drawn with one glMultiDrawArrays per mesh buffer page.
+    // With `visible', sections whose entry is false are skipped. With
+    // `lods', sections are drawn at the given level of detail. With
+    // `view_projection', sections are frustum culled on the GPU and drawn
+    // indirectly, if supported; the stats then count what was submitted
+    void DrawBlocks(GLuint shader, int size, const std::vector<bool>* visible = NULL,
+                    const std::vector<unsigned char>* lods = NULL,
+                    const glm::mat4* view_projection = NULL)
+    {
+        if(_meshes == NULL) {
+            BufferVertexData();
+        }
+        _draw_stats = _draw_stats_t();
+        bool gpu_culling = view_projection != NULL && _gpu_culling != NULL &&
+                           _gpu_culling->Ready();
+
+        // meshes to draw per level, and their bounds for GPU culling
+        frame_arena::Scope scope;
+        frame_arena::Vector<int> draw_lists[LOD_LEVELS + 1];
+        frame_arena::Vector<glm::vec3> draw_bounds[LOD_LEVELS + 1];
+        {
+            PROFILE_SCOPE("section meshes");
+            for(int s = 0; s < SectionCount(); s++)
+            {
+                if(_sections[s].blocks == 0 || (visible != NULL && !(*visible)[s])) {
+                    continue;
+                }
+                int level = (lods != NULL) ? (*lods)[s] : 0;
+                int mesh = SectionMesh(s, level);
+                if(mesh < 0) {
+                    continue;
+                }
+                draw_lists[level].push_back(mesh);
+                if(gpu_culling)
+                {
+                    // merged cubes may reach past the blocks of the section
+                    int x0, y0, z0, x1, y1, z1;
+                    if(level > 0)
+                    {
+                        SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+                        x1 += 1 << level;
+                        y1 += 1 << level;
+                        z1 += 1 << level;
+                    }
+                    else
+                    {
+                        const _section_t& section = Section(s);
+                        x0 = section.min[0]; y0 = section.min[1]; z0 = section.min[2];
+                        x1 = section.max[0]; y1 = section.max[1]; z1 = section.max[2];
+                    }
+                    draw_bounds[level].push_back((glm::vec3(x0, y0, z0) - 0.5f) * (float)size);
+                    draw_bounds[level].push_back((glm::vec3(x1, y1, z1) + 0.5f) * (float)size);
+                }
+                if(level > 0) {
+                    _draw_stats.lod_cells += _meshes->Mesh(mesh).count;
+                }
+                else {
+                    _draw_stats.blocks += _meshes->Mesh(mesh).count;
+                }
+                _draw_stats.triangles += 2 * _mesh_faces[s];
+            }
+        }
+
+        // meshes are in blocks
+        GLint size_loc = glGetUniformLocation(shader, "sz");
+        glm::mat4 model = glm::scale(glm::mat4(), glm::vec3((float)size));
+        glUniformMatrix4fv(glGetUniformLocation(shader, "model"), 1, GL_FALSE,
+                           glm::value_ptr(model));
+        for(int l = 0; l <= LOD_LEVELS; l++)
+        {
+            if(draw_lists[l].empty()) {
+                continue;
+            }
+            glUniform1f(size_loc, (1 << l) / 2.0f);
+            if(gpu_culling)
+            {
+                _gpu_culling->SetViewProjection(*view_projection);
+                _draw_stats.draw_calls += _gpu_culling->Draw(*_meshes, &draw_lists[l][0],
+                                                             draw_lists[l].size(),
+                                                             &draw_bounds[l][0]);
+            }
+            else {
+                _draw_stats.draw_calls += _meshes->Draw(&draw_lists[l][0], draw_lists[l].size());
+            }
+        }
+        glUniform1f(size_loc, size / 2.0f);
+
+        _meshes->Defragment();
+        _stream->EndFrame();
     }
 };
+
+#endif // GAME_WORLD_HPP
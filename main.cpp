@@ -16,10 +16,26 @@
 
 // CUSTOM
 #include "engine/shaders.hpp"
+#include "engine/program_cache.hpp"
 #include "engine/window.hpp"
 #include "engine/texture.hpp"
 #include "engine/camera.hpp"
+#include "engine/timer.hpp"
+#include "engine/profiler.hpp"
+#include "engine/gpu_timer.hpp"
+#include "engine/frame_stats.hpp"
+#include "engine/frame_arena.hpp"
+#include "engine/alloc_counter.hpp"
 #include "game_world.hpp"
+#include "world_generator.hpp"
+#include "world_culling.hpp"
+
+// STANDARD
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
 
 
 
@@ -32,11 +48,64 @@ void do_movement(GLfloat deltaTime);
 // VARIABLES
 camera::BasicFPSCamera* fps_cam;
 
+// when set, the blocks are drawn a second time with rasterization
+// discarded, so the GPU timings tell vertex/geometry shading apart from
+// fragment work (toggled with G)
+bool gpu_stage_split = false;
+
+// skip sections hidden behind terrain or outside the view (toggled with O)
+bool occlusion_culling = true;
+
+// draw sections past an eighth of the view distance with merged blocks,
+// further levels of detail start at twice the distance each, so all
+// LOD_LEVELS of them show before the far plane. Views too short for that
+// to start LOD_MIN_DISTANCE blocks away draw full detail only, as merged
+// cubes would replace the terrain right in front of the player (toggled
+// with L)
+#define LOD_DISTANCE_DIVISOR 8
+#define LOD_MIN_DISTANCE 16
+bool level_of_detail = true;
+
 // GAME WORLD
 #define WIDTH  10
 #define HEIGHT 5
 #define DEPTH  5
 int block_size = 10;
+int ticks_per_second = 20;
+
+// BENCHMARK
+// `--benchmark <frames>' renders a scripted camera flight through a generated
+// world in an invisible window and writes a JSON report of the frame times
+#define BENCH_WIDTH  64
+#define BENCH_HEIGHT 32
+#define BENCH_DEPTH  64
+#define BENCH_SEED   1337
+#define BENCH_WARMUP 30 // frames rendered before measuring starts
+
+// `--world <blocks>' overrides the width and depth of the benchmark world
+int bench_width = BENCH_WIDTH;
+int bench_depth = BENCH_DEPTH;
+
+// one full circle over the world every this many frames
+#define BENCH_ORBIT_FRAMES 600
+
+// camera of benchmark frame `frame': circling above the terrain, looking
+// ahead and down, the same path on every run
+void benchmark_flight(camera::BasicFPSCamera* cam, int frame)
+{
+    float center_x = bench_width * block_size / 2.0f;
+    float center_z = bench_depth * block_size / 2.0f;
+    float radius = bench_width * block_size * 0.3f;
+    float height = BENCH_HEIGHT * block_size * 0.75f;
+
+    float angle = 2.0f * 3.14159265f * frame / BENCH_ORBIT_FRAMES;
+    float ahead = angle + 0.4f;
+
+    cam->SetInitialPosition(center_x + radius * std::cos(angle), height,
+                            center_z + radius * std::sin(angle));
+    cam->LookAt(center_x + radius * std::cos(ahead), height * 0.4f,
+                center_z + radius * std::sin(ahead));
+}
 
 void create_world(GameWorld* world)
 {
@@ -54,42 +123,153 @@ void create_world(GameWorld* world)
 bool keys[512]; // perhaps 512 is not sufficient for some keyboards
                 // the guide suggests 1024 - might be better?
 
-int main()
+int main(int argc, char* argv[])
 {
+    std::chrono::steady_clock::time_point process_start = std::chrono::steady_clock::now();
+
+    // ARGUMENTS
+    int benchmark_frames = 0;
+    const char* report_path = "benchmark.json";
+    int view_distance = 0; // in blocks, 0 keeps the camera's default
+    bool persistent_stream = true;
+    bool gpu_culling = true;
+    bool face_culling = true;
+    int rebuild_budget = DIRTY_REBUILD_BUDGET; // section meshes per frame, 0 for all
+    bool texture_array = true; // the block shader variant without branching
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--benchmark") == 0 && i + 1 < argc) {
+            benchmark_frames = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--report") == 0 && i + 1 < argc) {
+            report_path = argv[++i];
+        }
+        else if(strcmp(argv[i], "--world") == 0 && i + 1 < argc) {
+            bench_width = bench_depth = std::max(SECTION_SIZE, atoi(argv[++i]));
+        }
+        else if(strcmp(argv[i], "--view-distance") == 0 && i + 1 < argc) {
+            view_distance = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--no-lod") == 0) {
+            level_of_detail = false;
+        }
+        else if(strcmp(argv[i], "--no-persistent-map") == 0) {
+            persistent_stream = false;
+        }
+        else if(strcmp(argv[i], "--no-gpu-culling") == 0) {
+            gpu_culling = false;
+        }
+        else if(strcmp(argv[i], "--no-face-culling") == 0) {
+            face_culling = false;
+        }
+        else if(strcmp(argv[i], "--rebuild-budget") == 0 && i + 1 < argc) {
+            rebuild_budget = atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--no-shader-cache") == 0) {
+            program_cache::SetEnabled(false);
+        }
+        else if(strcmp(argv[i], "--branching-shader") == 0) {
+            texture_array = false;
+        }
+        else if(strcmp(argv[i], "--no-parallel-shaders") == 0) {
+            shaders::setParallelCompile(false);
+        }
+        else {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--benchmark <frames> [--report <path>] [--world <blocks>]]"
+                      << " [--view-distance <blocks>] [--no-lod] [--no-persistent-map]"
+                      << " [--no-gpu-culling] [--no-face-culling] [--rebuild-budget <sections>]"
+                      << " [--no-shader-cache]"
+                      << " [--branching-shader] [--no-parallel-shaders]" << std::endl;
+            return 1;
+        }
+    }
+    bool benchmark = benchmark_frames > 0;
+
     // WINDOW
     std::string title = "Minecraft";
     window::as_ratio_t as_ratio = window::ASPECT_RATIO_4_3;
-    window::WindowedWindow* win = window::create_window(title, 800, as_ratio);
+    window::WindowedWindow* win = window::create_window(title, 800, as_ratio, !benchmark);
+    if(win == NULL) {
+        return 1;
+    }
 
     // GAME WORLD
-    GameWorld* game_world = new GameWorld(WIDTH, HEIGHT, DEPTH);
+    GameWorld* game_world = benchmark ? new GameWorld(bench_width, BENCH_HEIGHT, bench_depth)
+                                      : new GameWorld(WIDTH, HEIGHT, DEPTH);
+    game_world->SetPersistentStream(persistent_stream);
+    game_world->SetGpuCulling(gpu_culling);
+    game_world->SetFaceCulling(face_culling);
+    game_world->SetRebuildBudget(rebuild_budget);
 
-    create_world(game_world);
+    // SHADERS
+    // all of them submitted before the world is generated, for the driver
+    // to compile meanwhile if it can. Without parallel compilation this
+    // is where they are compiled
+    double shader_start = glfwGetTime();
+    // faces pick their texture from an array, or branch between three
+    shader_preprocessor::_defines_t block_variant;
+    if(texture_array) {
+        block_variant["TEXTURE_ARRAY"] = "";
+    }
+    int block_shader = shaders::submitVariantVGF("shaders|default_block_shader", block_variant);
+    game_world->PrepareDrawing(); // submits the culling shader
+    double shader_load_ms = (glfwGetTime() - shader_start) * 1000.0;
+    GLuint shader = 0;
 
-    // KEY EVENTS
-    glfwSetKeyCallback(win->Window(), key_callback);
+    if(benchmark)
+    {
+        world_generator::generate_terrain(game_world, bench_width, BENCH_HEIGHT,
+                                          bench_depth, BENCH_SEED);
+    }
+    else {
+        create_world(game_world);
+    }
 
     // CAMERA
     fps_cam = new camera::BasicFPSCamera(win->Window(), win->width, win->height);
     fps_cam->SetInitialPosition(0.0f, block_size * 1.0f, block_size * 1.0f);
     fps_cam->SetInitialDirection(0.0f, 0.0f, 0.0f);
+    if(view_distance > 0) {
+        fps_cam->SetViewDistance((GLfloat)view_distance * block_size);
+    }
+    int lod_distance = (int)(fps_cam->ViewDistance() / block_size) / LOD_DISTANCE_DIVISOR;
+    game_world->SetLodDistance(lod_distance >= LOD_MIN_DISTANCE ? lod_distance : 0);
 
-    // CURSOR
-    glfwSetCursorPosCallback(win->Window(), mouse_callback);
-    glfwSetScrollCallback(win->Window(), scroll_callback);
+    if(!benchmark)
+    {
+        // KEY EVENTS
+        glfwSetKeyCallback(win->Window(), key_callback);
 
-    // HIDE CURSOR
-    glfwSetInputMode(win->Window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // CURSOR
+        glfwSetCursorPosCallback(win->Window(), mouse_callback);
+        glfwSetScrollCallback(win->Window(), scroll_callback);
 
-    // SHADERS
-    GLuint shader = shaders::loadShadersVGF("shaders|default_block_shader");
-    glUseProgram(shader);
+        // HIDE CURSOR
+        glfwSetInputMode(win->Window(), GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    }
+    else
+    {
+        // measure rendering, not the display's refresh rate
+        glfwSwapInterval(0);
+    }
 
     // TEXTURES
     unsigned long tex_options = TEX_GENERATE_MIPMAP | TEX_MIXED_FILTER;
-    Texture tex0 = Texture("assets|images|grass|side.png", tex_options);
-    Texture tex1 = Texture("assets|images|grass|top.png", tex_options);
-    Texture tex2 = Texture("assets|images|grass|bottom.png", tex_options);
+    const char* block_images[3] = { "assets|images|grass|side.png",    // FACE_SIDE
+                                    "assets|images|grass|top.png",     // FACE_TOP
+                                    "assets|images|grass|bottom.png"}; // FACE_BOTTOM
+    TextureArray* block_textures = NULL;
+    Texture* face_textures[3] = { NULL, NULL, NULL };
+    if(texture_array) {
+        block_textures = new TextureArray(block_images, 3, tex_options);
+    }
+    else
+    {
+        for(int t = 0; t < 3; t++) {
+            face_textures[t] = new Texture(block_images[t], tex_options);
+        }
+    }
 
     // enable depth testing, by using the GLFW's z-buffer
     glEnable(GL_DEPTH_TEST);
@@ -97,70 +277,320 @@ int main()
     // enable multisample for MSAA
     glEnable(GL_MULTISAMPLE);
 
+    // GPU PASS TIMINGS
+    gpu_timer::GpuTimer* gpu = new gpu_timer::GpuTimer();
+
     // TIMER
     GLfloat deltaTime = 0.0f;
     GLfloat lastTime = 0.0f;
+    timer::MainTimer tick_timer(ticks_per_second);
+
+    // CULLING
+    WorldCulling culling;
+
+    // LEVELS OF DETAIL
+    std::vector<unsigned char> lods;
+
+    // BENCHMARK RESULTS
+    frame_stats::FrameStats stats;
+    int frame = 0;
+    double first_frame_ms = -1.0; // since the start of main
+    double culled_percent = 0.0, cull_raster_ms = 0.0;
+    size_t lod_cells = 0;
+    _dirty_stats_t dirty; // summed over the recorded frames, a tick each
+    stream_buffer::_stream_stats_t uploads;
+    size_t frame_allocations = 0; // counted with ALLOC_COUNTER_ENABLED only
+    if(benchmark) {
+        stats.Reserve(benchmark_frames);
+    }
 
     // the 'game loop'
     // forcing GLFW to continuously draw the window
+    PROFILE_THREAD("main");
     while(!glfwWindowShouldClose(win->Window()))
     {
+        PROFILE_SCOPE("frame");
+        double frame_start = glfwGetTime();
+        size_t allocations_start = alloc_counter::Allocations();
+
+        // transient data of the last frame is gone
+        frame_arena::Frame().Reset();
+
+        // pick up GPU timings of earlier frames, never waits
+        gpu->Collect();
+
         // update the timer
         GLfloat nowTime = glfwGetTime();
         deltaTime = nowTime - lastTime;
         lastTime = nowTime;
 
         // check incoming events
-        glfwPollEvents();
+        {
+            PROFILE_SCOPE("poll");
+            glfwPollEvents();
+        }
 
         // change movement logic
-        do_movement(deltaTime);
+        {
+            PROFILE_SCOPE("movement");
+            if(benchmark) {
+                benchmark_flight(fps_cam, frame);
+            }
+            else {
+                do_movement(deltaTime);
+            }
+        }
+
+        if(benchmark)
+        {
+            // exactly one tick per frame, so every run does the same work
+            PROFILE_SCOPE("tick");
+            game_world->Tick();
+        }
+        else
+        {
+            // advance the game world at a fixed rate, independent of the frame rate
+            tick_timer.MeasureTime();
+            while(tick_timer.ShouldUpdate())
+            {
+                PROFILE_SCOPE("tick");
+                game_world->Tick();
+                tick_timer.UpdateTimer();
+            }
+        }
 
         // render at maximum possible frames:
         // clear the screen to prevent artifacts from the previous iteration
-        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        {
+            gpu_timer::Scope pass(*gpu, "clear");
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
-        // calling rendering functions...
-        glUseProgram(shader);
+        // the block shader may still be compiling, the frame stays empty then
+        if(shader == 0 && shaders::programDone(block_shader))
+        {
+            shader = shaders::readyProgram(block_shader);
+            if(shader == 0)
+            {
+                std::cerr << "Could not build the block shader" << std::endl;
+                break;
+            }
+        }
 
-        // update camera
-        fps_cam->CalculatePosition();
+        if(shader != 0)
+        {
+            // calling rendering functions...
+            glUseProgram(shader);
 
-        // model/view/projection uniform matrices
-        GLint view_loc = glGetUniformLocation(shader, "view");
-        GLint projection_loc = glGetUniformLocation(shader, "projection");
-        glUniformMatrix4fv(view_loc, 1, GL_FALSE,
-                           glm::value_ptr(*fps_cam->ViewMatrix()));
-        glUniformMatrix4fv(projection_loc, 1, GL_FALSE,
-                           glm::value_ptr(*fps_cam->ProjectionMatrix()));
+            // update camera
+            {
+                PROFILE_SCOPE("camera");
+                fps_cam->CalculatePosition();
+            }
 
-        // uniform textures
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex0.GetTexture());
-        glUniform1i(glGetUniformLocation(shader, "texture0"), 0);
+            {
+                PROFILE_SCOPE("uniforms");
+
+                // model/view/projection uniform matrices
+                GLint view_loc = glGetUniformLocation(shader, "view");
+                GLint projection_loc = glGetUniformLocation(shader, "projection");
+                glUniformMatrix4fv(view_loc, 1, GL_FALSE,
+                                   glm::value_ptr(*fps_cam->ViewMatrix()));
+                glUniformMatrix4fv(projection_loc, 1, GL_FALSE,
+                                   glm::value_ptr(*fps_cam->ProjectionMatrix()));
+
+                // uniform textures
+                if(block_textures != NULL)
+                {
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D_ARRAY, block_textures->GetTexture());
+                    glUniform1i(glGetUniformLocation(shader, "textures"), 0);
+                }
+                else
+                {
+                    const char* names[3] = { "texture0", "texture1", "texture2" };
+                    for(int t = 0; t < 3; t++)
+                    {
+                        glActiveTexture(GL_TEXTURE0 + t);
+                        glBindTexture(GL_TEXTURE_2D, face_textures[t]->GetTexture());
+                        glUniform1i(glGetUniformLocation(shader, names[t]), t);
+                    }
+                }
+
+                // uniform block size
+                glUniform1f(glGetUniformLocation(shader, "sz"), (GLfloat)block_size / 2.0f);
+            }
 
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, tex1.GetTexture());
-        glUniform1i(glGetUniformLocation(shader, "texture1"), 1);
+            // sections worth drawing
+            const std::vector<bool>* visible = NULL;
+            glm::mat4 view_projection = *fps_cam->ProjectionMatrix() * *fps_cam->ViewMatrix();
+            if(occlusion_culling)
+            {
+                visible = &culling.Cull(*game_world, view_projection,
+                                        fps_cam->Position(), (float)block_size);
+            }
 
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, tex2.GetTexture());
-        glUniform1i(glGetUniformLocation(shader, "texture2"), 2);
+            // level of detail of every section
+            const std::vector<unsigned char>* lod = NULL;
+            if(level_of_detail)
+            {
+                PROFILE_SCOPE("SelectLods");
+                game_world->SelectLods(fps_cam->Position(), (float)block_size, lods);
+                lod = &lods;
+            }
 
-        // uniform block size
-        glUniform1f(glGetUniformLocation(shader, "sz"), (GLfloat)block_size / 2.0f);
+            // meshes of changed sections, nearest first
+            {
+                PROFILE_SCOPE("RebuildDirty");
+                game_world->RebuildDirty(fps_cam->Position(), (float)block_size);
+            }
 
-        // drawing calls
-        game_world->DrawBlocks(shader, block_size);
+            // drawing calls
+            {
+                PROFILE_SCOPE("DrawBlocks");
+                gpu_timer::Scope pass(*gpu, "DrawBlocks");
+                game_world->DrawBlocks(shader, block_size, visible, lod, &view_projection);
+            }
+            if(gpu_stage_split)
+            {
+                gpu_timer::Scope pass(*gpu, "DrawBlocks geometry only");
+                glEnable(GL_RASTERIZER_DISCARD);
+                game_world->DrawBlocks(shader, block_size, visible, lod, &view_projection);
+                glDisable(GL_RASTERIZER_DISCARD);
+            }
+        }
 
         // double-buffering
-        glfwSwapBuffers(win->Window());
+        {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(win->Window());
+        }
+        if(shader != 0 && first_frame_ms < 0.0)
+        {
+            first_frame_ms = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - process_start).count();
+        }
+
+        // the flight starts with the first drawn frame
+        if(benchmark && shader != 0)
+        {
+            if(frame >= BENCH_WARMUP)
+            {
+                const _draw_stats_t& draws = game_world->DrawStats();
+                stats.Record((glfwGetTime() - frame_start) * 1000.0,
+                             draws.draw_calls, draws.triangles);
+                culled_percent += culling.Stats().CulledPercent();
+                cull_raster_ms += culling.Stats().raster_ms;
+                lod_cells += draws.lod_cells;
+                dirty.edits += game_world->DirtyStats().edits;
+                dirty.dirtied += game_world->DirtyStats().dirtied;
+                dirty.rebuilds += game_world->DirtyStats().rebuilds;
+                dirty.pending += game_world->DirtyStats().pending;
+
+                const stream_buffer::_stream_stats_t* stream = game_world->StreamStats();
+                if(stream != NULL)
+                {
+                    uploads.bytes += stream->bytes;
+                    uploads.waits += stream->waits;
+                    uploads.wait_ms += stream->wait_ms;
+                    uploads.orphans += stream->orphans;
+                }
+                frame_allocations += alloc_counter::Allocations() - allocations_start;
+            }
+            frame++;
+            if(frame >= BENCH_WARMUP + benchmark_frames) {
+                glfwSetWindowShouldClose(win->Window(), GL_TRUE);
+            }
+        }
     }
 
+    if(benchmark)
+    {
+        gpu->Collect();
+
+        std::ostringstream world_size;
+        world_size << bench_width << "x" << BENCH_HEIGHT << "x" << bench_depth;
+        stats.AddInfo("world", world_size.str());
+        stats.AddInfo("lod", !level_of_detail ? "off" :
+                             game_world->LodDistance() > 0 ? "on" : "off, view too short");
+        stats.AddInfo("draw_path", game_world->GpuCullingActive() ? "gpu culling, indirect"
+                                                                   : "multi draw");
+        stats.AddInfo("face_culling", game_world->FaceCulling() ? "on" : "off");
+        stats.AddInfo("rebuild_budget", game_world->RebuildBudget() == 0 ? "unlimited" :
+                      std::to_string(game_world->RebuildBudget()));
+        stats.AddInfo("stream_buffer", game_world->StreamStats() == NULL ? "unused" :
+                      game_world->PersistentStream() ? "persistent" : "orphaning");
+        const program_cache::_program_cache_stats_t& cache = program_cache::Stats();
+        stats.AddInfo("shader_cache", !program_cache::Supported() ? "off" :
+                      cache.hits > 0 && cache.misses + cache.rejected == 0 ? "warm" : "cold");
+        stats.AddInfo("parallel_shader_compile", shaders::parallelCompile() ? "on" :
+                      GLEW_ARB_parallel_shader_compile ? "off" : "unsupported");
+        stats.AddInfo("block_shader", texture_array ? "texture array" : "branching");
+        stats.AddInfo("renderer", (const char*)glGetString(GL_RENDERER));
+        stats.AddInfo("gl_version", (const char*)glGetString(GL_VERSION));
+        stats.AddMetric("shader_load_ms", shader_load_ms);
+        stats.AddMetric("startup_to_first_frame_ms", first_frame_ms);
+        stats.AddMetric("gpu_clear_ms", gpu->AverageMs("clear"));
+        stats.AddMetric("gpu_DrawBlocks_ms", gpu->AverageMs("DrawBlocks"));
+        if(stats.Frames() > 0)
+        {
+            stats.AddMetric("culled_sections_percent", culled_percent / stats.Frames());
+            stats.AddMetric("occlusion_raster_ms", cull_raster_ms / stats.Frames());
+            stats.AddMetric("lod_cells", (double)lod_cells / stats.Frames());
+            stats.AddMetric("edits_per_tick", (double)dirty.edits / stats.Frames());
+            stats.AddMetric("dirtied_sections_per_tick", (double)dirty.dirtied / stats.Frames());
+            stats.AddMetric("section_rebuilds_per_tick", (double)dirty.rebuilds / stats.Frames());
+            stats.AddMetric("dirty_sections_pending", (double)dirty.pending / stats.Frames());
+            stats.AddMetric("uploaded_bytes_per_frame", (double)uploads.bytes / stats.Frames());
+            stats.AddMetric("stream_fence_waits", (double)uploads.waits);
+            stats.AddMetric("stream_fence_wait_ms", uploads.wait_ms);
+            stats.AddMetric("stream_orphans", (double)uploads.orphans);
+
+            if(game_world->Meshes() != NULL) {
+                mesh_buffer::_mesh_buffer_stats_t meshes = game_world->Meshes()->Stats();
+                stats.AddMetric("mesh_buffer_pages", (double)meshes.pages);
+                stats.AddMetric("mesh_buffer_used_vertices", (double)meshes.used);
+                stats.AddMetric("mesh_buffer_fragmentation", meshes.fragmentation);
+                stats.AddMetric("mesh_buffer_defragmentations", (double)meshes.defragmentations);
+                stats.AddMetric("mesh_buffer_pages_deleted", (double)meshes.pages_deleted);
+            }
+
+            const slab_pool::_slab_pool_stats_t& storage = game_world->StorageStats();
+            stats.AddMetric("block_storage_bytes", (double)storage.MappedBytes());
+            stats.AddMetric("block_storage_occupancy", storage.Occupancy());
+
+            const frame_arena::_frame_arena_stats_t& arena = frame_arena::Frame().Stats();
+            stats.AddMetric("frame_arena_high_water_bytes", (double)arena.high_water);
+            stats.AddMetric("frame_arena_overflows", (double)arena.overflows);
+            if(alloc_counter::Enabled()) {
+                stats.AddMetric("heap_allocations_per_frame",
+                                (double)frame_allocations / stats.Frames());
+            }
+        }
+        stats.AddMetric("view_distance_blocks", fps_cam->ViewDistance() / block_size);
+
+        stats.Report(std::cout);
+        if(stats.WriteJson(report_path)) {
+            std::cout << "Benchmark report written to " << report_path << std::endl;
+        }
+    }
+
+    // dump the recorded frames, when built with PROFILER_ENABLED
+    PROFILE_WRITE_TRACE("trace.json");
+    PROFILE_REPORT(std::cout);
+    gpu->Report(std::cout);
+
     // do proper cleanup of any allocated resources
-    delete(win);
+    delete gpu;
+    delete block_textures;
+    for(int t = 0; t < 3; t++) {
+        delete face_textures[t];
+    }
+    shaders::deleteVariants();
+    delete fps_cam;
     delete game_world;
+    delete(win);
     glfwTerminate();
 
     // exiting the application
@@ -217,6 +647,15 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
                 break;
             }
         }
+        else if(key == GLFW_KEY_G) {
+            gpu_stage_split = !gpu_stage_split;
+        }
+        else if(key == GLFW_KEY_O) {
+            occlusion_culling = !occlusion_culling;
+        }
+        else if(key == GLFW_KEY_L) {
+            level_of_detail = !level_of_detail;
+        }
         else {
             keys[key] = false;
         }
@@ -0,0 +1,261 @@
+#ifndef WORLD_CULLING_HPP
+#define WORLD_CULLING_HPP
+
+// GLM
+#include <glm/glm.hpp>
+
+// STANDARD
+#include <stddef.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+// CUSTOM
+#include "engine/occlusion.hpp"
+#include "engine/profiler.hpp"
+#include "game_world.hpp"
+
+// only sections this close to the camera, in blocks, act as occluders
+#define OCCLUDER_DISTANCE 64
+
+// and at most this many of them, nearest first
+#define MAX_OCCLUDERS 64
+
+// counters of the most recent `Cull'
+typedef struct _culling_stats_t {
+    _culling_stats_t() : sections(0), cave_culled(0), frustum_culled(0), occluded(0),
+                         occluders(0), triangles(0), raster_ms(0.0), test_ms(0.0) {}
+
+    size_t sections;       // non-empty sections
+    size_t cave_culled;    // not reachable from the camera through open space
+    size_t frustum_culled;
+    size_t occluded;
+    size_t occluders;
+    size_t triangles;      // occluder triangles rasterized
+    double raster_ms;      // rasterizing occluders and building the pyramid
+    double test_ms;        // walking and testing the sections
+
+    double CulledPercent() const
+    {
+        return sections ? 100.0 * (cave_culled + frustum_culled + occluded) / sections : 0.0;
+    }
+} _culling_stats_t;
+
+// Decides which sections of a GameWorld `DrawBlocks' should draw.
+//
+// Every frame the solid bottom layers of the sections nearest to the camera
+// are rasterized as occluders, then the bounds of every non-empty section
+// are tested against the resulting hierarchical-Z pyramid.
+//
+// Sections are also walked breadth-first from the one holding the camera.
+// A section is only entered through a face connected to the face it was
+// itself entered by (see `_section_t::connected'), never against a
+// direction already taken, and only while inside the frustum. Whatever the
+// walk does not reach is hidden, e.g. everything outside the cave the
+// camera is in.
+//
+// Proper usage:
+//
+// WorldCulling culling;
+// while(gameisrunning) {
+//     const std::vector<bool>& visible =
+//         culling.Cull(*world, projection * view, camera_position, block_size);
+//     world->DrawBlocks(shader, block_size, &visible);
+// }
+class WorldCulling
+{
+private:
+    occlusion::DepthRasterizer _hiz;
+    std::vector<bool> _visible;
+    _culling_stats_t _stats;
+
+    struct Occluder
+    {
+        float distance;
+        glm::vec3 min, max;
+
+        bool operator<(const Occluder& other) const
+        {
+            return distance < other.distance;
+        }
+    };
+    std::vector<Occluder> _occluders;
+
+    struct Step
+    {
+        int section;
+        int entered;              // face entered by, -1 for the camera's section
+        unsigned char directions; // faces left by on the way here
+    };
+    std::vector<Step> _queue;
+    std::vector<bool> _reached;
+    bool _caves;
+
+    // mark the sections reachable from the camera in `_reached'
+    void Walk(GameWorld& world, int start, float block_size)
+    {
+        static const int offsets[6][3] = {
+            { -1, 0, 0 }, { 1, 0, 0 },
+            { 0, -1, 0 }, { 0, 1, 0 },
+            { 0, 0, -1 }, { 0, 0, 1 }
+        };
+        int nx = world.SectionsX(), ny = world.SectionsY(), nz = world.SectionsZ();
+        float half = block_size / 2.0f;
+
+        _queue.clear();
+        Step first = { start, -1, 0 };
+        _queue.push_back(first);
+        _reached[start] = true;
+
+        for(size_t q = 0; q < _queue.size(); q++)
+        {
+            Step step = _queue[q];
+            const _section_t& section = world.Section(step.section);
+            int sx = step.section % nx;
+            int sy = (step.section / nx) % ny;
+            int sz = step.section / (nx * ny);
+
+            for(int f = 0; f < 6; f++)
+            {
+                // faces come in opposite pairs, -x +x -y +y -z +z
+                if(step.directions & (1 << (f ^ 1))) {
+                    continue;
+                }
+                if(step.entered >= 0 && !(section.connected[step.entered] & (1 << f))) {
+                    continue;
+                }
+                int tx = sx + offsets[f][0];
+                int ty = sy + offsets[f][1];
+                int tz = sz + offsets[f][2];
+                if(tx < 0 || tx >= nx || ty < 0 || ty >= ny || tz < 0 || tz >= nz) {
+                    continue;
+                }
+                int next = (tz * ny + ty) * nx + tx;
+                if(_reached[next]) {
+                    continue;
+                }
+
+                int x0, y0, z0, x1, y1, z1;
+                world.SectionBlocks(next, x0, y0, z0, x1, y1, z1);
+                if(!_hiz.InFrustum(glm::vec3(x0, y0, z0) * block_size - half,
+                                   glm::vec3(x1, y1, z1) * block_size + half)) {
+                    continue;
+                }
+
+                _reached[next] = true;
+                Step s = { next, f ^ 1, (unsigned char)(step.directions | (1 << f)) };
+                _queue.push_back(s);
+            }
+        }
+    }
+
+    static double ElapsedMs(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::milli> d =
+            std::chrono::steady_clock::now() - start;
+        return d.count();
+    }
+
+public:
+    WorldCulling() : _caves(true) {}
+
+    // walk the sections from the camera, see above. On by default
+    void SetCaveCulling(bool caves)
+    {
+        _caves = caves;
+    }
+
+    // `camera' and the matrix are in world units, a block being
+    // `block_size' units wide and centred on its position times that
+    const std::vector<bool>& Cull(GameWorld& world, const glm::mat4& view_projection,
+                                  const glm::vec3& camera, float block_size)
+    {
+        PROFILE_SCOPE("occlusion culling");
+        _stats = _culling_stats_t();
+        _visible.assign(world.SectionCount(), false);
+        float half = block_size / 2.0f;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        _hiz.Begin(view_projection);
+
+        _occluders.clear();
+        float max_distance = OCCLUDER_DISTANCE * block_size;
+        for(int s = 0; s < world.SectionCount(); s++)
+        {
+            const _section_t& section = world.Section(s);
+            if(section.solid_layers == 0) {
+                continue;
+            }
+            int x0, y0, z0, x1, y1, z1;
+            world.SectionBlocks(s, x0, y0, z0, x1, y1, z1);
+
+            Occluder o;
+            o.min = glm::vec3(x0, y0, z0) * block_size - half;
+            o.max = glm::vec3(x1, y0 + section.solid_layers - 1, z1) * block_size + half;
+            glm::vec3 nearest = glm::clamp(camera, o.min, o.max);
+            o.distance = glm::length(nearest - camera);
+            if(o.distance <= max_distance) {
+                _occluders.push_back(o);
+            }
+        }
+        std::sort(_occluders.begin(), _occluders.end());
+        if(_occluders.size() > MAX_OCCLUDERS) {
+            _occluders.resize(MAX_OCCLUDERS);
+        }
+        for(size_t i = 0; i < _occluders.size(); i++) {
+            _hiz.RasterizeBox(_occluders[i].min, _occluders[i].max);
+        }
+        _hiz.BuildPyramid();
+        _stats.raster_ms = ElapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+
+        // walking needs the camera inside the world, blocks are centred
+        // on their position
+        glm::vec3 block = glm::floor(camera / block_size + 0.5f);
+        int from = world.SectionAt((int)block.x, (int)block.y, (int)block.z);
+        bool walk = _caves && from >= 0;
+        if(walk)
+        {
+            _reached.assign(world.SectionCount(), false);
+            Walk(world, from, block_size);
+        }
+
+        for(int s = 0; s < world.SectionCount(); s++)
+        {
+            const _section_t& section = world.Section(s);
+            if(section.blocks == 0) {
+                continue;
+            }
+            _stats.sections++;
+            if(walk && !_reached[s])
+            {
+                _stats.cave_culled++;
+                continue;
+            }
+            glm::vec3 min = glm::vec3(section.min[0], section.min[1], section.min[2]) * block_size - half;
+            glm::vec3 max = glm::vec3(section.max[0], section.max[1], section.max[2]) * block_size + half;
+            _visible[s] = _hiz.TestBox(min, max) == occlusion::VISIBLE;
+        }
+        _stats.test_ms = ElapsedMs(start);
+
+        const occlusion::_raster_stats_t& raster = _hiz.Stats();
+        _stats.frustum_culled = raster.frustum_culled;
+        _stats.occluded = raster.occluded;
+        _stats.occluders = raster.occluders;
+        _stats.triangles = raster.triangles;
+        return _visible;
+    }
+
+    const _culling_stats_t& Stats() const
+    {
+        return _stats;
+    }
+
+    const occlusion::DepthRasterizer& Rasterizer() const
+    {
+        return _hiz;
+    }
+};
+
+#endif // WORLD_CULLING_HPP
@@ -0,0 +1,102 @@
+#ifndef WORLD_GENERATOR_HPP
+#define WORLD_GENERATOR_HPP
+
+// STANDARD
+#include <stdint.h>
+#include <cmath>
+
+// CUSTOM
+#include "game_world.hpp"
+
+// Deterministic terrain: the same seed and dimensions always produce the
+// same world, on every platform, so it can serve as a benchmark scene.
+namespace world_generator
+{
+    // integer hash of a lattice point, in [0, 1)
+    inline float lattice(int x, int z, uint32_t seed)
+    {
+        uint32_t h = seed;
+        h ^= (uint32_t)x * 0x27d4eb2du;
+        h = (h ^ (h >> 15)) * 0x85ebca6bu;
+        h ^= (uint32_t)z * 0x165667b1u;
+        h = (h ^ (h >> 13)) * 0xc2b2ae35u;
+        h ^= h >> 16;
+        return (h & 0xFFFFFF) / (float)0x1000000;
+    }
+
+    // smoothly interpolated value noise, in [0, 1)
+    inline float value_noise(float x, float z, uint32_t seed)
+    {
+        int x0 = (int)std::floor(x);
+        int z0 = (int)std::floor(z);
+        float fx = x - x0;
+        float fz = z - z0;
+        fx = fx * fx * (3.0f - 2.0f * fx);
+        fz = fz * fz * (3.0f - 2.0f * fz);
+
+        float a = lattice(x0,     z0,     seed);
+        float b = lattice(x0 + 1, z0,     seed);
+        float c = lattice(x0,     z0 + 1, seed);
+        float d = lattice(x0 + 1, z0 + 1, seed);
+        return (a + (b - a) * fx) + ((c + (d - c) * fx) - (a + (b - a) * fx)) * fz;
+    }
+
+    // a few octaves of value noise, in [0, 1)
+    inline float fractal_noise(float x, float z, uint32_t seed)
+    {
+        float sum = 0.0f, amplitude = 0.5f, norm = 0.0f;
+        for(int octave = 0; octave < 4; octave++)
+        {
+            sum += amplitude * value_noise(x, z, seed + octave * 1013);
+            norm += amplitude;
+            x *= 2.0f;
+            z *= 2.0f;
+            amplitude *= 0.5f;
+        }
+        return sum / norm;
+    }
+
+    // rolling hills of grass on earth on stone, sandy beaches, and water
+    // filling everything below sea level
+    void generate_terrain(GameWorld* world, int width, int height, int depth,
+                          uint32_t seed)
+    {
+        int sea_level = height / 3;
+
+        for(int z = 0; z < depth; z++)
+        {
+            for(int x = 0; x < width; x++)
+            {
+                float n = fractal_noise(x / 24.0f, z / 24.0f, seed);
+                int ground = 1 + (int)(n * (height * 3 / 4));
+                if(ground >= height) {
+                    ground = height - 1;
+                }
+
+                for(int y = 0; y <= ground; y++)
+                {
+                    _block_type_t type;
+                    if(y < ground - 3) {
+                        type = BLOCK_TYPE_STONE;
+                    }
+                    else if(ground <= sea_level + 1) {
+                        type = BLOCK_TYPE_SAND;
+                    }
+                    else if(y < ground) {
+                        type = BLOCK_TYPE_EARTH;
+                    }
+                    else {
+                        type = BLOCK_TYPE_GRASS;
+                    }
+                    world->InsertBlock(x, y, z, type);
+                }
+
+                for(int y = ground + 1; y <= sea_level; y++) {
+                    world->InsertBlock(x, y, z, BLOCK_TYPE_WATER);
+                }
+            }
+        }
+    }
+}
+
+#endif // WORLD_GENERATOR_HPP